@@ -16,8 +16,9 @@ namespace http { namespace crud {
     
     template<typename Matched>
     struct crud_match : Matched {
+        //body of the request, owned by the connection until the reply is written
         crud_match(const Matched &m, const std::string &d) : Matched(m) , data(d) {}
-        std::string data;
+        const std::string &data;
     };
     
     template<typename Response, typename Regex, typename Matched>
@@ -16,4 +16,4 @@
 
 #include <benchmark/benchmark.h>
 
-BENCHMARK_MAIN()
+BENCHMARK_MAIN();
@@ -20,7 +20,11 @@ namespace po = boost::program_options;
 #include "../examples/bidder/bidder_caches.hpp"
 #include "../examples/bidder/serialization.hpp"
 
+#include <fstream>
+#include <iterator>
+#include <map>
 #include <memory>
+#include <random>
 
 namespace {
 
@@ -211,5 +215,99 @@ BENCHMARK_DEFINE_F(CacheBenchmarkFixture, geo_campaign_retrieve_benchmark)(bench
 
 BENCHMARK_REGISTER_F(CacheBenchmarkFixture, geo_campaign_retrieve_benchmark);
 
-} // local namespace
+//ads load of a generated state.range(0) rows source : istream_iterator parse vs mapped parse
+//on state.range(1) threads ( 0 is hardware_concurrency ), and the whole AdDataEntity::load()
+struct GeneratedAdsConfig {
+    cache_loader_config_data config_data;
+    const cache_loader_config_data & data() const {
+        return config_data;
+    }
+};
+
+const GeneratedAdsConfig & generated_ads(uint64_t rows) {
+    static std::map<uint64_t, GeneratedAdsConfig> configs;
+    auto found = configs.find(rows);
+    if (found != configs.end()) {
+        return found->second;
+    }
+    GeneratedAdsConfig &config = configs[rows];
+    config.config_data.ads_source = "/tmp/vanilla-bench-load-ads-" + std::to_string(rows);
+    config.config_data.ads_ipc_name = "vanilla-bench-load-ads-" + std::to_string(rows);
+    std::ofstream ads{config.config_data.ads_source};
+    for (uint64_t ad_id = 0; ad_id < rows; ++ad_id) {
+        ads << ad_id << "\t" << ad_id / 10 << "\t" << 300 << "\t" << 250 << "\t"
+            << 0 << "\t" << 1000 + ad_id % 5000 << "\t" << "<script src=\"https://cdn.example.com/creative/" << ad_id << ".js\"></script>\n";
+    }
+    return config;
+}
+
+void ad_parse_istream_benchmark(benchmark::State& state)
+{
+    const auto &config = generated_ads(state.range(0));
+    while (state.KeepRunning())
+    {
+        std::ifstream in{config.data().ads_source};
+        std::vector<Ad> ads;
+        std::copy(std::istream_iterator<Ad>(in), std::istream_iterator<Ad>(), std::back_inserter(ads));
+        benchmark::DoNotOptimize(ads.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void ad_parse_mapped_benchmark(benchmark::State& state)
+{
+    const auto &config = generated_ads(state.range(0));
+    while (state.KeepRunning())
+    {
+        std::vector<Ad> ads;
+        datacache::tsv::parse(config.data().ads_source, ads, &Ad::parse, state.range(1));
+        benchmark::DoNotOptimize(ads.data());
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+void ad_load_generated_benchmark(benchmark::State& state)
+{
+    const auto &config = generated_ads(state.range(0));
+    boost::log::core::get()->set_logging_enabled(false);
+    while (state.KeepRunning())
+    {
+        std::make_unique<AdDataEntity<GeneratedAdsConfig>>(config)->load();
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+//campaign lookups on a generated state.range(0) rows ads cache with transparent huge pages off or on
+//( state.range(1) ) on backend state.range(2) ( shared, mapped, heap ), huge_pages counter is what the segment got
+void ad_retrieve_huge_pages_benchmark(benchmark::State& state)
+{
+    const auto &config = generated_ads(state.range(0));
+    boost::log::core::get()->set_logging_enabled(false);
+    auto &settings = mpclmi::ipc::settings();
+    const auto saved = settings;
+    settings.backend = static_cast<mpclmi::ipc::memory_backend>(state.range(2));
+    settings.base_dir = "/tmp";
+    settings.huge_pages = state.range(1);
+    {
+        AdDataEntity<GeneratedAdsConfig> ad_cache(config);
+        ad_cache.load();
+        std::mt19937 generator{42};
+        std::uniform_int_distribution<uint32_t> campaigns(0, state.range(0) / 10 - 1);
+        std::vector<Ad> ads;
+        while (state.KeepRunning())
+        {
+            ads.clear();
+            ad_cache.retrieve(ads, campaigns(generator), 300, 250);
+            benchmark::DoNotOptimize(ads.data());
+        }
+        state.counters["huge_pages"] = static_cast<int>(ad_cache.huge_pages());
+    }
+    settings = saved;
+}
 
+BENCHMARK(ad_parse_istream_benchmark)->Arg(2 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(ad_parse_mapped_benchmark)->Args({2 << 20, 1})->Args({2 << 20, 0})->Unit(benchmark::kMillisecond);
+BENCHMARK(ad_load_generated_benchmark)->Arg(2 << 20)->Unit(benchmark::kMillisecond);
+BENCHMARK(ad_retrieve_huge_pages_benchmark)->Args({1 << 20, 0, 0})->Args({1 << 20, 1, 0})->Args({1 << 20, 0, 2})->Args({1 << 20, 1, 2});
+
+} // local namespace
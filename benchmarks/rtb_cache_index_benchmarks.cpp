@@ -0,0 +1,215 @@
+#include <benchmark/benchmark.h>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+#include <rtb/config/config.hpp>
+#include <rtb/datacache/memory_types.hpp>
+#include <rtb/datacache/entity_cache.hpp>
+#include <rtb/datacache/ad_entity.hpp>
+#include  "../examples/datacache/city_country_entity.hpp"
+#include "../examples/bidder/ad.hpp"
+#include "../examples/bidder/geo.hpp"
+#include "../examples/loader/config.hpp"
+#include "../examples/bidder/serialization.hpp"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <random>
+
+namespace {
+
+// Ordered ( red-black tree ) vs hashed indices for GeoDataEntity and AdDataEntity retrieve
+// on generated data sets of 10k, 100k and 1M records, and AdSelector geo resolution
+// on string keys ( lowercased copies ) vs string_dictionary ids
+struct IndexBenchmarkConfig {
+    cache_loader_config_data config_data;
+    const cache_loader_config_data & data() const {
+        return config_data;
+    }
+};
+
+constexpr uint16_t AD_SIZES[][2] = {{300, 250}, {728, 90}, {160, 600}};
+constexpr int64_t ADS_PER_CAMPAIGN = 6;
+constexpr int64_t COUNTRIES = 200;
+constexpr std::size_t LOOKUP_KEYS = 1024;
+
+std::string generate_ads(int64_t records) {
+    std::string file_name = "/tmp/vanilla-bench-ads-" + std::to_string(records);
+    std::ofstream out{file_name};
+    for (int64_t ad_id = 0; ad_id < records; ++ad_id) {
+        const auto &size = AD_SIZES[ad_id % 3];
+        out << ad_id << "\t" << ad_id / ADS_PER_CAMPAIGN << "\t" << size[0] << "\t" << size[1] << "\t"
+            << 0 << "\t" << 1000 + ad_id % 5000 << "\t" << "<script>ad_" << ad_id << "</script>\n";
+    }
+    return file_name;
+}
+
+std::string generate_geo(int64_t records) {
+    std::string file_name = "/tmp/vanilla-bench-geo-" + std::to_string(records);
+    std::ofstream out{file_name};
+    for (int64_t geo_id = 0; geo_id < records; ++geo_id) {
+        out << geo_id << "\t" << "City" << geo_id << "\t" << "Country" << geo_id % COUNTRIES << "\n";
+    }
+    return file_name;
+}
+
+// loading is expensive, keep every loaded entity for all runs of the same benchmark
+template<typename Entity>
+struct loaded_entity {
+    IndexBenchmarkConfig config;
+    std::unique_ptr<Entity> entity;
+};
+
+template<typename Entity, typename Setup>
+Entity & load_once(const std::string &name, Setup && setup) {
+    static std::map<std::string, std::unique_ptr<loaded_entity<Entity>>> loaded;
+    auto &item = loaded[name];
+    if (!item) {
+        item = std::make_unique<loaded_entity<Entity>>();
+        setup(item->config.config_data);
+        item->entity = std::make_unique<Entity>(item->config);
+        item->entity->load();
+    }
+    return *item->entity;
+}
+
+template<template<class> class Container>
+void ad_retrieve_benchmark(benchmark::State& state, const std::string &kind)
+{
+    using Entity = AdDataEntity<IndexBenchmarkConfig, mpclmi::ipc::Shared, Container>;
+    const auto records = state.range(0);
+    const auto name = "vanilla-bench-ads-" + kind + "-" + std::to_string(records);
+    auto &ads = load_once<Entity>(name, [&](cache_loader_config_data &data) {
+        data.ads_source = generate_ads(records);
+        data.ads_ipc_name = name;
+    });
+
+    std::mt19937 gen(records);
+    std::uniform_int_distribution<int64_t> ad(0, records - 1);
+    std::vector<std::tuple<uint32_t, uint16_t, uint16_t>> keys;
+    for (std::size_t i = 0; i < LOOKUP_KEYS; ++i) {
+        const auto ad_id = ad(gen);
+        keys.emplace_back(ad_id / ADS_PER_CAMPAIGN, AD_SIZES[ad_id % 3][0], AD_SIZES[ad_id % 3][1]);
+    }
+
+    std::vector<Ad> retrieved;
+    std::size_t i{};
+    while (state.KeepRunning())
+    {
+        const auto &key = keys[i++ % LOOKUP_KEYS];
+        retrieved.clear();
+        benchmark::DoNotOptimize(ads.retrieve(retrieved, std::get<0>(key), std::get<1>(key), std::get<2>(key)));
+    }
+}
+
+template<template<class> class Container>
+void geo_retrieve_benchmark(benchmark::State& state, const std::string &kind)
+{
+    using Entity = GeoDataEntity<IndexBenchmarkConfig, mpclmi::ipc::Shared, Container>;
+    const auto records = state.range(0);
+    const auto name = "vanilla-bench-geo-" + kind + "-" + std::to_string(records);
+    auto &geos = load_once<Entity>(name, [&](cache_loader_config_data &data) {
+        data.geo_source = generate_geo(records);
+        data.geo_ipc_name = name;
+    });
+
+    std::mt19937 gen(records);
+    std::uniform_int_distribution<int64_t> geo(0, records - 1);
+    std::vector<std::pair<std::string, std::string>> keys;
+    for (std::size_t i = 0; i < LOOKUP_KEYS; ++i) {
+        const auto geo_id = geo(gen);
+        keys.emplace_back("city" + std::to_string(geo_id), "country" + std::to_string(geo_id % COUNTRIES));
+    }
+
+    std::size_t i{};
+    while (state.KeepRunning())
+    {
+        const auto &key = keys[i++ % LOOKUP_KEYS];
+        Geo data;
+        benchmark::DoNotOptimize(geos.retrieve(data, key.first, key.second));
+    }
+}
+
+//geo_id of a request city and country as AdSelector::getGeo resolves it, keys come in mixed case
+template<typename Entity, typename Resolve>
+void geo_resolve_benchmark(benchmark::State& state, const std::string &kind, Resolve && resolve)
+{
+    const auto records = state.range(0);
+    const auto name = "vanilla-bench-geo-" + kind + "-" + std::to_string(records);
+    auto &geos = load_once<Entity>(name, [&](cache_loader_config_data &data) {
+        data.geo_source = generate_geo(records);
+        data.geo_ipc_name = name;
+        data.dictionary_ipc_name = name + "-dictionary";
+    });
+
+    std::mt19937 gen(records);
+    std::uniform_int_distribution<int64_t> geo(0, records - 1);
+    std::vector<std::pair<std::string, std::string>> keys;
+    for (std::size_t i = 0; i < LOOKUP_KEYS; ++i) {
+        const auto geo_id = geo(gen);
+        keys.emplace_back("CITY" + std::to_string(geo_id), "Country" + std::to_string(geo_id % COUNTRIES));
+    }
+
+    std::size_t i{};
+    Geo data;
+    while (state.KeepRunning())
+    {
+        const auto &key = keys[i++ % LOOKUP_KEYS];
+        benchmark::DoNotOptimize(resolve(geos, data, key.first, key.second));
+    }
+}
+
+void ad_retrieve_ordered_benchmark(benchmark::State& state)
+{
+    ad_retrieve_benchmark<ipc::data::ad_container>(state, "ordered");
+}
+
+void ad_retrieve_hashed_benchmark(benchmark::State& state)
+{
+    ad_retrieve_benchmark<ipc::data::ad_hashed_container>(state, "hashed");
+}
+
+void geo_retrieve_ordered_benchmark(benchmark::State& state)
+{
+    geo_retrieve_benchmark<ipc::data::city_country_container>(state, "ordered");
+}
+
+void geo_retrieve_hashed_benchmark(benchmark::State& state)
+{
+    geo_retrieve_benchmark<ipc::data::city_country_hashed_container>(state, "hashed");
+}
+
+void geo_resolve_string_benchmark(benchmark::State& state)
+{
+    using Entity = GeoDataEntity<IndexBenchmarkConfig, mpclmi::ipc::Shared, ipc::data::city_country_container>;
+    geo_resolve_benchmark<Entity>(state, "ordered", [](Entity &geos, Geo &data, const std::string &city, const std::string &country) {
+        return geos.retrieve_hot(data, boost::algorithm::to_lower_copy(city), boost::algorithm::to_lower_copy(country));
+    });
+}
+
+void geo_resolve_interned_benchmark(benchmark::State& state)
+{
+    using Entity = GeoIdDataEntity<IndexBenchmarkConfig, mpclmi::ipc::Shared, ipc::data::city_country_id_container>;
+    geo_resolve_benchmark<Entity>(state, "interned", [](Entity &geos, Geo &data, const std::string &city, const std::string &country) {
+        return geos.retrieve_hot(data, city, country);
+    });
+}
+
+void geo_resolve_interned_hashed_benchmark(benchmark::State& state)
+{
+    using Entity = GeoIdDataEntity<IndexBenchmarkConfig, mpclmi::ipc::Shared, ipc::data::city_country_id_hashed_container>;
+    geo_resolve_benchmark<Entity>(state, "interned-hashed", [](Entity &geos, Geo &data, const std::string &city, const std::string &country) {
+        return geos.retrieve_hot(data, city, country);
+    });
+}
+
+BENCHMARK(ad_retrieve_ordered_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(ad_retrieve_hashed_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(geo_retrieve_ordered_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(geo_retrieve_hashed_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(geo_resolve_string_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(geo_resolve_interned_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+BENCHMARK(geo_resolve_interned_hashed_benchmark)->Arg(10000)->Arg(100000)->Arg(1000000);
+
+} // local namespace
@@ -0,0 +1,185 @@
+#include <benchmark/benchmark.h>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+#include <rtb/config/config.hpp>
+#include <rtb/datacache/memory_types.hpp>
+#include <rtb/datacache/entity_cache.hpp>
+#include <rtb/datacache/lock_types.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include "../examples/bidder/geo_campaign.hpp"
+#include "../examples/campaign/campaign_cache.hpp"
+#include "../examples/campaign/serialization.hpp"
+#include <rtb/datacache/budget_store.hpp>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Read throughput of entity_cache shared by N reader processes, one process per core,
+// for the default named mutex and the distributed reader lock
+using GeoTag = GeoCampaign::geo_id_tag;
+using Keys = vanilla::tagged_tuple<GeoTag, uint32_t>;
+
+template<typename Lock>
+using GeoCampaignCache = datacache::entity_cache<mpclmi::ipc::Shared, ipc::data::geo_campaign_container, 67108864, Lock>;
+
+constexpr uint32_t GEO_COUNT = 10000;
+constexpr std::chrono::milliseconds READ_DURATION{500};
+
+void reader_processes(benchmark::internal::Benchmark *b) {
+    const int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int n = 1; n < cores; n *= 2) {
+        b->Arg(n);
+    }
+    b->Arg(cores);
+}
+
+template<typename Lock>
+void cache_read_scaling_benchmark(benchmark::State& state, const char *name)
+{
+    using Cache = GeoCampaignCache<Lock>;
+    {
+        Cache cache(name);
+        cache.reload([](auto && insert) {
+            for (uint32_t geo_id = 0; geo_id < GEO_COUNT; ++geo_id) {
+                insert(Keys{geo_id}, GeoCampaign{geo_id, geo_id});
+            }
+        });
+    }
+
+    const auto processes = state.range(0);
+    // per process read counts written by the forked readers
+    const auto counts_size = sizeof(std::atomic<uint64_t>) * processes;
+    auto counts = static_cast<std::atomic<uint64_t> *>(
+        mmap(nullptr, counts_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0));
+    uint64_t reads{};
+
+    while (state.KeepRunning())
+    {
+        std::vector<pid_t> readers;
+        for (int64_t i = 0; i < processes; ++i) {
+            new (&counts[i]) std::atomic<uint64_t>(0);
+            pid_t pid = fork();
+            if (pid == 0) {
+                Cache cache(name);
+                std::mt19937 gen(i);
+                std::uniform_int_distribution<uint32_t> geo(0, GEO_COUNT - 1);
+                uint64_t n{};
+                const auto deadline = std::chrono::steady_clock::now() + READ_DURATION;
+                while (std::chrono::steady_clock::now() < deadline) {
+                    for (int k = 0; k < 64; ++k, ++n) {
+                        benchmark::DoNotOptimize(cache.template visit<GeoTag>(geo(gen), [](const auto &) {}));
+                    }
+                }
+                counts[i].store(n);
+                _exit(0);
+            }
+            readers.push_back(pid);
+        }
+        for (auto pid : readers) {
+            waitpid(pid, nullptr, 0);
+        }
+        for (int64_t i = 0; i < processes; ++i) {
+            reads += counts[i].load();
+        }
+    }
+    munmap(counts, counts_size);
+
+    const double seconds = std::chrono::duration<double>(READ_DURATION).count() * state.iterations();
+    state.counters["reads_per_sec"] = reads / seconds;
+    state.counters["reads_per_sec_per_process"] = reads / seconds / processes;
+}
+
+void named_lock_read_scaling_benchmark(benchmark::State& state)
+{
+    cache_read_scaling_benchmark<datacache::named_upgradable_lock>(state, "vanilla-bench-named-lock");
+}
+
+BENCHMARK(named_lock_read_scaling_benchmark)->Apply(reader_processes)->Iterations(1)->UseRealTime();
+
+
+void distributed_lock_read_scaling_benchmark(benchmark::State& state)
+{
+    cache_read_scaling_benchmark<datacache::distributed_reader_lock<>>(state, "vanilla-bench-distributed-lock");
+}
+
+BENCHMARK(distributed_lock_read_scaling_benchmark)->Apply(reader_processes)->Iterations(1)->UseRealTime();
+
+
+// Win notice cost per thread for N concurrent notifiers spending on the same campaigns,
+// read / deserialize / update under the cache lock versus a lock free budget_store spend
+constexpr uint32_t CAMPAIGN_COUNT = 1000;
+using CampaignTag = ipc::data::campaign_entity<datacache::entity_cache<mpclmi::ipc::Shared, ipc::data::campaign_container>::char_allocator>::campaign_id_tag;
+using CampaignKeys = vanilla::tagged_tuple<CampaignTag, uint32_t>;
+using CampaignBudgetCache = datacache::entity_cache<mpclmi::ipc::Shared, ipc::data::campaign_container>;
+
+vanilla::CampaignBudget campaign_budget(uint32_t campaign_id) {
+    vanilla::CampaignBudget budget;
+    budget.campaign_id = campaign_id;
+    budget.day_budget_limit = std::numeric_limits<uint32_t>::max();
+    return budget;
+}
+
+void win_notice_entity_cache_benchmark(benchmark::State& state)
+{
+    static const bool loaded = [] {
+        std::vector<std::pair<CampaignKeys, vanilla::CampaignBudget>> budgets;
+        for (uint32_t campaign_id = 1; campaign_id <= CAMPAIGN_COUNT; ++campaign_id) {
+            budgets.emplace_back(CampaignKeys{campaign_id}, campaign_budget(campaign_id));
+        }
+        CampaignBudgetCache("vanilla-bench-win-cache").reload(budgets.begin(), budgets.end());
+        return true;
+    }();
+    benchmark::DoNotOptimize(loaded);
+    CampaignBudgetCache cache("vanilla-bench-win-cache");
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<uint32_t> campaigns(1, CAMPAIGN_COUNT);
+    std::vector<std::shared_ptr<vanilla::CampaignBudget>> budgets;
+    for (auto _ : state) {
+        const uint32_t campaign_id = campaigns(rng);
+        budgets.clear();
+        cache.retrieve<CampaignTag>(budgets, campaign_id);
+        budgets.front()->update(vanilla::types::price(1000));
+        cache.update<CampaignTag>(CampaignKeys{campaign_id}, *budgets.front(), campaign_id);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(win_notice_entity_cache_benchmark)->ThreadRange(1, 4)->UseRealTime();
+
+
+void win_notice_budget_store_benchmark(benchmark::State& state)
+{
+    static const bool loaded = [] {
+        datacache::budget_store<> store("vanilla-bench-win-budgets");
+        for (uint32_t campaign_id = 1; campaign_id <= CAMPAIGN_COUNT; ++campaign_id) {
+            store.assign(campaign_id, std::numeric_limits<uint32_t>::max(), 0, 0);
+        }
+        return true;
+    }();
+    benchmark::DoNotOptimize(loaded);
+    datacache::budget_store<> store("vanilla-bench-win-budgets");
+    std::mt19937 rng(std::random_device{}());
+    std::uniform_int_distribution<uint32_t> campaigns(1, CAMPAIGN_COUNT);
+    datacache::budget_snapshot after;
+    for (auto _ : state) {
+        store.spend(campaigns(rng), 1000, after);
+        benchmark::DoNotOptimize(after);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(win_notice_budget_store_benchmark)->ThreadRange(1, 4)->UseRealTime();
+
+} // local namespace
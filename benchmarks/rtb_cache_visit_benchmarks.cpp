@@ -0,0 +1,249 @@
+#include <benchmark/benchmark.h>
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+#include <rtb/config/config.hpp>
+#include <rtb/datacache/memory_types.hpp>
+#include <rtb/datacache/entity_cache.hpp>
+#include "../examples/datacache/city_country_entity.hpp"
+#include "../examples/bidder/ad.hpp"
+#include "../examples/bidder/geo.hpp"
+#include "../examples/bidder/geo_campaign.hpp"
+#include "../examples/bidder/geo_size_ads.hpp"
+#include "../examples/loader/config.hpp"
+#include "../examples/bidder/serialization.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+// Heap allocations per lookup : copying retrieve() vs in place visit(),
+// per key visit() vs batched visit_many(), and geo_campaign + ads lookups
+// vs a single geo_size_ads probe
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+void * operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if ( void *p = std::malloc(size ? size : 1) ) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+struct VisitBenchmarkConfig {
+    cache_loader_config_data config_data;
+    const cache_loader_config_data & data() const {
+        return config_data;
+    }
+};
+
+constexpr uint32_t GEOS = 1000;
+constexpr uint32_t CAMPAIGNS_PER_GEO = 20;
+constexpr uint32_t CAMPAIGNS = 2000;
+constexpr uint32_t ADS_PER_CAMPAIGN = 10;
+
+VisitBenchmarkConfig & config() {
+    static VisitBenchmarkConfig config = [] {
+        VisitBenchmarkConfig config;
+        auto &data = config.config_data;
+        data.geo_campaign_source = "/tmp/vanilla-bench-visit-geo-campaign";
+        data.geo_campaign_ipc_name = "vanilla-bench-visit-geo-campaign";
+        data.ads_source = "/tmp/vanilla-bench-visit-ads";
+        data.ads_ipc_name = "vanilla-bench-visit-ads";
+        data.geo_source = "/tmp/vanilla-bench-visit-geo";
+        data.geo_ipc_name = "vanilla-bench-visit-geo";
+        data.geo_size_ads_ipc_name = "vanilla-bench-visit-geo-size-ads";
+        std::ofstream geo_campaigns{data.geo_campaign_source};
+        std::ofstream geos{data.geo_source};
+        for (uint32_t geo_id = 0; geo_id < GEOS; ++geo_id) {
+            geos << geo_id << "\t" << "city" << geo_id << "\t" << "us" << "\n";
+            for (uint32_t i = 0; i < CAMPAIGNS_PER_GEO; ++i) {
+                geo_campaigns << geo_id << "\t" << (geo_id * 7 + i) % CAMPAIGNS << "\n";
+            }
+        }
+        std::ofstream ads{data.ads_source};
+        for (uint32_t ad_id = 0; ad_id < CAMPAIGNS * ADS_PER_CAMPAIGN; ++ad_id) {
+            ads << ad_id << "\t" << ad_id / ADS_PER_CAMPAIGN << "\t" << 300 << "\t" << 250 << "\t"
+                << 0 << "\t" << 1000 + ad_id % 5000 << "\t" << "<script src=\"https://cdn.example.com/creative/" << ad_id << ".js\"></script>\n";
+        }
+        return config;
+    }();
+    return config;
+}
+
+template<typename Entity>
+Entity & entity() {
+    static Entity entity(config());
+    static const bool loaded = (entity.load(), true);
+    benchmark::DoNotOptimize(loaded);
+    return entity;
+}
+
+//counts allocations made by the measured loop only
+template<typename Lookup>
+void run_lookups(benchmark::State& state, Lookup && lookup) {
+    uint64_t allocated{};
+    uint32_t i{};
+    while (state.KeepRunning())
+    {
+        const auto before = allocations.load(std::memory_order_relaxed);
+        lookup(i++);
+        allocated += allocations.load(std::memory_order_relaxed) - before;
+    }
+    state.counters["allocs_per_lookup"] = benchmark::Counter(allocated, benchmark::Counter::kAvgIterations);
+}
+
+void geo_campaign_retrieve_benchmark(benchmark::State& state)
+{
+    auto &geo_campaigns = entity<GeoCampaignEntity<VisitBenchmarkConfig>>();
+    run_lookups(state, [&](uint32_t i) {
+        GeoCampaignEntity<VisitBenchmarkConfig>::GeoCampaignCollection campaigns;
+        geo_campaigns.retrieve(campaigns, i % GEOS);
+        benchmark::DoNotOptimize(campaigns.data());
+    });
+}
+
+void geo_campaign_visit_benchmark(benchmark::State& state)
+{
+    auto &geo_campaigns = entity<GeoCampaignEntity<VisitBenchmarkConfig>>();
+    run_lookups(state, [&](uint32_t i) {
+        uint64_t sum{};
+        geo_campaigns.visit(i % GEOS, [&sum](const GeoCampaign &geo_campaign) {
+            sum += geo_campaign.campaign_id;
+        });
+        benchmark::DoNotOptimize(sum);
+    });
+}
+
+void ad_retrieve_benchmark(benchmark::State& state)
+{
+    auto &ads = entity<AdDataEntity<VisitBenchmarkConfig>>();
+    run_lookups(state, [&](uint32_t i) {
+        std::vector<Ad> retrieved;
+        ads.retrieve(retrieved, i % CAMPAIGNS, uint16_t(300), uint16_t(250));
+        benchmark::DoNotOptimize(retrieved.data());
+    });
+}
+
+void ad_visit_benchmark(benchmark::State& state)
+{
+    auto &ads = entity<AdDataEntity<VisitBenchmarkConfig>>();
+    run_lookups(state, [&](uint32_t i) {
+        uint64_t max_bid{};
+        ads.visit(i % CAMPAIGNS, uint16_t(300), uint16_t(250), [&max_bid](const auto &ad) {
+            max_bid = std::max(max_bid, ad.max_bid_micros);
+        });
+        benchmark::DoNotOptimize(max_bid);
+    });
+}
+
+//ads of state.range(0) campaigns of one geo, one lookup and lock per campaign vs one batch
+std::vector<boost::tuple<uint32_t, uint16_t, uint16_t>> campaign_keys(uint32_t campaigns, uint32_t i) {
+    std::vector<boost::tuple<uint32_t, uint16_t, uint16_t>> keys;
+    for (uint32_t campaign = 0; campaign < campaigns; ++campaign) {
+        keys.emplace_back((i * 131 + campaign * 37) % CAMPAIGNS, 300, 250);
+    }
+    return keys;
+}
+
+void ad_visit_per_campaign_benchmark(benchmark::State& state)
+{
+    auto &ads = entity<AdDataEntity<VisitBenchmarkConfig>>();
+    const auto keys = campaign_keys(state.range(0), 1);
+    run_lookups(state, [&](uint32_t) {
+        uint64_t max_bid{};
+        for (const auto &key : keys) {
+            ads.visit(key.get<0>(), key.get<1>(), key.get<2>(), [&max_bid](const auto &ad) {
+                max_bid = std::max(max_bid, ad.max_bid_micros);
+            });
+        }
+        benchmark::DoNotOptimize(max_bid);
+    });
+}
+
+void ad_visit_many_benchmark(benchmark::State& state)
+{
+    auto &ads = entity<AdDataEntity<VisitBenchmarkConfig>>();
+    auto keys = campaign_keys(state.range(0), 1);
+    run_lookups(state, [&](uint32_t) {
+        uint64_t max_bid{};
+        ads.visit_many(keys, [&max_bid](const auto &ad) {
+            max_bid = std::max(max_bid, ad.max_bid_micros);
+        });
+        benchmark::DoNotOptimize(max_bid);
+    });
+}
+
+//highest bid ad of a geo for 300x250 : all campaigns of the geo then their ads, vs one posting list
+void select_geo_campaign_ads_benchmark(benchmark::State& state)
+{
+    auto &geo_campaigns = entity<GeoCampaignEntity<VisitBenchmarkConfig>>();
+    auto &ads = entity<AdDataEntity<VisitBenchmarkConfig>>();
+    std::vector<boost::tuple<uint32_t, uint16_t, uint16_t>> keys;
+    run_lookups(state, [&](uint32_t i) {
+        keys.clear();
+        geo_campaigns.visit(i % GEOS, [&keys](const GeoCampaign &geo_campaign) {
+            keys.emplace_back(geo_campaign.campaign_id, 300, 250);
+        });
+        uint64_t max_bid{};
+        ads.visit_many(keys, [&max_bid](const auto &ad) {
+            max_bid = std::max(max_bid, ad.max_bid_micros);
+        });
+        benchmark::DoNotOptimize(max_bid);
+    });
+}
+
+void select_geo_size_ads_benchmark(benchmark::State& state)
+{
+    auto &geo_size_ads = entity<GeoSizeAdsEntity<VisitBenchmarkConfig>>();
+    run_lookups(state, [&](uint32_t i) {
+        uint64_t max_bid{};
+        geo_size_ads.visit(i % GEOS, 300, 250, [&max_bid](const AdPosting &posting) {
+            if (!max_bid) {
+                max_bid = posting.max_bid_micros;
+            }
+        });
+        benchmark::DoNotOptimize(max_bid);
+    });
+}
+
+//vector of shared_ptr retriever, one make_shared per record
+void geo_retrieve_shared_ptr_benchmark(benchmark::State& state)
+{
+    auto &geos = entity<GeoDataEntity<VisitBenchmarkConfig>>();
+    std::vector<std::string> cities;
+    for (uint32_t geo_id = 0; geo_id < GEOS; ++geo_id) {
+        cities.push_back("city" + std::to_string(geo_id));
+    }
+    const std::string country{"us"};
+    run_lookups(state, [&](uint32_t i) {
+        std::vector<std::shared_ptr<Geo>> retrieved;
+        geos.retrieve(retrieved, cities[i % GEOS], country);
+        benchmark::DoNotOptimize(retrieved.data());
+    });
+}
+
+BENCHMARK(geo_campaign_retrieve_benchmark);
+BENCHMARK(geo_campaign_visit_benchmark);
+BENCHMARK(ad_retrieve_benchmark);
+BENCHMARK(ad_visit_benchmark);
+BENCHMARK(geo_retrieve_shared_ptr_benchmark);
+BENCHMARK(ad_visit_per_campaign_benchmark)->Arg(10)->Arg(50)->Arg(200);
+BENCHMARK(ad_visit_many_benchmark)->Arg(10)->Arg(50)->Arg(200);
+BENCHMARK(select_geo_campaign_ads_benchmark);
+BENCHMARK(select_geo_size_ads_benchmark);
+
+} // local namespace
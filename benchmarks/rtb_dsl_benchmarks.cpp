@@ -17,11 +17,14 @@
 #include <benchmark/benchmark.h>
 
 #include <rtb/DSL/generic_dsl.hpp>
+#include <rtb/DSL/lazy_dsl.hpp>
+#include <parsers/structural_scanner.hpp>
 
 namespace {
 struct GenericDslBenchmarkFixture: benchmark::Fixture
 {
     DSL::GenericDSL<jsonv::string_view> parser;
+    DSL::LazyDSL<jsonv::string_view> lazy_parser;
     std::string const input = R"(
 
 {
@@ -64,10 +67,64 @@ struct GenericDslBenchmarkFixture: benchmark::Fixture
 
 )"; // std::string const input
 
+    // same request carrying an impression ext blob of ~1500 tokens, beyond the old 128 token limit
+    std::string const ext_input = [this] {
+        std::string ext = R"("ext" : { "segments" : [ )";
+        for (int i = 0; i < 100; ++i) {
+            ext += (i ? ", " : "") + std::string(R"({ "id" : "seg)") + std::to_string(i) +
+                   R"(", "value" : 0.5, "tags" : [ "a", "b", "c" ], "meta" : { "src" : "dmp", "ttl" : 3600, "fresh" : true } })";
+        }
+        ext += " ] },\n    ";
+        std::string request = input;
+        return request.insert(request.find(R"("id" : "imp1")"), ext);
+    }();
+
+    // no bid for bid == 0, a single banner bid otherwise
+    openrtb::BidResponse<jsonv::string_view> response(int64_t bid) const {
+        openrtb::BidResponse<jsonv::string_view> response;
+        response.clear();
+        response.id = "9zj61whbdl319sjgz098lpys5cngmtro_short_false_false";
+        if (bid) {
+            openrtb::Bid<jsonv::string_view> b;
+            b.id = "0f1e2d3c-4b5a-6978-8796-a5b4c3d2e1f0";
+            b.impid = "imp1";
+            b.price = 1.25;
+            b.adid = "12345";
+            b.adm = R"(<a href="http://example.com/click"><img src="http://example.com/ad.png"/></a>)";
+            response.bidid = "1b2c3d4e-5f60-7182-93a4-b5c6d7e8f901";
+            response.cur = "USD";
+            response.seatbid.emplace_back();
+            response.seatbid.back().bid.push_back(b);
+        }
+        return response;
+    }
+
+    // requests compared through their json, the writer covers every member the mapper decodes
+    std::string json(const openrtb::BidRequest<jsonv::string_view> &request) const {
+        std::string out;
+        DSL::response_writer<DSL::dsl_mapper<jsonv::string_view>>(out).write(request);
+        return out;
+    }
+
+    // token decoder must decode what the jsonv dom path decodes
+    bool same_request(const std::string &json_request) {
+        return json(parser.extract_request(json_request)) == json(parser.extract_request_dom(json_request));
+    }
+
+    // response writer must write what jsonv serializes
+    bool same_response(const openrtb::BidResponse<jsonv::string_view> &bid_response) {
+        std::string content;
+        parser.write_response(bid_response, content);
+        return content == to_string(parser.create_response(bid_response));
+    }
+
 }; // GenericDslBenchmarkFixture
 
 BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_benchmark)(benchmark::State& state)
 {
+    if (!same_request(input)) {
+        state.SkipWithError("extract_request differs from extract_request_dom");
+    }
     while (state.KeepRunning())
     {
         benchmark::DoNotOptimize(parser.extract_request(input));
@@ -78,4 +135,123 @@ BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_bench
 
 BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_benchmark);
 
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_dom_benchmark)(benchmark::State& state)
+{
+    if (!same_request(input)) {
+        state.SkipWithError("extract_request differs from extract_request_dom");
+    }
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(parser.extract_request_dom(input));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_dom_benchmark);
+
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_ext_benchmark)(benchmark::State& state)
+{
+    if (!same_request(ext_input)) {
+        state.SkipWithError("extract_request differs from extract_request_dom");
+    }
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(parser.extract_request(ext_input));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * ext_input.size());
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, generic_dsl_extract_request_ext_benchmark);
+
+// range(0) : 0 - index only, 1 - user read as for a geo no bid, 2 - every member the bidder reads
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, lazy_dsl_extract_request_benchmark)(benchmark::State& state)
+{
+    using fields = openrtb::BidRequest<jsonv::string_view>;
+    while (state.KeepRunning())
+    {
+        auto const request = lazy_parser.extract_request(input);
+        if (state.range(0) > 0) {
+            benchmark::DoNotOptimize(request.get(&fields::user));
+        }
+        if (state.range(0) > 1) {
+            benchmark::DoNotOptimize(request.get(&fields::imp));
+            benchmark::DoNotOptimize(request.get(&fields::cur));
+            benchmark::DoNotOptimize(request.get(&fields::tmax));
+        }
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * input.size());
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, lazy_dsl_extract_request_benchmark)->Arg(0)->Arg(1)->Arg(2);
+
+// range(0) : 0 - no bid, 1 - one bid
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_create_response_benchmark)(benchmark::State& state)
+{
+    auto const bid_response = response(state.range(0));
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(to_string(parser.create_response(bid_response)));
+    }
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, generic_dsl_create_response_benchmark)->Arg(0)->Arg(1);
+
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, generic_dsl_write_response_benchmark)(benchmark::State& state)
+{
+    auto const bid_response = response(state.range(0));
+    if (!same_response(bid_response)) {
+        state.SkipWithError("write_response differs from create_response");
+    }
+    std::string content;
+    while (state.KeepRunning())
+    {
+        content.clear();
+        parser.write_response(bid_response, content);
+        benchmark::DoNotOptimize(content.data());
+    }
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, generic_dsl_write_response_benchmark)->Arg(0)->Arg(1);
+
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, jsmn_parse_benchmark)(benchmark::State& state)
+{
+    auto const& json = state.range(0) ? ext_input : input;
+    std::vector<jsmntok_t> tokens(4096);
+    while (state.KeepRunning())
+    {
+        jsmn_parser jsmn;
+        jsmn_init(&jsmn);
+        benchmark::DoNotOptimize(jsmn_parse(&jsmn, json.data(), json.size(), tokens.data(), tokens.size()));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * json.size());
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, jsmn_parse_benchmark)->Arg(0)->Arg(1);
+
+// range(0) : simd level, range(1) : ext blob
+BENCHMARK_DEFINE_F(GenericDslBenchmarkFixture, structural_scanner_benchmark)(benchmark::State& state)
+{
+    using scanner_type = parsers::structural_scanner;
+    auto const level = static_cast<scanner_type::simd>(state.range(0));
+    if (level > scanner_type::detected()) {
+        state.SkipWithError("simd level not supported by this cpu");
+    }
+    auto const& json = state.range(1) ? ext_input : input;
+    scanner_type scanner{128, level};
+    while (state.KeepRunning())
+    {
+        benchmark::DoNotOptimize(scanner.parse(json.data(), json.size()));
+    }
+
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * json.size());
+}
+
+BENCHMARK_REGISTER_F(GenericDslBenchmarkFixture, structural_scanner_benchmark)
+    ->Args({0, 0})->Args({1, 0})->Args({2, 0})
+    ->Args({0, 1})->Args({1, 1})->Args({2, 1});
+
 } // local namespace
@@ -9,6 +9,7 @@
 #define BIDDER_AD_HPP
 
 #include <typeinfo>
+#include <algorithm>
 #include <string>
 #include <iostream>
 #include <cstdint>
@@ -19,6 +20,9 @@
 #include "config.hpp"
 #include "rtb/common/split_string.hpp"
 #include "core/tagged_tuple.hpp"
+#include "rtb/datacache/ad_pod_entity.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
+#include "rtb/datacache/delta_record.hpp"
 #if BOOST_VERSION <= 106000
 #include <boost/utility/string_ref.hpp>
 namespace boost {
@@ -66,63 +70,130 @@ struct Ad {
         if ( !std::getline(is, record) ){
             return is;
         }
-        
-        std::vector<boost::string_view> fields;
-        vanilla::common::split_string(fields, record, "\t");
-        if(fields.size() < 6) {
-            return is;
-        }
-        l.ad_id = boost::lexical_cast<uint64_t>(fields.at(0).begin(), fields.at(0).size());
-        l.campaign_id = boost::lexical_cast<uint64_t>(fields.at(1).begin(), fields.at(1).size());
-        l.width = boost::lexical_cast<uint16_t>(fields.at(2).begin(), fields.at(2).size());
-        l.height = boost::lexical_cast<uint16_t>(fields.at(3).begin(), fields.at(3).size());
-        l.position = boost::lexical_cast<uint16_t>(fields.at(4).begin(), fields.at(4).size());
-        l.max_bid_micros = boost::lexical_cast<uint64_t>(fields.at(5).begin(), fields.at(5).size());
-        l.code = fields.at(6).data();
+        parse(record, l);
         return is;
     }
+    //ad_id campaign_id width height position max_bid_micros code, code is the rest of the line
+    static bool parse(boost::string_view record, Ad &l) {
+        boost::string_view fields[7];
+        const auto count = datacache::tsv::split(record, '\t', fields, 7);
+        if ( count < 6 ) {
+            return false;
+        }
+        using datacache::tsv::parse_number;
+        if ( !parse_number(fields[0], l.ad_id) || !parse_number(fields[1], l.campaign_id) ||
+             !parse_number(fields[2], l.width) || !parse_number(fields[3], l.height) ||
+             !parse_number(fields[4], l.position) || !parse_number(fields[5], l.max_bid_micros) ) {
+            return false;
+        }
+        l.code.assign(fields[6].data(), fields[6].size());
+        return true;
+    }
 };
 
 template <typename Config = BidderConfig,
-          typename Memory = typename mpclmi::ipc::Shared, 
-          typename Alloc = typename datacache::entity_cache<Memory, ipc::data::ad_container>::char_allocator >
+          typename Memory = typename mpclmi::ipc::Configured, 
+          template<class> class Container = ipc::data::ad_pod_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
 class AdDataEntity {
-        using Cache = datacache::entity_cache<Memory, ipc::data::ad_container> ; 
+        using Cache = datacache::entity_cache<Memory, Container> ; 
+        using Entity = typename Cache::Data_t;
         using Keys = vanilla::tagged_tuple<
-            typename ipc::data::ad_entity<Alloc>::campaign_tag, uint32_t,
-            typename ipc::data::ad_entity<Alloc>::width_tag,    uint16_t, 
-            typename ipc::data::ad_entity<Alloc>::height_tag,   uint16_t,
-            typename ipc::data::ad_entity<Alloc>::ad_id_tag,    uint64_t
+            typename Entity::campaign_tag, uint32_t,
+            typename Entity::width_tag,    uint16_t, 
+            typename Entity::height_tag,   uint16_t,
+            typename Entity::ad_id_tag,    uint64_t
         >;
         using DataVect = std::vector<Ad>;
-        using Tag = typename ipc::data::ad_entity<Alloc>::campaign_size_tag;
+        using Tag = typename Entity::campaign_size_tag;
     public:
         AdDataEntity(const Config &config):
             config{config}, cache(config.data().ads_ipc_name)
         {}
         void load() noexcept(false) {
-            std::ifstream in{config.data().ads_source};
-            if (!in) {
-                throw std::runtime_error(std::string("could not open file ") + config.data().ads_source + " exiting...");
-            }
-            LOG(debug) << "File opened " << config.data().ads_source;
-            cache.clear();
-            
-            std::for_each(std::istream_iterator<Ad>(in), std::istream_iterator<Ad>(), [&](const Ad &ad){
-                cache.insert(Keys{ad.campaign_id, ad.width, ad.height, ad.ad_id}, ad);
-            });            
+            std::vector<std::pair<Keys, Ad>> ads;
+            auto rejected = datacache::tsv::parse(config.data().ads_source, ads, [](boost::string_view record, std::pair<Keys, Ad> &ad) {
+                if ( !Ad::parse(record, ad.second) ) {
+                    return false;
+                }
+                ad.first = Keys{ad.second.campaign_id, ad.second.width, ad.second.height, ad.second.ad_id};
+                return true;
+            });
+            LOG(debug) << "File parsed " << config.data().ads_source << " ads " << ads.size() << " rejected " << rejected;
+            //keys are in the order of the index, sorted data is appended with end() hint
+            std::sort(ads.begin(), ads.end(), [](const auto &l, const auto &r) { return l.first < r.first; });
+            cache.reload(ads.begin(), ads.end());
+        }
+        //delta file of ads source records, see datacache::parse_delta and entity_cache::apply_delta
+        std::size_t apply_delta(const std::string &delta_source) noexcept(false) {
+            return apply_delta(delta_source, [](const auto &) {});
+        }
+        //visitor(const delta_record &) on every parsed record before the batch is applied
+        template<typename Visitor>
+        std::size_t apply_delta(const std::string &delta_source, Visitor && visitor) noexcept(false) {
+            using Delta = datacache::delta_record<Keys, Ad>;
+            std::vector<Delta> deltas;
+            auto rejected = datacache::tsv::parse(delta_source, deltas, [](boost::string_view record, Delta &delta) {
+                if ( !datacache::parse_delta(record, delta, &Ad::parse) ) {
+                    return false;
+                }
+                delta.first = Keys{delta.second.campaign_id, delta.second.width, delta.second.height, delta.second.ad_id};
+                return true;
+            });
+            std::for_each(deltas.begin(), deltas.end(), visitor);
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "Delta " << delta_source << " applied " << applied << " of " << deltas.size()
+                       << " rejected " << rejected << " sequence " << cache.sequence();
+            return applied;
+        }
+        uint64_t sequence() const {
+            return cache.sequence();
+        }
+        //visitor(const Entity &) on every record in place, see entity_cache::visit_all
+        template <typename Visitor>
+        std::size_t visit_all(Visitor && visitor) {
+            return cache.visit_all(std::forward<Visitor>(visitor));
         }
         template <typename ...Args>
         bool retrieve(DataVect &ads, Args && ...args) {
-            auto p = cache.template retrieve_raw<Tag>(std::forward<Args>(args)...);
-            auto is_found = p.first != p.second;
-            while ( p.first != p.second ) {
-                Ad ad;
-                p.first->retrieve(ad);
-                ads.emplace_back(std::move(ad));
-                ++p.first;
-            }
-            return is_found;
+            return cache.template visit<Tag>(std::forward<Args>(args)..., [&ads](const Entity &entity) {
+                ads.emplace_back();
+                entity.retrieve(ads.back());
+            }) > 0;
+        }
+        //fixed size fields only, code is left empty until retrieve_code() for the selected ad
+        template <typename ...Args>
+        bool retrieve_hot(DataVect &ads, Args && ...args) {
+            return cache.template visit<Tag>(std::forward<Args>(args)..., [&ads](const Entity &entity) {
+                ads.emplace_back();
+                entity.retrieve_hot(ads.back());
+            }) > 0;
+        }
+        //visit(keys..., visitor) calls visitor with the cache entity in place, see entity_cache::visit
+        template <typename ...Args>
+        std::size_t visit(Args && ...args) {
+            return cache.template visit<Tag>(std::forward<Args>(args)...);
+        }
+        //keys are boost::tuple<campaign_id, width, height>, sorted in place, see entity_cache::visit_many
+        template <typename KeyRange, typename Visitor>
+        std::size_t visit_many(KeyRange &keys, Visitor && visitor) {
+            return cache.template visit_many<Tag>(keys, std::forward<Visitor>(visitor));
+        }
+        template <typename KeyRange>
+        bool retrieve_many(KeyRange &keys, DataVect &ads) {
+            return cache.template retrieve_many<Tag>(keys, ads);
+        }
+        mpclmi::ipc::huge_page_mode huge_pages() const {
+            return cache.huge_pages();
+        }
+        //lookup on the full unique key and copy both under the read lock, a concurrent delta may erase the record
+        bool retrieve_code(Ad &ad) {
+            return cache.visit_unique(ad.campaign_id, ad.width, ad.height, ad.ad_id, [&ad](const Entity &entity) {
+                entity.retrieve(ad);
+            });
+        }
+        datacache::cache_stats stats() const {
+            return cache.stats();
         }
     private:
         const Config &config;
@@ -10,8 +10,10 @@
 
 #include "core/openrtb.hpp"
 #include "bidder_caches.hpp"
+#include "rtb/datacache/budget_store.hpp"
 #include <memory>
 #include <algorithm>
+#include <tuple>
 
 namespace vanilla {
 template<typename Config = BidderConfig>
@@ -22,9 +24,17 @@ class AdSelector {
         using AdSelectionAlg = std::function<AdPtr(const std::vector<Ad>&)>;
         using self_type = AdSelector<Config>;
         
+        //budget_ipc_name is the campaign cache kept by the slave banker, empty bids without budget checks
         AdSelector(BidderCaches<Config> &bidder_caches):
             bidder_caches{bidder_caches}
         {
+            if (!bidder_caches.config.data().budget_ipc_name.empty()) {
+                budgets.reset(new datacache::budget_store<>(bidder_caches.config.data().budget_ipc_name + "_budgets"));
+            }
+            geo_campaigns.reserve(500);
+            campaign_keys.reserve(500);
+            campaign_ids.reserve(500);
+            listed_ads.reserve(500);
             retrieved_cached_ads.reserve(500);
         }
             
@@ -33,8 +43,9 @@ class AdSelector {
             return *this;
         }
         
-        template<typename T> 
-        AdPtr select(const openrtb::BidRequest<T> &req, const openrtb::Impression<T> &imp) {
+        //Request is openrtb::BidRequest or DSL::lazy_request, only user is read from it
+        template<typename Request, typename T> 
+        AdPtr select(const Request &req, const openrtb::Impression<T> &imp) {
             AdPtr result;
             
             Geo geo;
@@ -43,54 +54,69 @@ class AdSelector {
                 return result;
             }
             
-            if(!getGeoCampaigns(geo.geo_id)) {
-                LOG(debug) << "No campaigns for geo " << geo.geo_id;
-                return result;
-            }
-            else {
-                LOG(debug) << "Selected campaigns " << geo_campaigns.size();
-            }
-            
-            if(!getCampaignAds(geo_campaigns, imp)) {
-                LOG(debug) << "No ads for geo " << geo.geo_id;
-                return result;
+            //single probe of the derived geo_size_ads cache once the loader has built it
+            if(bidder_caches.geo_size_ads_entity.built()) {
+                if(!getGeoSizeAds(geo.geo_id, imp)) {
+                    LOG(debug) << "No ads for geo " << geo.geo_id;
+                    return result;
+                }
             }
             else {
-                LOG(debug) << "selected ads " << retrieved_cached_ads.size();
+                if(!getGeoCampaigns(geo.geo_id)) {
+                    LOG(debug) << "No campaigns for geo " << geo.geo_id;
+                    return result;
+                }
+                else {
+                    LOG(debug) << "Selected campaigns " << geo_campaigns.size();
+                }
+
+                if(!getCampaignAds(geo_campaigns, imp)) {
+                    LOG(debug) << "No ads for geo " << geo.geo_id;
+                    return result;
+                }
             }
+            LOG(debug) << "selected ads " << retrieved_cached_ads.size();
             
-            if(selection_alg) {
-                return selection_alg(retrieved_cached_ads);
+            result = selection_alg ? selection_alg(retrieved_cached_ads) : max_bid(retrieved_cached_ads);
+            //candidates carry fixed size fields only, creative code is read for the winner
+            if(result && !bidder_caches.ad_data_entity.retrieve_code(*result)) {
+                LOG(debug) << "No code for ad " << result->ad_id;
+                return AdPtr();
             }
-            return max_bid(retrieved_cached_ads);
+            return result;
         }
         
         bool getGeoCampaigns(uint32_t geo_id) {
             geo_campaigns.clear();
-            if (!bidder_caches.geo_campaign_entity.retrieve(geo_campaigns, geo_id)) {
+            auto collect = [this](const GeoCampaign &geo_campaign) {
+                if (!exhausted(geo_campaign.campaign_id)) {
+                    geo_campaigns.push_back(geo_campaign);
+                }
+            };
+            if (!bidder_caches.geo_campaign_entity.visit(geo_id, collect)) {
                 LOG(debug) << "GeoAd retrieve failed " << geo_id;
                 return false;
             }
             return true;
         }
-        template <typename T>
-        bool getGeo(const openrtb::BidRequest<T> &req, Geo &geo) {
-            if (!req.user) {
+        template <typename Request>
+        bool getGeo(const Request &req, Geo &geo) {
+            const auto &user = req.get(&Request::request_type::user);
+            if (!user) {
                 LOG(debug) << "No user";
                 return true;
             }
-            if (!req.user.get().geo) {
+            if (!user.get().geo) {
                 LOG(debug) << "No user geo";
                 return true;
             }
            
-            auto &city_view = req.user.get().geo.get().city ;
-            auto &country_view = req.user.get().geo.get().country;
-            const std::string city = boost::algorithm::to_lower_copy(std::string(city_view.data(), city_view.size()));
-            const std::string country = boost::algorithm::to_lower_copy(std::string(country_view.data(), country_view.size()));
+            //matched on interned ids, the dictionary folds case so request strings are not copied
+            auto &city = user.get().geo.get().city ;
+            auto &country = user.get().geo.get().country;
 
-            if (!bidder_caches.geo_data_entity.retrieve(geo, city, country)) {
-                LOG(debug) << "retrieve failed " << city << " " << country;
+            if (!bidder_caches.geo_data_entity.retrieve_hot(geo, city, country)) {
+                LOG(debug) << "retrieve failed " << std::string(city.data(), city.size()) << " " << std::string(country.data(), country.size());
                 return false;
             } 
             return true;
@@ -99,11 +125,53 @@ class AdSelector {
         template <typename T>
         bool getCampaignAds(const std::vector<GeoCampaign> &campaigns, const openrtb::Impression<T> &imp) {
             retrieved_cached_ads.clear();
+            //buffers are reused across requests, candidates are copied without code so nothing is allocated
+            auto collect = [this](const auto &ad) {
+                retrieved_cached_ads.emplace_back();
+                ad.retrieve_hot(retrieved_cached_ads.back());
+            };
+            //all campaigns are looked up in one batch under a single lock
+            campaign_keys.clear();
             for (auto &campaign : campaigns) {
-                if (!bidder_caches.ad_data_entity.retrieve(retrieved_cached_ads, campaign.campaign_id, imp.banner.get().w, imp.banner.get().h)) {
-                    continue;
+                campaign_keys.emplace_back(campaign.campaign_id, imp.banner.get().w, imp.banner.get().h);
+            }
+            bidder_caches.ad_data_entity.visit_many(campaign_keys, collect);
+            //same candidates in the same order as the geo_size_ads posting list, see GeoSizeAdsEntity::load
+            auto &campaign_data = bidder_caches.campaign_data_entity;
+            if (campaign_data.filters()) {
+                //listed ads of all campaigns are collected once, candidates are then matched by binary search
+                campaign_ids.clear();
+                listed_ads.clear();
+                for (auto &campaign : campaigns) {
+                    campaign_ids.push_back(campaign.campaign_id);
                 }
+                campaign_data.visit_many(campaign_ids, [this](const auto &data) {
+                    listed_ads.emplace_back(data.campaign_id, data.ad_id);
+                });
+                std::sort(listed_ads.begin(), listed_ads.end());
+                retrieved_cached_ads.erase(std::remove_if(retrieved_cached_ads.begin(), retrieved_cached_ads.end(), [this](const Ad &ad) {
+                    return !std::binary_search(listed_ads.begin(), listed_ads.end(), std::make_pair(ad.campaign_id, ad.ad_id));
+                }), retrieved_cached_ads.end());
             }
+            std::sort(retrieved_cached_ads.begin(), retrieved_cached_ads.end(), [](const Ad &first, const Ad &second) {
+                return std::tie(second.max_bid_micros, first.ad_id) < std::tie(first.max_bid_micros, second.ad_id);
+            });
+            return retrieved_cached_ads.size() > 0;
+        }
+        
+        //posting list is sorted by max bid, without selection_alg only its head is a candidate
+        template <typename T>
+        bool getGeoSizeAds(uint32_t geo_id, const openrtb::Impression<T> &imp) {
+            retrieved_cached_ads.clear();
+            const uint16_t width = imp.banner.get().w;
+            const uint16_t height = imp.banner.get().h;
+            const bool all = static_cast<bool>(selection_alg);
+            bidder_caches.geo_size_ads_entity.visit(geo_id, width, height, [&](const AdPosting &posting) {
+                if ((all || retrieved_cached_ads.empty()) && !exhausted(posting.campaign_id)) {
+                    retrieved_cached_ads.emplace_back();
+                    posting.retrieve(retrieved_cached_ads.back(), width, height);
+                }
+            });
             return retrieved_cached_ads.size() > 0;
         }
         
@@ -111,15 +179,40 @@ class AdSelector {
             if(ads.size() == 0) {
                 return AdPtr();
             }
+            //ties go to the lower ad_id, the head of a geo_size_ads posting list
             const std::vector<Ad>::const_iterator result = std::max_element(ads.cbegin(), ads.cend(), [](const Ad &first, const Ad &second) -> bool {
-                return first.max_bid_micros < second.max_bid_micros;
+                return std::tie(first.max_bid_micros, second.ad_id) < std::tie(second.max_bid_micros, first.ad_id);
             });
             return std::make_shared<Ad>(*result);
         }
         
     private:   
+        /*
+         * Lock free read of the shared budget store, see datacache::budget_store. With leases
+         * a campaign without a record is tracked so the slave banker leases for it next pass,
+         * without them it is simply not limited.
+         */
+        bool exhausted(uint32_t campaign_id) const {
+            if (!budgets) {
+                return false;
+            }
+            datacache::budget_snapshot budget;
+            if (budgets->read(campaign_id, budget)) {
+                return budget.limit == 0;
+            }
+            if (bidder_caches.config.data().budget_lease) {
+                budgets->track(campaign_id);
+                return true;
+            }
+            return false;
+        }
+
         SpecBidderCaches &bidder_caches;
+        std::unique_ptr<datacache::budget_store<>> budgets;
         std::vector<GeoCampaign> geo_campaigns;
+        std::vector<boost::tuple<uint32_t, uint16_t, uint16_t>> campaign_keys;
+        std::vector<uint32_t> campaign_ids;
+        std::vector<std::pair<uint32_t, uint64_t>> listed_ads;
         std::vector<Ad> retrieved_cached_ads;
         AdSelectionAlg selection_alg;
 };
@@ -12,6 +12,7 @@
 #include <memory>
 #include <iostream>
 #include "ad_selector.hpp"
+#include "rtb/core/string_arena.hpp"
 #include "examples/multiexchange/user_info.hpp"
 
 namespace vanilla {
@@ -23,20 +24,26 @@ namespace vanilla {
         }
     };
     
-    template <>
-    struct request_extractor<VanillaRequest> {
-        static auto request(const VanillaRequest &r) -> decltype(r.request()) {
+    template <typename DSL>
+    struct request_extractor<BasicVanillaRequest<DSL>> {
+        static auto request(const BasicVanillaRequest<DSL> &r) -> decltype(r.request()) {
             return r.request();
         }
     };
     
+    /*
+     * With a string_view DSL the response points to the request for ids copied back and to
+     * strings the bidder makes up ( bid ids, creative code ), the latter are kept until the next bid().
+     */
     template<typename DSL, typename Config = BidderConfig>
     class Bidder {
         using BidRequest  = typename DSL::deserialized_type;
+        using Fields      = typename BidRequest::request_type;
         using BidResponse = typename DSL::serialized_type;
         using Impression  = typename DSL::Impression;
         using SeatBid     = typename DSL::SeatBid;
         using Bid         = typename DSL::Bid;
+        using String      = typename BidResponse::data_type;
 
     public:
         Bidder(BidderCaches<Config> &caches) :
@@ -45,8 +52,9 @@ namespace vanilla {
         template <typename Request , typename ...Info>
         const BidResponse& bid(const Request &vanilla_request, Info && ...) {
             response.clear();
-            auto request = request_extractor<Request>::request(vanilla_request);
-            for (auto &imp : request.imp) {
+            strings.clear();
+            const auto &request = request_extractor<Request>::request(vanilla_request);
+            for (auto &imp : request.get(&Fields::imp)) {
                 buildImpResponse(request, imp);
             }
             return response;
@@ -54,8 +62,9 @@ namespace vanilla {
     private:
         
         inline void addCurrency(const BidRequest& request, const Impression& imp) {
-            if (request.cur.size()) {
-                response.cur = request.cur[0];
+            const auto &cur = request.get(&Fields::cur);
+            if (cur.size()) {
+                response.cur = cur[0];
             } else if (imp.bidfloorcur.length()) {
                 response.cur = imp.bidfloorcur; // Just return back
             }
@@ -67,21 +76,21 @@ namespace vanilla {
             }
             Bid bid;
             boost::uuids::uuid bidid = uuid_generator();
-            bid.id = boost::uuids::to_string(bidid); // TODO check documentation 
+            bid.id = strings.keep<String>(boost::uuids::to_string(bidid)); // TODO check documentation 
             // Is it the same as response.bidid?
             bid.impid = imp.id;
             bid.price = ad->max_bid_micros / 1000000.0; // Not micros?
             bid.w = ad->width;
             bid.h = ad->height;
-            bid.adm = ad->code;
-            bid.adid = ad->ad_id;
+            bid.adm = strings.keep<String>(std::move(ad->code));
+            bid.adid = strings.keep<String>(std::to_string(ad->ad_id));
             response.seatbid.back().bid.emplace_back(std::move(bid));
         }
 
         inline void buildImpResponse(const BidRequest& request, const Impression& imp) {
             if (auto ad = selector.select(request, imp)) {
                 boost::uuids::uuid bidid = uuid_generator();
-                response.bidid = boost::uuids::to_string(bidid);
+                response.bidid = strings.keep<String>(boost::uuids::to_string(bidid));
 
                 addCurrency(request, imp);
                 addBid(request, imp, ad);
@@ -90,6 +99,7 @@ namespace vanilla {
         vanilla::AdSelector<Config> selector;
         boost::uuids::random_generator uuid_generator;
         BidResponse response;
+        string_arena strings;
     };
 }
 #endif /* VANILLA_BIDDER_HPP */
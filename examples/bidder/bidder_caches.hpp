@@ -13,8 +13,10 @@
 #include "geo.hpp"
 #include "geo_campaign.hpp"
 #include "campaign_data.hpp"
+#include "geo_size_ads.hpp"
 #include "rtb/core/openrtb.hpp"
 #include "rtb/common/perf_timer.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
 
 namespace vanilla {
 template<typename Config = BidderConfig>
@@ -24,32 +26,61 @@ struct BidderCaches {
             config(config),
             ad_data_entity(config),
             geo_data_entity(config), 
-            geo_campaign_entity(config)
+            geo_campaign_entity(config),
+            campaign_data_entity(config),
+            geo_size_ads_entity(config)
         {}        
+        //source caches are independent and loaded concurrently, geo_size_ads is built once they are done
         void load() noexcept(false) {
             auto sp = std::make_shared<std::stringstream>();
+            auto ad_sp = std::make_shared<std::stringstream>();
+            auto geo_data_sp = std::make_shared<std::stringstream>();
+            auto geo_campaign_sp = std::make_shared<std::stringstream>();
+            auto campaign_data_sp = std::make_shared<std::stringstream>();
             {
                 perf_timer<std::stringstream> timer(sp, "\nselector load");
+                datacache::tsv::load_concurrently(
+                    [&]() {
+                        perf_timer<std::stringstream> timer(ad_sp, "\nad load");
+                        ad_data_entity.load();
+                    },
+                    [&]() {
+                        perf_timer<std::stringstream> timer(geo_data_sp, "\ngeo_data load");
+                        geo_data_entity.load();
+                    },
+                    [&]() {
+                        perf_timer<std::stringstream> timer(geo_campaign_sp, "\ngeo_campaign load");
+                        geo_campaign_entity.load();
+                    },
+                    [&]() {
+                        perf_timer<std::stringstream> timer(campaign_data_sp, "\ncampaign_data load");
+                        campaign_data_entity.load();
+                    }
+                );
                 {
-                    perf_timer<std::stringstream> timer(sp, "\nad load");
-                    ad_data_entity.load();
-                }
-                {
-                   perf_timer<std::stringstream> timer(sp, "\ngeo_data load");
-                    geo_data_entity.load();
-                }
-                {
-                   perf_timer<std::stringstream> timer(sp, "\ngeo_campaign load");
-                   geo_campaign_entity.load();
+                   perf_timer<std::stringstream> timer(sp, "\ngeo_size_ads build");
+                   geo_size_ads_entity.load();
                 }
                 // load others
             }
-            LOG(info) << sp->str() ;
+            LOG(info) << ad_sp->str() << geo_data_sp->str() << geo_campaign_sp->str() << campaign_data_sp->str() << sp->str() ;
+        }
+        //datacache::cache_stats of every cache, one per line
+        std::string stats() const {
+            std::stringstream ss;
+            ss << ad_data_entity.stats() << "\n"
+               << geo_data_entity.stats() << "\n"
+               << geo_campaign_entity.stats() << "\n"
+               << campaign_data_entity.stats() << "\n"
+               << geo_size_ads_entity.stats() << "\n";
+            return ss.str();
         }
         const Config &config;
         AdDataEntity<Config> ad_data_entity;
-        GeoDataEntity<Config> geo_data_entity;
+        GeoIdDataEntity<Config> geo_data_entity;
         GeoCampaignEntity<Config> geo_campaign_entity;
+        CampaignDataEntity<Config> campaign_data_entity; // ads of a campaign that may be selected, all when empty
+        GeoSizeAdsEntity<Config> geo_size_ads_entity; // derived from the caches above, rebuilt after a reload of any of them
 };
 }
 
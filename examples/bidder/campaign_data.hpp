@@ -10,6 +10,8 @@
 
 #include "config.hpp"
 #include "rtb/common/split_string.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
+#include "rtb/datacache/delta_record.hpp"
 #include "core/tagged_tuple.hpp"
 #if BOOST_VERSION <= 106000
 #include <boost/utility/string_ref.hpp>
@@ -20,6 +22,8 @@ namespace boost {
 #include <boost/utility/string_view.hpp>
 #endif
 #include <boost/lexical_cast.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <fstream>
 #include <iterator>
 
 
@@ -61,15 +65,18 @@ struct CampaignData {
         if (!std::getline(is, record) ){
             return is;
         }
-        std::vector<boost::string_view> fields;
-        vanilla::common::split_string(fields, record, "\t");
-        if(fields.size() < 2) {
-            return is;
-        }
-        data.campaign_id = boost::lexical_cast<uint32_t>(fields.at(0).begin(), fields.at(0).size());
-        data.ad_id = boost::lexical_cast<uint32_t>(fields.at(1).begin(), fields.at(1).size());
+        parse(record, data);
         return is;
     }
+    //campaign_id ad_id
+    static bool parse(boost::string_view record, CampaignData &data) {
+        boost::string_view fields[3]; // trailing columns are ignored
+        if ( datacache::tsv::split(record, '\t', fields, 3) < 2 ) {
+            return false;
+        }
+        return datacache::tsv::parse_number(fields[0], data.campaign_id) &&
+               datacache::tsv::parse_number(fields[1], data.ad_id);
+    }
 
     template<typename Key>
     void store(Key && key, const CampaignData  & data)  {
@@ -108,13 +115,35 @@ boost::multi_index_container<
     boost::interprocess::allocator<CampaignData,typename Alloc::segment_manager>
 > ;
 
+//hashed variant, O(1) lookup on campaign_id, the second index only keeps records unique
+template<typename Alloc>
+using campaign_data_hashed_container =
+boost::multi_index_container<
+    CampaignData,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename CampaignData::campaign_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(CampaignData,uint32_t,campaign_id)
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+              CampaignData,
+              BOOST_MULTI_INDEX_MEMBER(CampaignData,uint32_t,campaign_id),
+              BOOST_MULTI_INDEX_MEMBER(CampaignData,uint32_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<CampaignData,typename Alloc::segment_manager>
+> ;
+
 }}
 
 template <typename Config = BidderConfig,
-          typename Memory = typename mpclmi::ipc::Shared,
-          typename Alloc = typename datacache::entity_cache<Memory, ipc::data::campaign_data_container>::char_allocator >
+          typename Memory = typename mpclmi::ipc::Configured,
+          template<class> class Container = ipc::data::campaign_data_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
 class CampaignDataEntity {
-        using Cache = datacache::entity_cache<Memory, ipc::data::campaign_data_container> ;
+        using Cache = datacache::entity_cache<Memory, Container> ;
         using CampaignTag = typename CampaignData::campaign_id_tag;
         using Keys = vanilla::tagged_tuple<CampaignTag, uint32_t>;
     public:    
@@ -122,34 +151,87 @@ class CampaignDataEntity {
         CampaignDataEntity(const Config &config):
             config{config}, cache(config.data().campaign_data_ipc_name)
         {}
+        //the source is optional, without the file the cache is emptied and no ad is filtered by it
         void load() noexcept(false) {
-            std::ifstream in{config.data().campaign_data_source};
-            if (!in) {
-                throw std::runtime_error(std::string("could not open file ") + config.data().campaign_data_source + " exiting...");
+            std::vector<std::pair<Keys, CampaignData>> campaigns;
+            if ( std::ifstream{config.data().campaign_data_source}.is_open() ) {
+                auto rejected = datacache::tsv::parse(config.data().campaign_data_source, campaigns, [](boost::string_view record, std::pair<Keys, CampaignData> &data) {
+                    if ( !CampaignData::parse(record, data.second) ) {
+                        return false;
+                    }
+                    data.first = Keys{data.second.campaign_id};
+                    return true;
+                });
+                LOG(debug) << "File parsed " << config.data().campaign_data_source << " records " << campaigns.size() << " rejected " << rejected;
+            } else {
+                LOG(debug) << "No campaign_data " << config.data().campaign_data_source << " all ads of a campaign are selected";
             }
-            LOG(debug) << "File opened " << config.data().campaign_data_source;
-            cache.clear();
-            
-            std::for_each(std::istream_iterator<CampaignData>(in), std::istream_iterator<CampaignData>(), [this](const CampaignData &data) {
-                if (!this->cache.insert(Keys{data.campaign_id}, data) ) {
-                    LOG(debug) << "Failed to insert campaign_data=" << data.campaign_id;
-                }
+            std::sort(campaigns.begin(), campaigns.end(), [](const auto &l, const auto &r) {
+                return std::tie(l.second.campaign_id, l.second.ad_id) < std::tie(r.second.campaign_id, r.second.ad_id);
             });
+            auto inserted = cache.reload(campaigns.begin(), campaigns.end());
+            if ( inserted != campaigns.size() ) {
+                LOG(debug) << "Failed to insert " << campaigns.size() - inserted << " campaign_data records";
+            }
         }
         
+        //delta file of campaign_data source records, see datacache::parse_delta and entity_cache::apply_delta
+        std::size_t apply_delta(const std::string &delta_source) noexcept(false) {
+            return apply_delta(delta_source, [](const auto &) {});
+        }
+        //visitor(const delta_record &) on every parsed record before the batch is applied
+        template<typename Visitor>
+        std::size_t apply_delta(const std::string &delta_source, Visitor && visitor) noexcept(false) {
+            using Delta = datacache::delta_record<Keys, CampaignData>;
+            std::vector<Delta> deltas;
+            auto rejected = datacache::tsv::parse(delta_source, deltas, [](boost::string_view record, Delta &delta) {
+                if ( !datacache::parse_delta(record, delta, &CampaignData::parse) ) {
+                    return false;
+                }
+                delta.first = Keys{delta.second.campaign_id};
+                return true;
+            });
+            std::for_each(deltas.begin(), deltas.end(), visitor);
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "Delta " << delta_source << " applied " << applied << " of " << deltas.size()
+                       << " rejected " << rejected << " sequence " << cache.sequence();
+            return applied;
+        }
+        uint64_t sequence() const {
+            return cache.sequence();
+        }
+        //visitor(const CampaignData &) on every record in place, see entity_cache::visit_all
+        template <typename Visitor>
+        std::size_t visit_all(Visitor && visitor) {
+            return cache.visit_all(std::forward<Visitor>(visitor));
+        }
         bool retrieve(CampaignDataCollection &campaigns, uint32_t campaign_id) {
-            auto p = cache.template retrieve_raw<CampaignTag>(campaign_id);
-            auto is_found = p.first != p.second;
             campaigns.reserve(500);
-            while ( p.first != p.second ) {
-                CampaignData data;
-                p.first->retrieve(data);
-                campaigns.emplace_back(std::move(data));
-                ++p.first;
-            }
-            return is_found;
+            return cache.template visit<CampaignTag>(campaign_id, [&campaigns](const auto &entity) {
+                campaigns.emplace_back();
+                entity.retrieve(campaigns.back());
+            }) > 0;
+        }
+
+        //ads are filtered by campaign_data only when it has records, see GeoSizeAdsEntity
+        bool filters() const {
+            return cache.size() != 0;
         }
 
+        //visitor(const CampaignData &) on every ad of campaign_id in place, see entity_cache::visit
+        template<typename Visitor>
+        std::size_t visit(uint32_t campaign_id, Visitor && visitor) {
+            return cache.template visit<CampaignTag>(campaign_id, std::forward<Visitor>(visitor));
+        }
+        //keys are campaign ids, sorted in place, all looked up under a single lock, see entity_cache::visit_many
+        template <typename KeyRange, typename Visitor>
+        std::size_t visit_many(KeyRange &keys, Visitor && visitor) {
+            return cache.template visit_many<CampaignTag>(keys, std::forward<Visitor>(visitor));
+        }
+
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
     private:
         const Config &config;
         Cache cache;
@@ -20,6 +20,16 @@ struct bidder_config_data {
     std::string geo_campaign_source;
     std::string campaign_data_source;
     std::string campaign_data_ipc_name;
+    std::string geo_size_ads_ipc_name;
+    std::string dictionary_ipc_name;
+    std::string memory_backend;
+    std::string cache_base_dir;
+    bool warm_start;
+    bool huge_pages;
+    std::string budget_ipc_name;
+    bool budget_lease;
+    bool zero_copy;
+    bool lazy;
     std::string key_value_host;
     int key_value_port;
     int timeout;
@@ -36,6 +46,8 @@ struct bidder_config_data {
         geo_source{}, geo_ipc_name{}, geo_campaign_ipc_name{},
         geo_campaign_source{},
         campaign_data_source{}, campaign_data_ipc_name{},
+        geo_size_ads_ipc_name{}, dictionary_ipc_name{},
+        memory_backend{}, cache_base_dir{}, warm_start{}, huge_pages{}, budget_ipc_name{}, budget_lease{}, zero_copy{}, lazy{},
         key_value_host{}, key_value_port{}, 
         timeout{}, concurrency{},
         port{}, host{}, root{}, num_of_bidders{}
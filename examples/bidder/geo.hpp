@@ -16,6 +16,10 @@
 #include <boost/algorithm/string/case_conv.hpp>
 #include "core/tagged_tuple.hpp"
 #include "config.hpp"
+#include "rtb/datacache/string_dictionary.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
+#include "rtb/datacache/delta_record.hpp"
+#include "examples/datacache/city_country_id_entity.hpp"
 
 struct Geo {
     uint32_t geo_id;
@@ -46,23 +50,30 @@ struct Geo {
         if ( !std::getline(is, l.record) ){
             return is;
         }
-        std::vector<std::string> fields;
-        boost::split(fields, l.record, boost::is_any_of("\t"), boost::token_compress_on);
-        if(fields.size() < 3) {
-            return is;
-        }
-        l.geo_id = atol(fields.at(0).c_str()); 
-        l.city = fields.at(1);
-        l.country = fields.at(2);
+        parse(l.record, l);
         return is;
     }
+    //geo_id city country, repeated tabs are one delimiter
+    static bool parse(boost::string_view record, Geo &l) {
+        boost::string_view fields[4]; // trailing columns are ignored
+        if ( datacache::tsv::split(record, '\t', fields, 4, true) < 3 ) {
+            return false;
+        }
+        if ( !datacache::tsv::parse_number(fields[0], l.geo_id) ) {
+            return false;
+        }
+        l.city.assign(fields[1].data(), fields[1].size());
+        l.country.assign(fields[2].data(), fields[2].size());
+        return true;
+    }
 };
 
 template <typename Config = BidderConfig,
-          typename Memory = typename mpclmi::ipc::Shared, 
-          typename Alloc = typename datacache::entity_cache<Memory, ipc::data::city_country_container>::char_allocator >
+          typename Memory = typename mpclmi::ipc::Configured, 
+          template<class> class Container = ipc::data::city_country_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
 class GeoDataEntity {
-        using Cache = datacache::entity_cache<Memory, ipc::data::city_country_container> ; 
+        using Cache = datacache::entity_cache<Memory, Container> ; 
         using Keys = vanilla::tagged_tuple<
             typename ipc::data::city_country_entity<Alloc>::city_tag,    std::string, 
             typename ipc::data::city_country_entity<Alloc>::country_tag, std::string
@@ -74,25 +85,41 @@ class GeoDataEntity {
             config{config}, cache(config.data().geo_ipc_name)
         {}
         void load() noexcept(false) {
-            std::ifstream in{config.data().geo_source};
-            if (!in) {
-                throw std::runtime_error(std::string("could not open file ") + config.data().geo_source + " exiting...");
-            }
-            LOG(debug) << "File opened " << config.data().geo_source;
-            cache.clear();
-            
-            std::for_each(std::istream_iterator<Geo>(in), std::istream_iterator<Geo>(), [&](const Geo &geo){
-                using namespace boost::algorithm;
-                if(!cache.insert(Keys{to_lower_copy(geo.city), to_lower_copy(geo.country)}, geo)) {
-                    //LOG(debug) << "Adding city " << geo.city << " country " << geo.country << " failed!";
-                }
-                else {
-                    //LOG(debug) << "Adding city " << geo.city << " country " << geo.country << " done";
+            std::vector<std::pair<Keys, Geo>> geos;
+            auto rejected = datacache::tsv::parse(config.data().geo_source, geos, [](boost::string_view record, std::pair<Keys, Geo> &geo) {
+                if ( !Geo::parse(record, geo.second) ) {
+                    return false;
                 }
-                
+                using namespace boost::algorithm;
+                geo.first = Keys{to_lower_copy(geo.second.city), to_lower_copy(geo.second.country)};
+                return true;
             });
+            LOG(debug) << "File parsed " << config.data().geo_source << " cities " << geos.size() << " rejected " << rejected;
+            std::sort(geos.begin(), geos.end(), [](const auto &l, const auto &r) { return l.first < r.first; });
+            auto inserted = cache.reload(geos.begin(), geos.end());
+            LOG(debug) << "Loaded " << inserted << " of " << geos.size() << " cities";
         }
 
+        //delta file of geo source records, see datacache::parse_delta and entity_cache::apply_delta
+        std::size_t apply_delta(const std::string &delta_source) noexcept(false) {
+            using Delta = datacache::delta_record<Keys, Geo>;
+            std::vector<Delta> deltas;
+            auto rejected = datacache::tsv::parse(delta_source, deltas, [](boost::string_view record, Delta &delta) {
+                if ( !datacache::parse_delta(record, delta, &Geo::parse) ) {
+                    return false;
+                }
+                using namespace boost::algorithm;
+                delta.first = Keys{to_lower_copy(delta.second.city), to_lower_copy(delta.second.country)};
+                return true;
+            });
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "Delta " << delta_source << " applied " << applied << " of " << deltas.size()
+                       << " rejected " << rejected << " sequence " << cache.sequence();
+            return applied;
+        }
+        uint64_t sequence() const {
+            return cache.sequence();
+        }
         bool retrieve(DataVect &vect, const std::string &city, const std::string &country) {
             return cache.template retrieve<CityCountryTag>(vect, city, country);
         }
@@ -101,11 +128,128 @@ class GeoDataEntity {
             return cache.template retrieve<CityCountryTag>(geo, city, country);
         }
 
+        //geo_id only, city and country are not copied out of the cache
+        bool retrieve_hot(Geo &geo, const std::string &city, const std::string &country) {
+            return cache.template visit<CityCountryTag>(city, country, [&geo](const auto &entity) {
+                entity.retrieve_hot(geo);
+            }) > 0;
+        }
+
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
     private:
         const Config &config;
         Cache cache;
         
 };
 
+/*
+ * GeoDataEntity keyed by string_dictionary ids of city and country, the dictionary is
+ * shared by all id keyed caches of the host and the cache itself is "<geo_ipc_name>-id".
+ * Request strings are looked up as they are, case is folded by the dictionary hash.
+ */
+template <typename Config = BidderConfig,
+          typename Memory = typename mpclmi::ipc::Configured, 
+          template<class> class Container = ipc::data::city_country_id_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
+class GeoIdDataEntity {
+        using Cache = datacache::entity_cache<Memory, Container> ; 
+        using Entity = typename Cache::Data_t;
+        using Keys = vanilla::tagged_tuple<
+            typename Entity::city_tag,    uint32_t, 
+            typename Entity::country_tag, uint32_t
+        >;
+        using CityCountryTag = typename Entity::unique_city_country_tag;
+        using GeoTag = typename Entity::geo_id_tag;
+        using Dictionary = datacache::string_dictionary<Memory>;
+    public:    
+        GeoIdDataEntity(const Config &config):
+            config{config}, dictionary(config.data().dictionary_ipc_name), cache(config.data().geo_ipc_name + "-id")
+        {}
+        void load() noexcept(false) {
+            //parsed in parallel, dictionary interning takes its write lock so it stays sequential
+            std::vector<std::pair<Keys, Geo>> geos;
+            auto rejected = datacache::tsv::parse(config.data().geo_source, geos, [](boost::string_view record, std::pair<Keys, Geo> &geo) {
+                return Geo::parse(record, geo.second);
+            });
+            LOG(debug) << "File parsed " << config.data().geo_source << " cities " << geos.size() << " rejected " << rejected;
+            for ( auto &geo : geos ) {
+                geo.first = Keys{dictionary.intern(geo.second.city), dictionary.intern(geo.second.country)};
+            }
+            std::sort(geos.begin(), geos.end(), [](const auto &l, const auto &r) { return l.first < r.first; });
+            auto inserted = cache.reload(geos.begin(), geos.end());
+            LOG(debug) << "Loaded " << inserted << " of " << geos.size() << " cities, dictionary size " << dictionary.size();
+        }
+
+        //delta file of geo source records, see datacache::parse_delta and entity_cache::apply_delta
+        std::size_t apply_delta(const std::string &delta_source) noexcept(false) {
+            return apply_delta(delta_source, [](const auto &) {});
+        }
+        //visitor(const delta_record &) on every parsed record before the batch is applied
+        template<typename Visitor>
+        std::size_t apply_delta(const std::string &delta_source, Visitor && visitor) noexcept(false) {
+            using Delta = datacache::delta_record<Keys, Geo>;
+            std::vector<Delta> deltas;
+            auto rejected = datacache::tsv::parse(delta_source, deltas, [](boost::string_view record, Delta &delta) {
+                return datacache::parse_delta(record, delta, &Geo::parse);
+            });
+            //interned after the parallel parse, see load()
+            for ( auto &delta : deltas ) {
+                delta.first = Keys{dictionary.intern(delta.second.city), dictionary.intern(delta.second.country)};
+            }
+            std::for_each(deltas.begin(), deltas.end(), visitor);
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "Delta " << delta_source << " applied " << applied << " of " << deltas.size()
+                       << " rejected " << rejected << " sequence " << cache.sequence();
+            return applied;
+        }
+        uint64_t sequence() const {
+            return cache.sequence();
+        }
+        //visitor(const Entity &) on every record in place, see entity_cache::visit_all
+        template <typename Visitor>
+        std::size_t visit_all(Visitor && visitor) {
+            return cache.visit_all(std::forward<Visitor>(visitor));
+        }
+        //city and country are returned case folded
+        template<typename String>
+        bool retrieve(Geo &geo, const String &city, const String &country) {
+            if ( !retrieve_hot(geo, city, country) ) {
+                return false;
+            }
+            geo.city = dictionary.view(dictionary.find({city.data(), city.size()})).to_string();
+            geo.country = dictionary.view(dictionary.find({country.data(), country.size()})).to_string();
+            return true;
+        }
+
+        //geo_id only, any string type with data() and size(), nothing is copied or lowercased
+        template<typename String>
+        bool retrieve_hot(Geo &geo, const String &city, const String &country) {
+            const auto city_id = dictionary.find({city.data(), city.size()});
+            const auto country_id = dictionary.find({country.data(), country.size()});
+            if ( city_id == Dictionary::NOT_FOUND || country_id == Dictionary::NOT_FOUND ) {
+                return false;
+            }
+            return cache.template visit<CityCountryTag>(city_id, country_id, [&geo](const Entity &entity) {
+                entity.retrieve_hot(geo);
+            }) > 0;
+        }
+
+        //visitor(const Entity &) on every city of geo_id in place, see entity_cache::visit
+        template<typename Visitor>
+        std::size_t visit(uint32_t geo_id, Visitor && visitor) {
+            return cache.template visit<GeoTag>(geo_id, std::forward<Visitor>(visitor));
+        }
+
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
+    private:
+        const Config &config;
+        Dictionary dictionary;
+        Cache cache;
+};
+
 #endif /* BIDDER_GEO_HPP */
 
@@ -68,10 +68,11 @@ struct GeoAd {
 
 
 template <typename Config = BidderConfig,
-          typename Memory = typename mpclmi::ipc::Shared,
-          typename Alloc = typename datacache::entity_cache<Memory, ipc::data::geo_container>::char_allocator >
+          typename Memory = typename mpclmi::ipc::Configured,
+          template<class> class Container = ipc::data::geo_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
 class GeoAdDataEntity {
-        using Cache = datacache::entity_cache<Memory, ipc::data::geo_container> ; 
+        using Cache = datacache::entity_cache<Memory, Container> ; 
         using Keys = vanilla::tagged_tuple< 
             typename ipc::data::geo_entity<Alloc>::geo_id_tag,   uint32_t
         >;
@@ -89,31 +90,32 @@ class GeoAdDataEntity {
           throw std::runtime_error(std::string("could not open file ") + config.data().geo_ad_source + " exiting...");
         }
         LOG(debug) << "File opened " << config.data().geo_ad_source;
-        cache.clear();
- 
+        std::vector<std::pair<Keys, GeoAd>> geo_ads;
         std::for_each(std::istream_iterator<GeoAd>(in), std::istream_iterator<GeoAd>(), [&](const GeoAd &geo_ad) {
-           if (!cache.insert(Keys{geo_ad.geo_id}, geo_ad) ) {
-              LOG(debug) << "Failed to insert geo_ad=" << geo_ad;
-           }
+            geo_ads.emplace_back(Keys{geo_ad.geo_id}, geo_ad);
         });
+        std::sort(geo_ads.begin(), geo_ads.end(), [](const auto &l, const auto &r) {
+            return std::tie(l.second.geo_id, l.second.ad_id) < std::tie(r.second.geo_id, r.second.ad_id);
+        });
+        auto inserted = cache.reload(geo_ads.begin(), geo_ads.end());
+        if ( inserted != geo_ads.size() ) {
+            LOG(debug) << "Failed to insert " << geo_ads.size() - inserted << " geo_ad records";
+        }
     }
 
     bool retrieve(DataVect &geo_ads, uint32_t geo_id) {
-        auto p = cache.template retrieve_raw<GeoTag>(geo_id);
-        auto is_found = p.first != p.second;
         //TODO: random_access<> #include <boost/multi_index/random_access_index.hpp
-        //this should give us ability to do geo_ads.reserve(std::distance(p.first,p.second))
+        //this should give us ability to reserve the number of records of geo_id
         geo_ads.reserve(500);
-        while ( p.first != p.second ) {
-            GeoAd data;
-            p.first->retrieve(data);
-            geo_ads.emplace_back(std::move(data));
-            ++p.first;
-        }
-
-        return is_found;
+        return cache.template visit<GeoTag>(geo_id, [&geo_ads](const auto &entity) {
+            geo_ads.emplace_back();
+            entity.retrieve(geo_ads.back());
+        }) > 0;
     }
 
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
     private:
         const Config &config;
         Cache cache;
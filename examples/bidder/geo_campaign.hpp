@@ -10,6 +10,8 @@
 
 #include "config.hpp"
 #include "rtb/common/split_string.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
+#include "rtb/datacache/delta_record.hpp"
 #include "core/tagged_tuple.hpp"
 #if BOOST_VERSION <= 106000
 #include <boost/utility/string_ref.hpp>
@@ -20,6 +22,7 @@ namespace boost {
 #include <boost/utility/string_view.hpp>
 #endif
 #include <boost/lexical_cast.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <iterator>
 
 //This struct gets stored in the cache
@@ -28,6 +31,7 @@ struct GeoCampaign {
     uint32_t campaign_id;
      
     struct geo_id_tag{};
+    struct campaign_id_tag{};
 
     GeoCampaign() :
         geo_id{} , campaign_id{}
@@ -55,15 +59,18 @@ struct GeoCampaign {
         if (!std::getline(is, record) ){
             return is;
         }
-        std::vector<boost::string_view> fields;
-        vanilla::common::split_string(fields, record, "\t");
-        if(fields.size() < 2) {
-            return is;
-        }
-        data.geo_id = boost::lexical_cast<uint32_t>(fields.at(0).begin(), fields.at(0).size());
-        data.campaign_id = boost::lexical_cast<uint32_t>(fields.at(1).begin(), fields.at(1).size());
+        parse(record, data);
         return is;
     }
+    //geo_id campaign_id
+    static bool parse(boost::string_view record, GeoCampaign &data) {
+        boost::string_view fields[3]; // trailing columns are ignored
+        if ( datacache::tsv::split(record, '\t', fields, 3) < 2 ) {
+            return false;
+        }
+        return datacache::tsv::parse_number(fields[0], data.geo_id) &&
+               datacache::tsv::parse_number(fields[1], data.campaign_id);
+    }
 
 
     template<typename Key>
@@ -99,6 +106,35 @@ boost::multi_index_container<
               BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,geo_id),
               BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,campaign_id)
             >
+        >,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<typename GeoCampaign::campaign_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,campaign_id)
+        >
+    >,
+    boost::interprocess::allocator<GeoCampaign,typename Alloc::segment_manager>
+> ;
+
+//hashed variant, O(1) lookup on geo_id, the second index only keeps records unique, the third finds geos of a campaign
+template<typename Alloc>
+using geo_campaign_hashed_container =
+boost::multi_index_container<
+    GeoCampaign,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename GeoCampaign::geo_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,geo_id)
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+              GeoCampaign,
+              BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,geo_id),
+              BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,campaign_id)
+            >
+        >,
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename GeoCampaign::campaign_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(GeoCampaign,uint32_t,campaign_id)
         >
     >,
     boost::interprocess::allocator<GeoCampaign,typename Alloc::segment_manager>
@@ -107,11 +143,13 @@ boost::multi_index_container<
 }}
 
 template <typename Config = BidderConfig,
-          typename Memory = typename mpclmi::ipc::Shared,
-          typename Alloc = typename datacache::entity_cache<Memory, ipc::data::geo_campaign_container>::char_allocator >
+          typename Memory = typename mpclmi::ipc::Configured,
+          template<class> class Container = ipc::data::geo_campaign_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
 class GeoCampaignEntity {
-        using Cache = datacache::entity_cache<Memory, ipc::data::geo_campaign_container> ;
+        using Cache = datacache::entity_cache<Memory, Container> ;
         using GeoTag = typename GeoCampaign::geo_id_tag;
+        using CampaignTag = typename GeoCampaign::campaign_id_tag;
         using Keys = vanilla::tagged_tuple<GeoTag, uint32_t>;
     public:
         using GeoCampaignCollection = std::vector<GeoCampaign>;
@@ -119,33 +157,77 @@ class GeoCampaignEntity {
             config{config}, cache(config.data().geo_campaign_ipc_name)
         {}
         void load() noexcept(false) {
-            std::ifstream in{config.data().geo_campaign_source};
-            if (!in) {
-                throw std::runtime_error(std::string("could not open file ") + config.data().geo_campaign_source + " exiting...");
-            }
-            LOG(debug) << "File opened " << config.data().geo_campaign_source;
-            cache.clear();
-            
-            std::for_each(std::istream_iterator<GeoCampaign>(in), std::istream_iterator<GeoCampaign>(), [this](const GeoCampaign &data) {
-                if (!this->cache.insert(Keys{data.geo_id}, data)) {
-                    LOG(debug) << "Failed to insert geo_campaign=" << data;
+            std::vector<std::pair<Keys, GeoCampaign>> geo_campaigns;
+            auto rejected = datacache::tsv::parse(config.data().geo_campaign_source, geo_campaigns, [](boost::string_view record, std::pair<Keys, GeoCampaign> &data) {
+                if ( !GeoCampaign::parse(record, data.second) ) {
+                    return false;
                 }
+                data.first = Keys{data.second.geo_id};
+                return true;
             });
+            LOG(debug) << "File parsed " << config.data().geo_campaign_source << " records " << geo_campaigns.size() << " rejected " << rejected;
+            std::sort(geo_campaigns.begin(), geo_campaigns.end(), [](const auto &l, const auto &r) {
+                return std::tie(l.second.geo_id, l.second.campaign_id) < std::tie(r.second.geo_id, r.second.campaign_id);
+            });
+            auto inserted = cache.reload(geo_campaigns.begin(), geo_campaigns.end());
+            if ( inserted != geo_campaigns.size() ) {
+                LOG(debug) << "Failed to insert " << geo_campaigns.size() - inserted << " geo_campaign records";
+            }
         }
         
+        //delta file of geo_campaign source records, see datacache::parse_delta and entity_cache::apply_delta
+        std::size_t apply_delta(const std::string &delta_source) noexcept(false) {
+            return apply_delta(delta_source, [](const auto &) {});
+        }
+        //visitor(const delta_record &) on every parsed record before the batch is applied
+        template<typename Visitor>
+        std::size_t apply_delta(const std::string &delta_source, Visitor && visitor) noexcept(false) {
+            using Delta = datacache::delta_record<Keys, GeoCampaign>;
+            std::vector<Delta> deltas;
+            auto rejected = datacache::tsv::parse(delta_source, deltas, [](boost::string_view record, Delta &delta) {
+                if ( !datacache::parse_delta(record, delta, &GeoCampaign::parse) ) {
+                    return false;
+                }
+                delta.first = Keys{delta.second.geo_id};
+                return true;
+            });
+            std::for_each(deltas.begin(), deltas.end(), visitor);
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "Delta " << delta_source << " applied " << applied << " of " << deltas.size()
+                       << " rejected " << rejected << " sequence " << cache.sequence();
+            return applied;
+        }
+        uint64_t sequence() const {
+            return cache.sequence();
+        }
+        //visitor(const GeoCampaign &) on every record in place, see entity_cache::visit_all
+        template <typename Visitor>
+        std::size_t visit_all(Visitor && visitor) {
+            return cache.visit_all(std::forward<Visitor>(visitor));
+        }
         bool retrieve(GeoCampaignCollection &geo_campaigns, uint32_t geo_id) {
-            auto p = cache.template retrieve_raw<GeoTag>(geo_id);
-            auto is_found = p.first != p.second;
             geo_campaigns.reserve(500);
-            while ( p.first != p.second ) {
-                GeoCampaign data;
-                p.first->retrieve(data);
-                geo_campaigns.emplace_back(std::move(data));
-                ++p.first;
-            }
-            return is_found;
+            return cache.template visit<GeoTag>(geo_id, [&geo_campaigns](const auto &entity) {
+                geo_campaigns.emplace_back();
+                entity.retrieve(geo_campaigns.back());
+            }) > 0;
+        }
+
+        //visitor(const GeoCampaign &) on every campaign of geo_id in place, see entity_cache::visit
+        template<typename Visitor>
+        std::size_t visit(uint32_t geo_id, Visitor && visitor) {
+            return cache.template visit<GeoTag>(geo_id, std::forward<Visitor>(visitor));
+        }
+
+        //visitor(const GeoCampaign &) on every geo of campaign_id in place
+        template<typename Visitor>
+        std::size_t visit_campaign(uint32_t campaign_id, Visitor && visitor) {
+            return cache.template visit<CampaignTag>(campaign_id, std::forward<Visitor>(visitor));
         }
 
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
     private:
         const Config &config;
         Cache cache;
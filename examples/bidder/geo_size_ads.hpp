@@ -0,0 +1,483 @@
+/*
+ * File:   geo_size_ads.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef GEO_SIZE_ADS_HPP
+#define GEO_SIZE_ADS_HPP
+
+#include "config.hpp"
+#include "ad.hpp"
+#include "geo.hpp"
+#include "geo_campaign.hpp"
+#include "campaign_data.hpp"
+#include "core/tagged_tuple.hpp"
+#include "rtb/datacache/arena.hpp"
+#include "rtb/datacache/entity_cache.hpp"
+#include "rtb/datacache/memory_types.hpp"
+#include "rtb/datacache/tsv_loader.hpp"
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/optional.hpp>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <tuple>
+#include <vector>
+
+/*
+ * Derived cache, nothing reads it from a source file of its own : for every geo_id and
+ * banner size the ads of all campaigns targeting that geo, sorted by max bid descending.
+ * Built from geo, geo_campaign, campaign_data and ads sources and rebuilt whenever one of
+ * them is reloaded, their deltas update only the lists they touch. AdSelector answers
+ * (geo_id, width, height) with one probe instead of geo_campaign lookup followed by one
+ * ads lookup per campaign.
+ */
+struct AdPosting {
+    uint64_t ad_id;
+    uint64_t max_bid_micros;
+    uint32_t campaign_id;
+    uint16_t position;
+
+    void retrieve(Ad &ad, uint16_t width, uint16_t height) const {
+        ad.ad_id = ad_id;
+        ad.campaign_id = campaign_id;
+        ad.width = width;
+        ad.height = height;
+        ad.position = position;
+        ad.max_bid_micros = max_bid_micros;
+    }
+};
+
+struct GeoSizeAds {
+    uint32_t geo_id;
+    uint16_t width;
+    uint16_t height;
+    std::vector<AdPosting> postings;
+
+    GeoSizeAds() :
+        geo_id{}, width{}, height{}, postings{}
+    {}
+    GeoSizeAds(uint32_t geo_id, uint16_t width, uint16_t height) :
+        geo_id{geo_id}, width{width}, height{height}, postings{}
+    {}
+};
+
+namespace ipc { namespace data {
+
+    //posting list is one contiguous array in the segment string_arena, index node holds the handle only
+    template <typename Alloc>
+    struct geo_size_ads_entity {
+        using arena_t = datacache::string_arena<typename Alloc::segment_manager>;
+
+        //for tagging in multi_index_container
+        struct geo_id_tag {};
+        struct width_tag {};
+        struct height_tag {};
+        struct geo_size_tag {}; // search on geo-width-height
+
+        geo_size_ads_entity( const Alloc & a ) :
+            allocator{a},
+            geo_id{},
+            width{},
+            height{},
+            count{},
+            postings{}
+        {} //ctor END
+
+        Alloc allocator;
+        uint32_t geo_id;
+        uint16_t width;
+        uint16_t height;
+        uint32_t count;
+        boost::interprocess::offset_ptr<const AdPosting> postings;
+
+        const AdPosting * begin() const { return postings.get(); }
+        const AdPosting * end() const { return postings.get() + count; }
+
+        template<typename Key>
+        void store(Key && key, const GeoSizeAds & data)  {
+            geo_id = key.template get<geo_id_tag>();
+            width = key.template get<width_tag>();
+            height = key.template get<height_tag>();
+            count = data.postings.size();
+            postings = arena_t::instance(allocator.get_segment_manager()).store_array(data.postings.data(), data.postings.size());
+        }
+
+        //index members only, finds the record a delta removes without storing its postings
+        template<typename Key>
+        void store_key(Key && key, const GeoSizeAds &)  {
+            geo_id = key.template get<geo_id_tag>();
+            width = key.template get<width_tag>();
+            height = key.template get<height_tag>();
+        }
+
+        static std::size_t size(const GeoSizeAds & data) {
+            return data.postings.size() * sizeof(AdPosting);
+        }
+        void retrieve(GeoSizeAds & data) const {
+            data.geo_id = geo_id;
+            data.width = width;
+            data.height = height;
+            data.postings.assign(begin(), end());
+        }
+        //needed for ability to update after matching by calling index.modify(itr,entry)
+        void operator()(geo_size_ads_entity &entry) const {
+            entry.geo_id = geo_id;
+            entry.width = width;
+            entry.height = height;
+            entry.count = count;
+            entry.postings = postings;
+        }
+    };
+
+template<typename Alloc>
+using geo_size_ads_container =
+boost::multi_index_container<
+    geo_size_ads_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            boost::multi_index::tag<typename geo_size_ads_entity<Alloc>::geo_size_tag>,
+            boost::multi_index::composite_key<
+                geo_size_ads_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint32_t,geo_id),
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint16_t,height)
+            >
+        >
+    >,
+    boost::interprocess::allocator<geo_size_ads_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+//hashed variant, O(1) lookup on geo-width-height
+template<typename Alloc>
+using geo_size_ads_hashed_container =
+boost::multi_index_container<
+    geo_size_ads_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_unique<
+            boost::multi_index::tag<typename geo_size_ads_entity<Alloc>::geo_size_tag>,
+            boost::multi_index::composite_key<
+                geo_size_ads_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint32_t,geo_id),
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(geo_size_ads_entity<Alloc>,uint16_t,height)
+            >
+        >
+    >,
+    boost::interprocess::allocator<geo_size_ads_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+}}
+
+template <typename Config = BidderConfig,
+          typename Memory = typename mpclmi::ipc::Configured,
+          template<class> class Container = ipc::data::geo_size_ads_container,
+          typename Alloc = typename datacache::entity_cache<Memory, Container>::char_allocator >
+class GeoSizeAdsEntity {
+        using Cache = datacache::entity_cache<Memory, Container> ;
+        using Entity = typename Cache::Data_t;
+        using Keys = vanilla::tagged_tuple<
+            typename Entity::geo_id_tag, uint32_t,
+            typename Entity::width_tag,  uint16_t,
+            typename Entity::height_tag, uint16_t
+        >;
+        using Tag = typename Entity::geo_size_tag;
+    public:
+        GeoSizeAdsEntity(const Config &config):
+            config{config}, cache(config.data().geo_size_ads_ipc_name)
+        {}
+
+        /*
+         * Joins the sources into posting lists and publishes them with one blue/green reload.
+         * campaign_data is optional, when it has records only ads it lists for a campaign are
+         * kept, same as AdSelector does without this cache.
+         */
+        void load() noexcept(false) {
+            std::vector<uint32_t> geo_ids;
+            datacache::tsv::parse(config.data().geo_source, geo_ids, [](boost::string_view record, uint32_t &geo_id) {
+                Geo geo;
+                if ( !Geo::parse(record, geo) ) {
+                    return false;
+                }
+                geo_id = geo.geo_id;
+                return true;
+            });
+
+            std::vector<GeoCampaign> geo_campaigns;
+            datacache::tsv::parse(config.data().geo_campaign_source, geo_campaigns, &GeoCampaign::parse);
+
+            std::vector<std::pair<uint32_t, uint64_t>> campaign_ads;
+            if ( std::ifstream{config.data().campaign_data_source}.is_open() ) {
+                datacache::tsv::parse(config.data().campaign_data_source, campaign_ads, [](boost::string_view record, std::pair<uint32_t, uint64_t> &campaign_ad) {
+                    CampaignData data;
+                    if ( !CampaignData::parse(record, data) ) {
+                        return false;
+                    }
+                    campaign_ad = std::make_pair(data.campaign_id, uint64_t(data.ad_id));
+                    return true;
+                });
+                std::sort(campaign_ads.begin(), campaign_ads.end());
+            } else {
+                LOG(debug) << "No campaign_data " << config.data().campaign_data_source << " all ads of a campaign are indexed";
+            }
+            const bool filter_ads = !campaign_ads.empty();
+
+            std::vector<Ad> ads;
+            datacache::tsv::parse(config.data().ads_source, ads, [&](boost::string_view record, Ad &ad) {
+                if ( !Ad::parse(record, ad) ) {
+                    return false;
+                }
+                ad.code.clear(); // postings carry fixed size fields only
+                return !filter_ads || std::binary_search(campaign_ads.begin(), campaign_ads.end(), std::make_pair(ad.campaign_id, ad.ad_id));
+            });
+            build(geo_ids, geo_campaigns, ads, filter_ads);
+        }
+
+        /*
+         * Same join over the published source caches instead of the files, they may have
+         * deltas the files don't have ( see apply_delta of the entities and of this one ).
+         * campaign_data filters ads only when it has records.
+         */
+        template<typename Ads, typename Geos, typename GeoCampaigns, typename Campaigns>
+        void load(Ads &ad_entity, Geos &geo_entity, GeoCampaigns &geo_campaign_entity, Campaigns &campaign_data_entity) noexcept(false) {
+            std::vector<uint32_t> geo_ids;
+            geo_entity.visit_all([&geo_ids](const auto &geo) {
+                geo_ids.push_back(geo.geo_id);
+            });
+            std::vector<GeoCampaign> geo_campaigns;
+            geo_campaign_entity.visit_all([&geo_campaigns](const GeoCampaign &data) {
+                geo_campaigns.push_back(data);
+            });
+            std::vector<std::pair<uint32_t, uint64_t>> campaign_ads;
+            campaign_data_entity.visit_all([&campaign_ads](const CampaignData &data) {
+                campaign_ads.emplace_back(data.campaign_id, data.ad_id);
+            });
+            std::sort(campaign_ads.begin(), campaign_ads.end());
+            const bool filter_ads = !campaign_ads.empty();
+            std::vector<Ad> ads;
+            ad_entity.visit_all([&](const auto &entity) {
+                Ad ad;
+                entity.retrieve_hot(ad);
+                if ( !filter_ads || std::binary_search(campaign_ads.begin(), campaign_ads.end(), std::make_pair(ad.campaign_id, ad.ad_id)) ) {
+                    ads.push_back(std::move(ad));
+                }
+            });
+            build(geo_ids, geo_campaigns, ads, filter_ads);
+        }
+
+        /*
+         * Follows one delta of a source cache in place. Records are the source records of the
+         * delta ( Ad, GeoCampaign, CampaignData or Geo ) and the sources have it applied already.
+         * Only posting lists of the (geo_id, width, height) keys the records touch are joined
+         * again from the source caches and applied as a delta of this cache, a list left empty
+         * is removed. campaign_data turning empty or non empty changes the filter of every
+         * list, that one takes a full load() from the caches. Returns number of lists applied.
+         */
+        template<typename Records, typename Ads, typename Geos, typename GeoCampaigns, typename Campaigns>
+        std::size_t apply_delta(const Records &records, Ads &ad_entity, Geos &geo_entity, GeoCampaigns &geo_campaign_entity, Campaigns &campaign_data_entity) noexcept(false) {
+            const bool filter_ads = campaign_data_entity.filters();
+            if ( !filtered || *filtered != filter_ads ) {
+                load(ad_entity, geo_entity, geo_campaign_entity, campaign_data_entity);
+                return cache.stats().entries;
+            }
+            std::vector<Key> keys;
+            for ( const auto &record : records ) {
+                touched(record, keys, ad_entity, geo_campaign_entity);
+            }
+            std::sort(keys.begin(), keys.end());
+            keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+            using Delta = datacache::delta_record<Keys, GeoSizeAds>;
+            std::vector<Delta> deltas(keys.size());
+            auto sequence = cache.sequence();
+            for ( std::size_t i = 0 ; i < keys.size() ; ++i ) {
+                uint32_t geo_id; uint16_t width, height;
+                std::tie(geo_id, width, height) = keys[i];
+                auto &delta = deltas[i];
+                delta.sequence = ++sequence;
+                delta.first = Keys{geo_id, width, height};
+                delta.second = GeoSizeAds{geo_id, width, height};
+                join(delta.second, filter_ads, ad_entity, geo_entity, geo_campaign_entity, campaign_data_entity);
+                delta.op = delta.second.postings.empty() ? datacache::delta_op::remove : datacache::delta_op::upsert;
+            }
+            auto applied = cache.apply_delta(deltas.begin(), deltas.end());
+            LOG(debug) << "geo_size_ads delta of " << records.size() << " source records applied " << applied << " posting lists";
+            return applied;
+        }
+
+        //false until the first load(), selector keeps using the source caches until then
+        bool built() const {
+            return cache.generation() != 0;
+        }
+
+        //visitor(const AdPosting &) highest bid first, in place under the read lock, see entity_cache::visit
+        template <typename Visitor>
+        std::size_t visit(uint32_t geo_id, uint16_t width, uint16_t height, Visitor && visitor) {
+            std::size_t visited{};
+            cache.template visit<Tag>(geo_id, width, height, [&](const Entity &entity) {
+                for ( const auto &posting : entity ) {
+                    visitor(posting);
+                }
+                visited += entity.count;
+            });
+            return visited;
+        }
+
+        bool retrieve(GeoSizeAds &data, uint32_t geo_id, uint16_t width, uint16_t height) {
+            return visit(geo_id, width, height, [&data](const AdPosting &posting) {
+                data.postings.push_back(posting);
+            }) > 0;
+        }
+
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
+    private:
+        using Key = std::tuple<uint32_t, uint16_t, uint16_t>;
+
+        //an ad is in the list of its size in every geo of its campaign
+        template<typename Ads, typename GeoCampaigns>
+        void touched(const Ad &ad, std::vector<Key> &keys, Ads &, GeoCampaigns &geo_campaign_entity) {
+            geo_campaign_entity.visit_campaign(ad.campaign_id, [&](const GeoCampaign &data) {
+                keys.emplace_back(data.geo_id, ad.width, ad.height);
+            });
+        }
+
+        //a campaign is in the lists of its geo for every size it has ads of
+        template<typename Ads, typename GeoCampaigns>
+        void touched(const GeoCampaign &geo_campaign, std::vector<Key> &keys, Ads &ad_entity, GeoCampaigns &) {
+            ad_entity.visit(geo_campaign.campaign_id, [&](const auto &entity) {
+                keys.emplace_back(geo_campaign.geo_id, entity.width, entity.height);
+            });
+        }
+
+        //campaign_data lets one ad of a campaign in, the ad is in the list of its size in every geo of the campaign
+        template<typename Ads, typename GeoCampaigns>
+        void touched(const CampaignData &campaign_data, std::vector<Key> &keys, Ads &ad_entity, GeoCampaigns &geo_campaign_entity) {
+            std::vector<std::pair<uint16_t, uint16_t>> sizes;
+            ad_entity.visit(campaign_data.campaign_id, [&](const auto &entity) {
+                if ( entity.ad_id == campaign_data.ad_id ) {
+                    sizes.emplace_back(entity.width, entity.height);
+                }
+            });
+            geo_campaign_entity.visit_campaign(campaign_data.campaign_id, [&](const GeoCampaign &data) {
+                for ( const auto &size : sizes ) {
+                    keys.emplace_back(data.geo_id, size.first, size.second);
+                }
+            });
+        }
+
+        //a geo has lists for the sizes of the ads of all its campaigns
+        template<typename Ads, typename GeoCampaigns>
+        void touched(const Geo &geo, std::vector<Key> &keys, Ads &ad_entity, GeoCampaigns &geo_campaign_entity) {
+            std::vector<uint32_t> campaign_ids;
+            geo_campaign_entity.visit(geo.geo_id, [&campaign_ids](const GeoCampaign &data) {
+                campaign_ids.push_back(data.campaign_id);
+            });
+            for ( auto campaign_id : campaign_ids ) {
+                ad_entity.visit(campaign_id, [&](const auto &entity) {
+                    keys.emplace_back(geo.geo_id, entity.width, entity.height);
+                });
+            }
+        }
+
+        //one posting list of build() from point lookups into the source caches, empty for an unknown geo
+        template<typename Ads, typename Geos, typename GeoCampaigns, typename Campaigns>
+        void join(GeoSizeAds &data, bool filter_ads, Ads &ad_entity, Geos &geo_entity, GeoCampaigns &geo_campaign_entity, Campaigns &campaign_data_entity) {
+            if ( !geo_entity.visit(data.geo_id, [](const auto &) {}) ) {
+                return;
+            }
+            std::vector<uint32_t> campaign_ids;
+            geo_campaign_entity.visit(data.geo_id, [&campaign_ids](const GeoCampaign &geo_campaign) {
+                campaign_ids.push_back(geo_campaign.campaign_id);
+            });
+            std::sort(campaign_ids.begin(), campaign_ids.end());
+            campaign_ids.erase(std::unique(campaign_ids.begin(), campaign_ids.end()), campaign_ids.end());
+            std::vector<uint64_t> ad_ids;
+            for ( auto campaign_id : campaign_ids ) {
+                ad_ids.clear();
+                campaign_data_entity.visit(campaign_id, [&ad_ids](const CampaignData &campaign_data) {
+                    ad_ids.push_back(campaign_data.ad_id);
+                });
+                std::sort(ad_ids.begin(), ad_ids.end());
+                ad_entity.visit(campaign_id, data.width, data.height, [&](const auto &entity) {
+                    if ( !filter_ads || std::binary_search(ad_ids.begin(), ad_ids.end(), uint64_t(entity.ad_id)) ) {
+                        data.postings.push_back(AdPosting{entity.ad_id, entity.max_bid_micros, entity.campaign_id, entity.position});
+                    }
+                });
+            }
+            std::sort(data.postings.begin(), data.postings.end(), [](const AdPosting &l, const AdPosting &r) {
+                return std::tie(r.max_bid_micros, l.ad_id) < std::tie(l.max_bid_micros, r.ad_id);
+            });
+        }
+
+        //geo_campaigns of unknown geos are dropped, the rest is joined with ads of their campaigns
+        void build(std::vector<uint32_t> &geo_ids, std::vector<GeoCampaign> &geo_campaigns, std::vector<Ad> &ads, bool filter_ads) {
+            std::sort(geo_ids.begin(), geo_ids.end());
+            geo_campaigns.erase(std::remove_if(geo_campaigns.begin(), geo_campaigns.end(), [&geo_ids](const GeoCampaign &data) {
+                return !std::binary_search(geo_ids.begin(), geo_ids.end(), data.geo_id);
+            }), geo_campaigns.end());
+            std::sort(geo_campaigns.begin(), geo_campaigns.end(), [](const auto &l, const auto &r) {
+                return std::tie(l.geo_id, l.campaign_id) < std::tie(r.geo_id, r.campaign_id);
+            });
+            geo_campaigns.erase(std::unique(geo_campaigns.begin(), geo_campaigns.end(), [](const auto &l, const auto &r) {
+                return l.geo_id == r.geo_id && l.campaign_id == r.campaign_id;
+            }), geo_campaigns.end());
+
+            //posting list order : size groups of the key, highest bid first, ad_id breaks ties
+            std::sort(ads.begin(), ads.end(), [](const Ad &l, const Ad &r) {
+                return std::make_tuple(l.campaign_id, l.width, l.height, r.max_bid_micros, l.ad_id) <
+                       std::make_tuple(r.campaign_id, r.width, r.height, l.max_bid_micros, r.ad_id);
+            });
+
+            std::vector<std::pair<std::tuple<uint32_t, uint16_t, uint16_t>, const Ad *>> joined;
+            for ( const auto &geo_campaign : geo_campaigns ) {
+                auto p = std::equal_range(ads.begin(), ads.end(), geo_campaign.campaign_id, campaign_less{});
+                for ( ; p.first != p.second ; ++p.first ) {
+                    joined.emplace_back(std::make_tuple(geo_campaign.geo_id, p.first->width, p.first->height), &*p.first);
+                }
+            }
+            std::sort(joined.begin(), joined.end(), [](const auto &l, const auto &r) {
+                return std::make_tuple(l.first, r.second->max_bid_micros, l.second->ad_id) <
+                       std::make_tuple(r.first, l.second->max_bid_micros, r.second->ad_id);
+            });
+
+            std::vector<std::pair<Keys, GeoSizeAds>> geo_size_ads;
+            for ( const auto &item : joined ) {
+                uint32_t geo_id; uint16_t width, height;
+                std::tie(geo_id, width, height) = item.first;
+                const auto *last = geo_size_ads.empty() ? nullptr : &geo_size_ads.back().second;
+                if ( !last || std::tie(last->geo_id, last->width, last->height) != item.first ) {
+                    geo_size_ads.emplace_back(Keys{geo_id, width, height}, GeoSizeAds{geo_id, width, height});
+                }
+                const Ad &ad = *item.second;
+                geo_size_ads.back().second.postings.push_back(AdPosting{ad.ad_id, ad.max_bid_micros, ad.campaign_id, ad.position});
+            }
+            auto inserted = cache.reload(geo_size_ads.begin(), geo_size_ads.end());
+            LOG(debug) << "geo_size_ads " << inserted << " posting lists of " << joined.size() << " ads";
+            filtered = filter_ads;
+        }
+
+        struct campaign_less {
+            bool operator()(const Ad &ad, uint32_t campaign_id) const { return ad.campaign_id < campaign_id; }
+            bool operator()(uint32_t campaign_id, const Ad &ad) const { return campaign_id < ad.campaign_id; }
+        };
+
+        const Config &config;
+        Cache cache;
+        boost::optional<bool> filtered; // campaign_data filter of the last build(), unknown before it
+};
+
+#endif /* GEO_SIZE_ADS_HPP */
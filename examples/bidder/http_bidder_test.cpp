@@ -16,6 +16,7 @@
 #include "rtb/exchange/exchange_handler.hpp"
 #include "rtb/exchange/exchange_server.hpp"
 #include "rtb/DSL/generic_dsl.hpp"
+#include "rtb/DSL/lazy_dsl.hpp"
 #include "rtb/config/config.hpp"
 #include "rtb/core/tagged_tuple.hpp"
 #include "rtb/datacache/entity_cache.hpp"
@@ -51,59 +52,12 @@ namespace bidder_decision_codes {
         enum {EXIT=-1, USER_DATA=0, NO_BID, AUCTION_ASYNC, SIZE};
 }
 
-int main(int argc, char *argv[]) {
-    using namespace std::placeholders;
+template<typename DSLT>
+void run(BidderConfig &config, vanilla::BidderCaches<> &caches) {
     using namespace vanilla::exchange;
-    using namespace std::chrono_literals;
     using restful_dispatcher_t =  http::crud::crud_dispatcher<http::server::request, http::server::reply> ;
-    using DSLT = DSL::GenericDSL<> ;
-    using BidRequest = DSLT::deserialized_type;
-    //using BidResponse = DSLT::serialized_type;
-    
-    BidderConfig config([](bidder_config_data &d, boost::program_options::options_description &desc){
-        desc.add_options()
-            ("bidder.log", boost::program_options::value<std::string>(&d.log_file_name), "bidder_test log file name log")
-            ("bidder.ads_source", boost::program_options::value<std::string>(&d.ads_source)->default_value("data/ads"), "ads_source file name")
-            ("bidder.ads_ipc_name", boost::program_options::value<std::string>(&d.ads_ipc_name)->default_value("vanilla-ads-ipc"), "ads ipc name")
-            ("bidder.geo_ad_source", boost::program_options::value<std::string>(&d.geo_ad_source)->default_value("data/ad_geo"), "geo_ad_source file name")
-            ("bidder.geo_ad_ipc_name", boost::program_options::value<std::string>(&d.geo_ad_ipc_name)->default_value("vanilla-geo-ad-ipc"), "geo ad-ipc name")
-            ("bidder.geo_source", boost::program_options::value<std::string>(&d.geo_source)->default_value("data/geo"), "geo_source file name")
-            ("bidder.geo_ipc_name", boost::program_options::value<std::string>(&d.geo_ipc_name)->default_value("vanilla-geo-ipc"), "geo ipc name")
-            ("bidder.port", boost::program_options::value<short>(&d.port)->required(), "bidder port")
-            ("bidder.host", boost::program_options::value<std::string>(&d.host)->default_value("0.0.0.0"), "bidder host")
-            ("bidder.root", boost::program_options::value<std::string>(&d.root)->default_value("."), "bidder root")
-            ("bidder.timeout", boost::program_options::value<int>(&d.timeout), "bidder_test timeout")
-            ("bidder.concurrency", boost::program_options::value<unsigned int>(&d.concurrency)->default_value(0), "bidder concurrency, if 0 is set std::thread::hardware_concurrency()")
-            ("bidder.geo_campaign_ipc_name", boost::program_options::value<std::string>(&d.geo_campaign_ipc_name)->default_value("vanilla-geo-campaign-ipc"), "geo campaign ipc name")
-            ("bidder.geo_campaign_source", boost::program_options::value<std::string>(&d.geo_campaign_source)->default_value("data/geo_campaign"), "geo_campaign_source file name")
-            ("bidder.campaign_data_ipc_name", boost::program_options::value<std::string>(&d.campaign_data_ipc_name)->default_value("vanilla-campaign-data-ipc"), "campaign data ipc name")
-            ("bidder.campaign_data_source", boost::program_options::value<std::string>(&d.campaign_data_source)->default_value("data/campaign_data"), "campaign_data_source file name")
-            ("bidder.key_value_host", boost::program_options::value<std::string>(&d.key_value_host)->default_value("0.0.0.0"), "key value storage host")
-            ("bidder.key_value_port", boost::program_options::value<int>(&d.key_value_port)->default_value(0), "key value storage port")
-        ;
-    });
-    
-    try {
-        config.parse(argc, argv);
-    }
-    catch(std::exception const& e) {
-        LOG(error) << e.what();
-        return 0;
-    }
-    LOG(debug) << config;
-    init_framework_logging(config.data().log_file_name);
-    
-    //vanilla::Selector<> selector(config); 
-    boost::uuids::random_generator uuid_generator{};
-    vanilla::BidderCaches<> caches(config);
-    try {
-        caches.load(); // Not needed if data cache loader is in work
-        //selector.load();
-    }
-    catch(std::exception const& e) {
-        LOG(error) << e.what();
-        return 0;
-    }
+    using BidRequest = typename DSLT::deserialized_type;
+    //using BidResponse = typename DSLT::serialized_type;
     
     using bid_handler_type = exchange_handler<DSLT, vanilla::UserInfo>;   
     using decision_router_type = vanilla::decision::router < bidder_decision_codes::SIZE , 
@@ -134,7 +88,7 @@ int main(int argc, char *argv[]) {
     auto auction_async_f = [&bid_handler](http::server::reply &reply, BidRequest & bid_request, auto&&) {
         return bid_handler.handle_auction_async(reply, bid_request);
     };
-    const decision_router_type::decision_tree_type decision_tree = {{
+    const typename decision_router_type::decision_tree_type decision_tree = {{
         {bidder_decision_codes::USER_DATA, {request_user_data_f, bidder_decision_codes::AUCTION_ASYNC, bidder_decision_codes::NO_BID}},
         {bidder_decision_codes::NO_BID, {no_bid_f, bidder_decision_codes::EXIT, bidder_decision_codes::EXIT}},        
         {bidder_decision_codes::AUCTION_ASYNC, {auction_async_f, bidder_decision_codes::EXIT, bidder_decision_codes::EXIT}}
@@ -171,6 +125,10 @@ int main(int argc, char *argv[]) {
             //r.stock_reply(http::server::reply::ok);
             r << "test" << http::server::reply::flush("text");
         });
+    dispatcher.crud_match(boost::regex("/status"))
+        .get([&caches](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
+            r << caches.stats() << http::server::reply::flush("text");
+        });
 
     LOG(debug) << "concurrency " << config.data().concurrency;
     exchange_server<restful_dispatcher_t> server{ep,dispatcher} ;
@@ -178,3 +136,81 @@ int main(int argc, char *argv[]) {
 }
 
 
+
+int main(int argc, char *argv[]) {
+    using namespace std::placeholders;
+    using namespace std::chrono_literals;
+    BidderConfig config([](bidder_config_data &d, boost::program_options::options_description &desc){
+        desc.add_options()
+            ("bidder.log", boost::program_options::value<std::string>(&d.log_file_name), "bidder_test log file name log")
+            ("bidder.ads_source", boost::program_options::value<std::string>(&d.ads_source)->default_value("data/ads"), "ads_source file name")
+            ("bidder.ads_ipc_name", boost::program_options::value<std::string>(&d.ads_ipc_name)->default_value("vanilla-ads-ipc"), "ads ipc name")
+            ("bidder.geo_ad_source", boost::program_options::value<std::string>(&d.geo_ad_source)->default_value("data/ad_geo"), "geo_ad_source file name")
+            ("bidder.geo_ad_ipc_name", boost::program_options::value<std::string>(&d.geo_ad_ipc_name)->default_value("vanilla-geo-ad-ipc"), "geo ad-ipc name")
+            ("bidder.geo_source", boost::program_options::value<std::string>(&d.geo_source)->default_value("data/geo"), "geo_source file name")
+            ("bidder.geo_ipc_name", boost::program_options::value<std::string>(&d.geo_ipc_name)->default_value("vanilla-geo-ipc"), "geo ipc name")
+            ("bidder.port", boost::program_options::value<short>(&d.port)->required(), "bidder port")
+            ("bidder.host", boost::program_options::value<std::string>(&d.host)->default_value("0.0.0.0"), "bidder host")
+            ("bidder.root", boost::program_options::value<std::string>(&d.root)->default_value("."), "bidder root")
+            ("bidder.timeout", boost::program_options::value<int>(&d.timeout), "bidder_test timeout")
+            ("bidder.concurrency", boost::program_options::value<unsigned int>(&d.concurrency)->default_value(0), "bidder concurrency, if 0 is set std::thread::hardware_concurrency()")
+            ("bidder.geo_campaign_ipc_name", boost::program_options::value<std::string>(&d.geo_campaign_ipc_name)->default_value("vanilla-geo-campaign-ipc"), "geo campaign ipc name")
+            ("bidder.geo_campaign_source", boost::program_options::value<std::string>(&d.geo_campaign_source)->default_value("data/geo_campaign"), "geo_campaign_source file name")
+            ("bidder.campaign_data_ipc_name", boost::program_options::value<std::string>(&d.campaign_data_ipc_name)->default_value("vanilla-campaign-data-ipc"), "campaign data ipc name")
+            ("bidder.campaign_data_source", boost::program_options::value<std::string>(&d.campaign_data_source)->default_value("data/campaign_data"), "campaign_data_source file name")
+            ("bidder.geo_size_ads_ipc_name", boost::program_options::value<std::string>(&d.geo_size_ads_ipc_name)->default_value("vanilla-geo-size-ads-ipc"), "geo size ads ipc name")
+            ("bidder.dictionary_ipc_name", boost::program_options::value<std::string>(&d.dictionary_ipc_name)->default_value("vanilla-dictionary-ipc"), "string dictionary ipc name, shared by id keyed caches")
+            ("bidder.memory_backend", boost::program_options::value<std::string>(&d.memory_backend)->default_value("shared"), "caches memory backend : shared, mapped or heap")
+            ("bidder.cache_base_dir", boost::program_options::value<std::string>(&d.cache_base_dir)->default_value("/tmp/CACHE"), "directory of mapped cache segments")
+            ("bidder.warm_start", boost::program_options::value<bool>(&d.warm_start)->default_value(false), "map cache images of cache_base_dir read only instead of loading sources")
+            ("bidder.huge_pages", boost::program_options::value<bool>(&d.huge_pages)->default_value(false), "ask for transparent huge pages on cache segments, falls back to 4k pages")
+            ("bidder.budget_ipc_name", boost::program_options::value<std::string>(&d.budget_ipc_name)->default_value("vanilla-slavebanker-budget-ipc"), "campaign cache of the slave banker, campaigns out of budget are not bid on, empty disables")
+            ("bidder.budget_lease", boost::program_options::value<bool>(&d.budget_lease)->default_value(false), "budgets are leased by the slave banker, campaigns it holds no lease for yet are not bid on")
+            ("bidder.zero_copy", boost::program_options::value<bool>(&d.zero_copy)->default_value(false), "string_view requests and responses pointing into the request body and the bidder")
+            ("bidder.lazy", boost::program_options::value<bool>(&d.lazy)->default_value(false), "requests decode members when the bidder first reads them")
+            ("bidder.key_value_host", boost::program_options::value<std::string>(&d.key_value_host)->default_value("0.0.0.0"), "key value storage host")
+            ("bidder.key_value_port", boost::program_options::value<int>(&d.key_value_port)->default_value(0), "key value storage port")
+        ;
+    });
+    
+    try {
+        config.parse(argc, argv);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
+    LOG(debug) << config;
+    init_framework_logging(config.data().log_file_name);
+    
+    //vanilla::Selector<> selector(config); 
+    boost::uuids::random_generator uuid_generator{};
+    try {
+        mpclmi::ipc::configure(config.data().memory_backend, config.data().cache_base_dir, config.data().warm_start, config.data().huge_pages);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
+    vanilla::BidderCaches<> caches(config);
+    try {
+        if (!config.data().warm_start) {
+            caches.load(); // Not needed if data cache loader is in work or images are mapped
+        }
+        //selector.load();
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
+    
+    if (config.data().lazy && config.data().zero_copy) {
+        run<DSL::LazyDSL<jsonv::string_view>>(config, caches);
+    } else if (config.data().lazy) {
+        run<DSL::LazyDSL<>>(config, caches);
+    } else if (config.data().zero_copy) {
+        run<DSL::GenericDSL<jsonv::string_view>>(config, caches);
+    } else {
+        run<DSL::GenericDSL<>>(config, caches);
+    }
+}
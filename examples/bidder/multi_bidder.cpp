@@ -44,15 +44,26 @@
 extern void init_framework_logging(const std::string &) ;
 using RtbBidderCaches = vanilla::BidderCaches<BidderConfig>;
 
+template<typename DSL>
 void run(short port, RtbBidderCaches &bidder_caches) {
     using namespace vanilla::messaging;
-    vanilla::Bidder<DSL::GenericDSL<>, BidderConfig> bidder(bidder_caches);
-    communicator<broadcast>().inbound(port).process<vanilla::VanillaRequest>([&bidder](auto endpoint, vanilla::VanillaRequest vanilla_request) {
+    using Request = vanilla::BasicVanillaRequest<DSL>;
+    vanilla::Bidder<DSL, BidderConfig> bidder(bidder_caches);
+    communicator<broadcast>().inbound(port).process<Request>([&bidder](auto endpoint, Request vanilla_request) {
         LOG(debug) << "Request from user " << vanilla_request.user_info.user_id;
         return bidder.bid(vanilla_request);
     }).dispatch();
 }
 
+//requests and responses of the string_view DSL point into the datagram and the bidder, nothing is copied out
+void run(short port, RtbBidderCaches &bidder_caches, bool zero_copy) {
+    if (zero_copy) {
+        run<DSL::GenericDSL<jsonv::string_view>>(port, bidder_caches);
+    } else {
+        run<DSL::GenericDSL<>>(port, bidder_caches);
+    }
+}
+
 int main(int argc, char *argv[]) {
     using namespace std::placeholders;
     using namespace vanilla::exchange;
@@ -80,6 +91,15 @@ int main(int argc, char *argv[]) {
             ("multi_bidder.geo_campaign_source", boost::program_options::value<std::string>(&d.geo_campaign_source)->default_value("data/geo_campaign"), "geo_campaign_source file name")
             ("multi_bidder.campaign_data_ipc_name", boost::program_options::value<std::string>(&d.campaign_data_ipc_name)->default_value("vanilla-campaign-data-ipc"), "campaign data ipc name")
             ("multi_bidder.campaign_data_source", boost::program_options::value<std::string>(&d.campaign_data_source)->default_value("data/campaign_data"), "campaign_data_source file name")
+            ("multi_bidder.geo_size_ads_ipc_name", boost::program_options::value<std::string>(&d.geo_size_ads_ipc_name)->default_value("vanilla-geo-size-ads-ipc"), "geo size ads ipc name")
+            ("multi_bidder.dictionary_ipc_name", boost::program_options::value<std::string>(&d.dictionary_ipc_name)->default_value("vanilla-dictionary-ipc"), "string dictionary ipc name, shared by id keyed caches")
+            ("multi_bidder.memory_backend", po::value<std::string>(&d.memory_backend)->default_value("shared"), "caches memory backend : shared, mapped or heap")
+            ("multi_bidder.cache_base_dir", po::value<std::string>(&d.cache_base_dir)->default_value("/tmp/CACHE"), "directory of mapped cache segments")
+            ("multi_bidder.warm_start", po::value<bool>(&d.warm_start)->default_value(false), "map cache images of cache_base_dir read only instead of loading sources")
+            ("multi_bidder.huge_pages", po::value<bool>(&d.huge_pages)->default_value(false), "ask for transparent huge pages on cache segments, falls back to 4k pages")
+            ("multi_bidder.budget_ipc_name", boost::program_options::value<std::string>(&d.budget_ipc_name)->default_value("vanilla-slavebanker-budget-ipc"), "campaign cache of the slave banker, campaigns out of budget are not bid on, empty disables")
+            ("multi_bidder.budget_lease", boost::program_options::value<bool>(&d.budget_lease)->default_value(false), "budgets are leased by the slave banker, campaigns it holds no lease for yet are not bid on")
+            ("multi_bidder.zero_copy", boost::program_options::value<bool>(&d.zero_copy)->default_value(false), "string_view requests and responses, wire format is the same either way")
         ;
     });
     
@@ -93,17 +113,26 @@ int main(int argc, char *argv[]) {
     LOG(debug) << config;
     init_framework_logging(config.data().log_file_name);
     
+    try {
+        mpclmi::ipc::configure(config.data().memory_backend, config.data().cache_base_dir, config.data().warm_start, config.data().huge_pages);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
     // TODO load should be made in datacache loader
     RtbBidderCaches caches(config);
     try {
-        caches.load();
+        if (!config.data().warm_start) {
+            caches.load();
+        }
     }
     catch(std::exception const& e) {
         LOG(error) << e.what();
         return 0;
     }
     if(1 == config.data().num_of_bidders) {
-        run(config.data().port, caches);
+        run(config.data().port, caches, config.data().zero_copy);
     }
 #if !defined(WIN32)
     else {
@@ -111,7 +140,7 @@ int main(int argc, char *argv[]) {
         try {
             auto handle = [&config, &caches](unsigned int port) {
                 LOG(info) << "Starting mock bidder pid=" << getpid();
-                run(config.data().port, caches);
+                run(config.data().port, caches, config.data().zero_copy);
             };
             using Handler = decltype(handle);
             Process<> parent_proc;
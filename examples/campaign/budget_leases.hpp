@@ -0,0 +1,135 @@
+/*
+ * File:   budget_leases.hpp
+ * Author: Vladimir Venediktov
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef BUDGET_LEASES_HPP
+#define BUDGET_LEASES_HPP
+
+#include "rtb/messaging/communicator.hpp"
+#include "rtb/datacache/budget_store.hpp"
+#include "campaign_cache.hpp"
+#include <boost/date_time/gregorian/gregorian.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/optional.hpp>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace vanilla {
+
+/*
+ * Lessee end of budget leasing for one bidder node. Bidders and the notification service
+ * of the node spend on the node budget store without talking to anybody, renew() tops up
+ * every campaign whose limit went below a quarter of lease_size by leasing another
+ * lease_size from the owner on owner_port, and once the day rolls over releases all leases.
+ * Overspend of a campaign is bounded by the leases outstanding on all nodes.
+ * A request the owner did not answer within timeout stays pending and is sent again as it
+ * is by the next renew() before anything else is drained, node and sequence let the owner
+ * tell a resend from a new request so a lost reply neither strands a grant nor reports
+ * spent twice. node is random per process, a restarted lessee starts a sequence of its own.
+ */
+template<typename Memory = mpclmi::ipc::Shared>
+class BudgetLeases {
+public:
+    BudgetLeases(const std::string &name, unsigned short owner_port, uint64_t lease_size, std::chrono::milliseconds timeout) :
+        budgets{name}, owner_port{owner_port}, lease_size{lease_size}, timeout{timeout},
+        day{boost::gregorian::day_clock::local_day()}, node{std::random_device{}() | uint64_t(std::random_device{}()) << 32},
+        sequence{}
+    {
+        sender.outbound(owner_port);
+    }
+
+    //one pass over the node budgets, returns number of campaigns exchanged with the owner
+    std::size_t renew() {
+        if (pending && !send()) {
+            return 0; // owner is still away, nothing new is drained until it answers
+        }
+        const auto today = boost::gregorian::day_clock::local_day();
+        const bool rollover = today != day;
+        std::vector<uint32_t> campaigns;
+        budgets.visit([&](const datacache::budget_snapshot &budget) {
+            if (rollover || budget.limit < lease_size / 4) {
+                campaigns.push_back(budget.campaign_id);
+            }
+        });
+        std::size_t exchanged{};
+        for (auto campaign_id : campaigns) {
+            exchanged += exchange(campaign_id, rollover);
+            if (pending) {
+                break; // unanswered request is kept for the next pass, the rest stays undrained
+            }
+        }
+        if (exchanged == campaigns.size()) {
+            day = today; // leases of the previous day not released yet are retried next pass
+        }
+        return exchanged;
+    }
+
+    void run(std::chrono::milliseconds interval) {
+        for (;;) {
+            renew();
+            std::this_thread::sleep_for(interval);
+        }
+    }
+
+private:
+    bool exchange(uint32_t campaign_id, bool release) {
+        datacache::budget_snapshot drained;
+        if (!budgets.drain(campaign_id, drained, release)) {
+            return false;
+        }
+        BudgetLease request;
+        request.action = release ? BudgetLease::Action::RELEASE : BudgetLease::Action::ACQUIRE;
+        request.campaign_id = campaign_id;
+        request.amount = release ? drained.limit : lease_size;
+        request.spent = drained.spent + drained.overdraft;
+        request.node = node;
+        request.sequence = ++sequence;
+        pending = request;
+        return send();
+    }
+
+    //sends the pending request, it is kept for the next renew() until the owner answers it
+    bool send() {
+        boost::optional<BudgetLease> reply;
+        const BudgetLease &request = *pending;
+        sender.distribute(request)
+        .collect<BudgetLease>(timeout, [&reply,&request](BudgetLease lease, auto done) {
+            if (lease.node == request.node && lease.sequence == request.sequence) {
+                reply = lease;
+                done();
+            }
+        });
+        if (!reply) {
+            LOG(error) << "budget owner did not answer lease " << request;
+            return false;
+        }
+        if (request.action == BudgetLease::Action::ACQUIRE) {
+            budgets.credit(request.campaign_id, reply->amount);
+        }
+        LOG(debug) << "budget lease " << request << " granted " << reply->amount;
+        pending.reset();
+        return true;
+    }
+
+    datacache::budget_store<Memory> budgets;
+    unsigned short owner_port;
+    uint64_t lease_size;
+    std::chrono::milliseconds timeout;
+    boost::gregorian::date day;
+    const uint64_t node;
+    uint64_t sequence;
+    boost::optional<BudgetLease> pending;
+    messaging::communicator<messaging::broadcast> sender;
+};
+
+} //vanilla
+
+#endif /* BUDGET_LEASES_HPP */
@@ -13,12 +13,16 @@
 #include "common/perf_timer.hpp"
 #include "datacache/campaign_entity.hpp"
 #include "datacache/entity_cache.hpp"
+#include "datacache/sharded_entity_cache.hpp"
+#include "datacache/budget_store.hpp"
 #include "datacache/memory_types.hpp"
 #include <boost/serialization/strong_typedef.hpp>
 #include <boost/algorithm/string/split.hpp>
 #include <boost/algorithm/string/classification.hpp>
 #include <boost/algorithm/string/case_conv.hpp>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <cstdint>
 #include <iostream>
 #include "rtb/common/split_string.hpp"
@@ -58,6 +62,7 @@ struct CampaignBudget {
     uint64_t day_budget_limit{}; //micro dollars
     uint64_t day_budget_spent{}; //micro dollars
     uint64_t day_budget_overdraft{}; //micro dollars
+    uint64_t version{}; //orders broadcast amounts of a campaign, 0 when not broadcast
     //uint64_t day_show_limit{}; //TODO: remove
     //uint64_t day_click_limit{}; //TODO: remove
     Metric metric{};
@@ -105,19 +110,58 @@ struct CampaignBudget {
    
 };
 
+/*
+ * Lease message between a bidder node and the budget owner, same struct both ways.
+ * ACQUIRE asks for amount and reports spent since the previous report, the reply carries
+ * what was granted in amount. RELEASE gives amount back unused and reports spent.
+ * sequence numbers the requests of a node, a request resent with the same node and
+ * sequence is answered with the reply it already got and settled only once.
+ */
+struct BudgetLease {
+    enum class Action : int8_t {
+        UNDEFINED = 0,
+        ACQUIRE = 1,
+        RELEASE = 2
+    };
+    Action action{};
+    uint32_t campaign_id{};
+    uint64_t amount{}; //micro dollars
+    uint64_t spent{};  //micro dollars
+    uint64_t node{};
+    uint64_t sequence{};
+
+    friend std::ostream &operator<<(std::ostream & os, const BudgetLease & value)  {
+        os << static_cast<int>(value.action) << "|"
+           << value.campaign_id << "|"
+           << value.amount << "|"
+           << value.spent << "|"
+           << value.node << "|"
+           << value.sequence << "|"
+        ;
+        return os;
+    }
+};
+
 template <typename Config = CampaignManagerConfig,
           typename Memory = typename mpclmi::ipc::Shared,
           typename Alloc = typename datacache::entity_cache<Memory, ipc::data::campaign_container>::char_allocator >
 class CampaignCache {
-        using Cache = datacache::entity_cache<Memory, ipc::data::campaign_container> ; 
+        using CampaignTag = typename ipc::data::campaign_entity<Alloc>::campaign_id_tag;
+        //records are written by several services, shards keep writers of different campaigns apart
+        using Cache = datacache::sharded_entity_cache<Memory, ipc::data::campaign_container, CampaignTag> ;
         using Keys = vanilla::tagged_tuple< 
             typename ipc::data::campaign_entity<Alloc>::campaign_id_tag,   uint32_t
         >;
-        using CampaignTag = typename ipc::data::campaign_entity<Alloc>::campaign_id_tag;
+        using Budgets = datacache::budget_store<Memory> ;
     public:
         using DataCollection = std::vector<std::shared_ptr <CampaignBudget> >;
+        /*
+         * Campaign records live in the entity cache, their limit / spent / overdraft amounts
+         * in the lock free budget store next to it ( ipc_name_budgets ). Wins are spent on
+         * the store only, retrieved budgets carry the amounts of the store.
+         */
         CampaignCache(const Config &config):
-            config{config}, cache(config.data().ipc_name)
+            config{config}, cache(config.data().ipc_name), budgets(config.data().ipc_name + "_budgets")
         {}
         
         bool retrieve(DataCollection &data, uint32_t campaign_id) {
@@ -126,6 +170,7 @@ class CampaignCache {
             {
                 perf_timer<std::stringstream> timer(sp, "campaign_id");
                 result = cache.template retrieve<CampaignTag>(data, campaign_id);
+                amounts(data);
             }
             LOG(debug) << sp->str();
             return result;
@@ -136,23 +181,90 @@ class CampaignCache {
             {
                 perf_timer<std::stringstream> timer(sp, "all_compaign_ids");
                 result = cache.template retrieve(data);
+                amounts(data);
             }
             LOG(debug) << sp->str();
             return result;
         }
         bool insert(const CampaignBudget &budget, uint32_t campaign_id) {
-            return cache.insert(Keys{ campaign_id }, budget);
+            if ( !cache.insert(Keys{ campaign_id }, budget) ) {
+                return false;
+            }
+            assign(budget, campaign_id);
+            return true;
         }
         bool update(const CampaignBudget &budget, uint32_t campaign_id) {
-            return cache.template update<CampaignTag>(Keys{ campaign_id }, budget, campaign_id);
+            if ( !cache.template update<CampaignTag>(Keys{ campaign_id }, budget, campaign_id) ) {
+                return false;
+            }
+            assign(budget, campaign_id);
+            return true;
         }
         bool update(const CampaignBudget &budget, uint32_t old_campaign_id, uint32_t new_campaign_id) {
-            return cache.template update<CampaignTag>(Keys{ new_campaign_id }, budget, old_campaign_id);
+            if ( !cache.template update<CampaignTag>(Keys{ new_campaign_id }, budget, old_campaign_id) ) {
+                return false;
+            }
+            budgets.remove(old_campaign_id);
+            assign(budget, new_campaign_id);
+            return true;
         }
         bool remove(uint32_t campaign_id) {
             cache.template remove<CampaignTag>(campaign_id);
+            budgets.remove(campaign_id);
+            return true;
+        }
+        /*
+         * Win notice, price is taken from the store without locking or touching the entity
+         * cache, budget is set to the amounts the spend left. False for an unknown campaign.
+         */
+        bool spend(uint32_t campaign_id, types::price price, CampaignBudget &budget) {
+            datacache::budget_snapshot after;
+            if ( !budgets.spend(campaign_id, price, after) ) {
+                return false;
+            }
+            budget.campaign_id = campaign_id;
+            budget.day_budget_limit = after.limit;
+            budget.day_budget_spent = after.spent;
+            budget.day_budget_overdraft = after.overdraft;
             return true;
         }
+        /*
+         * Amounts broadcast by the notification service, overdraft is not on the wire and is kept.
+         * Datagrams carry absolute amounts and may arrive late or twice, one not newer than the
+         * last applied for its campaign would roll spent back and is dropped, false is returned.
+         */
+        bool apply(const CampaignBudget &budget) {
+            datacache::budget_snapshot current;
+            budgets.read(budget.campaign_id, current);
+            return budgets.assign(budget.campaign_id, budget.version, budget.day_budget_limit, budget.day_budget_spent, current.overdraft);
+        }
+        bool exhausted(uint32_t campaign_id) const {
+            return budgets.exhausted(campaign_id);
+        }
+        //budget owner side of BudgetLeases, spent is settled first so it counts before the next grant
+        BudgetLease lease(const BudgetLease &request) {
+            std::lock_guard<std::mutex> guard(leases_mutex);
+            auto &last = leases[request.node];
+            if (request.sequence <= last.sequence) {
+                return last; // a resend of a request whose reply got lost, or older still
+            }
+            BudgetLease &reply = last;
+            reply = request;
+            reply.spent = 0;
+            switch (request.action) {
+                case BudgetLease::Action::ACQUIRE :
+                    budgets.settle(request.campaign_id, request.spent, 0);
+                    reply.amount = budgets.lease(request.campaign_id, request.amount);
+                    break;
+                case BudgetLease::Action::RELEASE :
+                    budgets.settle(request.campaign_id, request.spent, request.amount);
+                    reply.amount = 0;
+                    break;
+                default :
+                    reply.amount = 0;
+            }
+            return reply;
+        }
         void load() noexcept(false) {
             auto sp = std::make_shared<std::stringstream>();
             {
@@ -162,17 +274,39 @@ class CampaignCache {
                     throw std::runtime_error(std::string("could not open file ") + config.data().campaign_budget_source + " exiting...");
                 }
                 LOG(debug) << "File opened " << config.data().campaign_budget_source;
-                cache.clear();
-
+                std::vector<std::pair<Keys, CampaignBudget>> records;
                 std::for_each(std::istream_iterator<CampaignBudget>(in), std::istream_iterator<CampaignBudget>(), [&](const CampaignBudget & c) {
-                    cache.insert(Keys{c.campaign_id}, c);
+                    records.emplace_back(Keys{c.campaign_id}, c);
                 });
+                cache.reload(records.begin(), records.end());
+                for (const auto &record : records) {
+                    assign(record.second, record.second.campaign_id);
+                }
             }
             LOG(debug) << sp->str();
         }
+        datacache::cache_stats stats() const {
+            return cache.stats();
+        }
     private:
+        void assign(const CampaignBudget &budget, uint32_t campaign_id) {
+            budgets.assign(campaign_id, budget.day_budget_limit, budget.day_budget_spent, budget.day_budget_overdraft);
+        }
+        void amounts(DataCollection &data) const {
+            datacache::budget_snapshot snapshot;
+            for (auto &budget : data) {
+                if ( budgets.read(budget->campaign_id, snapshot) ) {
+                    budget->day_budget_limit = snapshot.limit;
+                    budget->day_budget_spent = snapshot.spent;
+                    budget->day_budget_overdraft = snapshot.overdraft;
+                }
+            }
+        }
         const Config &config;
         Cache cache;
+        Budgets budgets;
+        std::mutex leases_mutex;
+        std::unordered_map<uint64_t, BudgetLease> leases; // last reply to each node
 };
 
 
@@ -76,6 +76,8 @@
 #include "campaign_cache.hpp"
 #include "serialization.hpp"
 #include "campaign_budget_mapper.hpp"
+#include "rtb/messaging/communicator.hpp"
+#include <thread>
 
 
 #include "rtb/core/core.hpp"
@@ -103,6 +105,7 @@ int main(int argc, char *argv[]) {
             ("campaign-manager.root", "campaign_manager_test Root")
             ("campaign-manager.ipc_name", boost::program_options::value<std::string>(&d.ipc_name),"campaign_manager_test IPC name")
             ("campaign-manager.budget_source", boost::program_options::value<std::string>(&d.campaign_budget_source)->default_value("data/campaign_budget"),"campaign_budget source file name")
+            ("campaign-manager.lease_port", boost::program_options::value<int>(&d.lease_port)->default_value(0),"udp port bidder nodes lease campaign budgets on, 0 disables")
         ;
     });
     
@@ -208,6 +211,17 @@ int main(int argc, char *argv[]) {
               http::server::request_handler(config.get("campaign-manager.root")).handle_request(req,r);
     });
 
+    //budget owner end of BudgetLeases, slave bankers lease chunks of campaign budgets for their nodes
+    if (config.data().lease_port) {
+        std::thread([&cache, &config]() {
+            using namespace vanilla::messaging;
+            communicator<broadcast>().inbound(config.data().lease_port).process<BudgetLease>([&cache](auto endpoint, BudgetLease request) {
+                LOG(debug) << "budget lease request " << request;
+                return cache.lease(request);
+            }).dispatch();
+        }).detach();
+    }
+
     auto host = config.get("campaign-manager.host");
     auto port = config.get("campaign-manager.port");
     http::server::server<restful_dispatcher_t> server(host,port,dispatcher);
@@ -17,6 +17,7 @@ struct campaign_manager_config_data {
     std::string delete_restful_prefix;
     std::string ipc_name;
     std::string campaign_budget_source;
+    int lease_port{};
 };
 using CampaignManagerConfig = vanilla::config::config<campaign_manager_config_data>;
 
@@ -25,6 +26,7 @@ struct notification_service_config_data {
     int budget_port{};
     std::string nurl_match;
     std::string ipc_name;
+    int batch_window{};
 };
 
 using WinNotificationConfig = vanilla::config::config<notification_service_config_data>;
@@ -33,6 +35,10 @@ struct slavebanker_service_config_data {
     std::string log_file_name;
     int budget_port{};
     std::string ipc_name;
+    int lease_port{};
+    uint64_t lease_size{};
+    int lease_interval{};
+    int lease_timeout{};
 };
 
 using SlaveBankerConfig = vanilla::config::config<slavebanker_service_config_data>;
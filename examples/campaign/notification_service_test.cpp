@@ -20,6 +20,7 @@
 #include "rtb/messaging/communicator.hpp"
 #include "core/tagged_tuple.hpp"
 #include "campaign_cache.hpp"
+#include "win_notice_batcher.hpp"
 #include "serialization.hpp"
 
 
@@ -34,6 +35,9 @@ struct notification_service_status {
     boost::atomic_uint64_t win_notice_count{};
     boost::atomic_uint64_t day_budget_limit{};
     boost::atomic_uint64_t total_spent_amout{};
+    boost::atomic_uint64_t budget_flush_count{};
+    boost::atomic_uint64_t budget_spend_count{};
+    boost::atomic_uint64_t budget_datagram_count{};
 
     friend std::ostream& operator<<(std::ostream &os, const notification_service_status &st) {
         boost::posix_time::time_duration td = boost::posix_time::microsec_clock::local_time() - st.start;
@@ -43,6 +47,9 @@ struct notification_service_status {
               "<tr><td>win notice count</td><td>" << st.win_notice_count << "</td></tr>" <<
               "<tr><td>daily budget limit</td><td>" << st.day_budget_limit << "</td></tr>" <<
               "<tr><td>total spent amount</td><td>" << st.total_spent_amout << "</td></tr>" << 
+              "<tr><td>budget flushes</td><td>" << st.budget_flush_count << "</td></tr>" <<
+              "<tr><td>budget spends</td><td>" << st.budget_spend_count << "</td></tr>" <<
+              "<tr><td>budget datagrams</td><td>" << st.budget_datagram_count << "</td></tr>" <<
               "</table> ";
         return os;
     }
@@ -62,7 +69,6 @@ int main(int argc, char* argv[]) {
     using namespace vanilla;
     using restful_dispatcher_t =  http::crud::crud_dispatcher<http::server::request, http::server::reply> ;
     using CampaignCacheType  = CampaignCache<WinNotificationConfig>;
-    using CampaignBudgets = typename CampaignCacheType::DataCollection;
     namespace po = boost::program_options;   
     vanilla::config::config<notification_service_config_data> config([&](notification_service_config_data &d, po::options_description &desc){
         desc.add_options()
@@ -73,6 +79,7 @@ int main(int argc, char* argv[]) {
             ("notification-service.nurl_match", po::value<std::string>(&d.nurl_match)->required(), "matching CRUD path to exchange nurl")
             ("multi_bidder.budget_port", po::value<int>(&d.budget_port)->required(), "udp port for broadcast to bidders budget change")
             ("campaign-manager.ipc_name", po::value<std::string>(&d.ipc_name)->required(), "name of campaign manager ipc cache")
+            ("notification-service.batch_window", po::value<int>(&d.batch_window)->default_value(5), "milliseconds win notices of a campaign are summed up before one budget update and broadcast")
         ;
     });
     try {
@@ -89,6 +96,13 @@ int main(int argc, char* argv[]) {
      
     // status 
     notification_service_status status;
+
+    //wins are summed per campaign and spent once per batch_window, budgets go out coalesced
+    WinNoticeBatcher<CampaignCacheType> batcher(cache, config.data().budget_port, std::chrono::milliseconds(config.data().batch_window),
+        [&status](const CampaignBudget &budget) {
+            status.day_budget_limit  = budget.day_budget_limit;
+            status.total_spent_amout = budget.day_budget_spent;
+        });
     
     connection_endpoint ep {std::make_tuple(config.get("notification-service.host"), 
                                             config.get("notification-service.port"), 
@@ -97,8 +111,7 @@ int main(int argc, char* argv[]) {
     restful_dispatcher_t dispatcher(ep.root) ;
     //win notice handler
     dispatcher.crud_match(boost::regex(config.data().nurl_match))
-        .get([&status,&cache,&config](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
-            using namespace vanilla::messaging;
+        .get([&status,&batcher](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
             boost::optional<uint32_t> campaign_id;
             boost::optional<uint64_t> price;
             std::string price_str = match[1];
@@ -114,26 +127,16 @@ int main(int argc, char* argv[]) {
                 r.stock_reply(http::server::reply::ok);
                 return;
             }
-            CampaignBudgets budgets;
-            if ( !cache.retrieve(budgets, *campaign_id) ) {
-                LOG(error) << "failed to get campaign_id=" << *campaign_id << " from cache !";
-                r.stock_reply(http::server::reply::ok);
-                return;
-            }
             LOG(info) << "received win notification campaign_id=" << *campaign_id << " win price=" << *price;
-            std::shared_ptr<CampaignBudget> budget_ptr = budgets.at(0);
-            budget_ptr->update(vanilla::types::price(*price));
-            status.day_budget_limit  = budget_ptr->day_budget_limit;
-            status.total_spent_amout = budget_ptr->day_budget_spent;
+            batcher.add(*campaign_id, *price);
             ++status.win_notice_count;
-            cache.update(*budget_ptr,*campaign_id);
-            communicator<broadcast>()
-            .outbound(config.data().budget_port)
-            .distribute(*budget_ptr);
             r.stock_reply(http::server::reply::ok);
         });
     dispatcher.crud_match(boost::regex("/status.html"))
-        .get([&status](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
+        .get([&status,&batcher](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
+            status.budget_flush_count = batcher.statistics().flushes.load();
+            status.budget_spend_count = batcher.statistics().spends.load();
+            status.budget_datagram_count = batcher.statistics().datagrams.load();
             r << boost::lexical_cast<std::string>(status) ;
             r.stock_reply(http::server::reply::ok);
         });
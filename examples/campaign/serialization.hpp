@@ -8,6 +8,7 @@
 #ifndef CAMPAIGN_SERIALIZATION_HPP
 #define CAMPAIGN_SERIALIZATION_HPP
 
+#include <boost/serialization/vector.hpp> // budgets are broadcast in batches
 
 //Non-Intrusive boost serialization implementation
 namespace boost { namespace serialization {
@@ -17,12 +18,22 @@ namespace boost { namespace serialization {
         ar & value.day_budget_limit;
         ar & value.day_budget_spent;
         ar & value.metric;
+        ar & value.version;
     }
     template<class Archive>
     void serialize(Archive & ar, vanilla::CampaignBudget::Metric & metric, const unsigned int) {
         ar & metric.type;
         ar & metric.value;
     }
+    template<class Archive>
+    void serialize(Archive & ar, vanilla::BudgetLease & value, const unsigned int) {
+        ar & value.action;
+        ar & value.campaign_id;
+        ar & value.amount;
+        ar & value.spent;
+        ar & value.node;
+        ar & value.sequence;
+    }
 }} 
 
 #endif /* CAMPAIGN_SERIALIZATION_HPP */
@@ -12,6 +12,7 @@
 #include "rtb/config/config.hpp"
 #include "rtb/messaging/communicator.hpp"
 #include "campaign_cache.hpp"
+#include "budget_leases.hpp"
 #include "serialization.hpp"
 
 #include "rtb/core/core.hpp"
@@ -23,9 +24,15 @@ using namespace vanilla;
 template<typename Cache>
 void run(short port, Cache &cache) {
     using namespace vanilla::messaging;
-    communicator<broadcast>().inbound(port).consume<CampaignBudget>([&cache](auto endpoint, auto budget) {
-        cache.update(budget,budget.campaign_id);
-        LOG(debug) << "updated budget :" << budget;
+    //notification service coalesces budgets of a batch window into one datagram
+    communicator<broadcast>().inbound(port).consume<std::vector<CampaignBudget>>([&cache](auto endpoint, auto budgets) {
+        for (const auto &budget : budgets) {
+            if (!cache.apply(budget)) {
+                LOG(debug) << "dropped stale budget :" << budget << " version " << budget.version;
+                continue;
+            }
+            LOG(debug) << "updated budget :" << budget;
+        }
         return ;
     }).dispatch();
 }
@@ -39,6 +46,10 @@ int main(int argc, char** argv) {
             ("slave-banker-service.log", po::value<std::string>(&d.log_file_name), "slavebanker_service_test log file name")
             ("multi_bidder.budget_port", po::value<int>(&d.budget_port)->required(), "udp port for broadcast to bidders budget change")
             ("slave-banker-service.ipc_name", po::value<std::string>(&d.ipc_name)->required(), "name of campaign manager ipc cache")
+            ("slave-banker-service.lease_port", po::value<int>(&d.lease_port)->default_value(0), "udp port of the budget owner to lease budgets from, 0 mirrors broadcast budgets instead")
+            ("slave-banker-service.lease_size", po::value<uint64_t>(&d.lease_size)->default_value(10000000), "micro dollars leased per campaign at a time")
+            ("slave-banker-service.lease_interval", po::value<int>(&d.lease_interval)->default_value(100), "milliseconds between lease renewals")
+            ("slave-banker-service.lease_timeout", po::value<int>(&d.lease_timeout)->default_value(10), "milliseconds to wait for the budget owner")
         ;
     });
     try {
@@ -51,6 +62,13 @@ int main(int argc, char** argv) {
     LOG(debug) << config;
     init_framework_logging(config.data().log_file_name);
     
+    //node spends its leases locally, bidders and notification service of the node use the same store
+    if (config.data().lease_port) {
+        BudgetLeases<> leases(config.data().ipc_name + "_budgets", config.data().lease_port, config.data().lease_size,
+                              std::chrono::milliseconds(config.data().lease_timeout));
+        leases.run(std::chrono::milliseconds(config.data().lease_interval));
+        return 0;
+    }
     CampaignCacheType  cache(config);
     run(config.data().budget_port, cache);
     
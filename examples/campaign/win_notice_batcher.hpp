@@ -0,0 +1,140 @@
+/*
+ * File:   win_notice_batcher.hpp
+ * Author: Vladimir Venediktov
+ *
+ * Created on October 17, 2026
+ */
+
+#ifndef WIN_NOTICE_BATCHER_HPP
+#define WIN_NOTICE_BATCHER_HPP
+
+#include "rtb/messaging/communicator.hpp"
+#include "campaign_cache.hpp"
+#include <boost/log/trivial.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vanilla {
+
+/*
+ * Ingestion stage of win notices. add() only adds price to the pending spend of its
+ * campaign, every window the flusher thread spends each campaign once for everything
+ * it won during the window and broadcasts the resulting budgets to the slave bankers,
+ * up to BUDGETS_PER_DATAGRAM of them per std::vector<CampaignBudget> datagram, over one
+ * long lived sender. Budgets carry the absolute amounts after the spend and the version of
+ * their flush, receivers drop a datagram not newer than the last one they applied so a late
+ * or duplicate one doesn't roll spent back ( see CampaignCache::apply ). Versions are clock
+ * microseconds kept strictly increasing, they keep increasing across restarts of the service.
+ * Pending spend is flushed once more on destruction.
+ */
+template<typename Cache>
+class WinNoticeBatcher {
+public:
+    using BudgetHandler = std::function<void(const CampaignBudget &)>;
+    static constexpr std::size_t BUDGETS_PER_DATAGRAM = 64; // well below the 4k receive buffer
+
+    struct Stats {
+        std::atomic<uint64_t> notices{};
+        std::atomic<uint64_t> flushes{};
+        std::atomic<uint64_t> spends{};
+        std::atomic<uint64_t> datagrams{};
+    };
+
+    WinNoticeBatcher(Cache &cache, unsigned short budget_port, std::chrono::milliseconds window, BudgetHandler on_budget = BudgetHandler()) :
+        cache{cache}, window{window}, on_budget{on_budget}, stopped{false}
+    {
+        sender.outbound(budget_port);
+        flusher = std::thread([this]() {
+            std::unique_lock<std::mutex> guard(stop_mutex);
+            while (!stop_condition.wait_for(guard, this->window, [this]() { return stopped; })) {
+                flush();
+            }
+        });
+    }
+
+    ~WinNoticeBatcher() {
+        {
+            std::lock_guard<std::mutex> guard(stop_mutex);
+            stopped = true;
+        }
+        stop_condition.notify_one();
+        flusher.join();
+        flush();
+    }
+
+    WinNoticeBatcher(const WinNoticeBatcher &) = delete;
+    WinNoticeBatcher & operator=(const WinNoticeBatcher &) = delete;
+
+    void add(uint32_t campaign_id, uint64_t price) {
+        {
+            std::lock_guard<std::mutex> guard(pending_mutex);
+            pending[campaign_id] += price;
+        }
+        ++stats.notices;
+    }
+
+    //one spend per campaign for everything added since the previous flush, returns number of campaigns
+    std::size_t flush() {
+        decltype(pending) batch;
+        {
+            std::lock_guard<std::mutex> guard(pending_mutex);
+            batch.swap(pending);
+        }
+        if (batch.empty()) {
+            return 0;
+        }
+        ++stats.flushes;
+        const auto now = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch());
+        version = std::max<uint64_t>(version + 1, now.count());
+        budgets.clear();
+        for (const auto &spend : batch) {
+            CampaignBudget budget;
+            if (!cache.spend(spend.first, types::price(spend.second), budget)) {
+                LOG(error) << "failed to get campaign_id=" << spend.first << " from cache !";
+                continue;
+            }
+            budget.version = version;
+            if (on_budget) {
+                on_budget(budget);
+            }
+            budgets.push_back(budget);
+        }
+        stats.spends += budgets.size();
+        for (std::size_t first = 0; first < budgets.size(); first += BUDGETS_PER_DATAGRAM) {
+            const auto last = std::min(budgets.size(), first + BUDGETS_PER_DATAGRAM);
+            sender.distribute(std::vector<CampaignBudget>(budgets.begin() + first, budgets.begin() + last)).flush();
+            ++stats.datagrams;
+        }
+        return batch.size();
+    }
+
+    const Stats & statistics() const {
+        return stats;
+    }
+
+private:
+    Cache &cache;
+    const std::chrono::milliseconds window;
+    BudgetHandler on_budget;
+    messaging::communicator<messaging::broadcast> sender;
+    std::mutex pending_mutex;
+    std::unordered_map<uint32_t, uint64_t> pending;
+    std::vector<CampaignBudget> budgets; // flusher only
+    uint64_t version{}; // flusher only
+    Stats stats;
+    std::mutex stop_mutex;
+    std::condition_variable stop_condition;
+    bool stopped;
+    std::thread flusher;
+};
+
+} //vanilla
+
+#endif /* WIN_NOTICE_BATCHER_HPP */
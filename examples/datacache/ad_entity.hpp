@@ -73,6 +73,16 @@ namespace ipc { namespace data {
             data.max_bid_micros = max_bid_micros;
             data.code = std::string(code.data(), code.size());
         }
+        //all but code
+        template<typename Serializable>
+        void retrieve_hot(Serializable  & data) const {
+            data.campaign_id=campaign_id;
+            data.width=width;
+            data.height=height;
+            data.ad_id = ad_id;
+            data.position = position;
+            data.max_bid_micros = max_bid_micros;
+        }
         //needed for ability to update after matching by calling index.modify(itr,entry)
         void operator()(ad_entity &entry) const {
             entry.campaign_id=campaign_id;
@@ -26,6 +26,7 @@
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -69,14 +70,8 @@ namespace ipc { namespace data {
             geo_id    = data.geo_id;
         }
         template<typename Serializable>
-        static std::size_t size(const Serializable && data) {
-            std::stringstream ss;
-            boost::archive::binary_oarchive oarch(ss);
-            oarch << std::forward<Serializable>(data) ;
-            return base_type::size(std::forward<Serializable>(data)) +
-                   sizeof(data.city)                       +
-                   sizeof(data.country)                        +
-                   ss.str().size() ;
+        static std::size_t size(const Serializable & data) {
+            return data.city.size() + data.country.size() ;
         }
         template<typename Serializable>
         void retrieve(Serializable  & data) const {
@@ -84,6 +79,10 @@ namespace ipc { namespace data {
             data.country=std::string(country.data(), country.size());
             data.geo_id=geo_id;
         }
+        template<typename Serializable>
+        void retrieve_hot(Serializable  & data) const {
+            data.geo_id=geo_id;
+        }
         //needed for ability to update after matching by calling index.modify(itr,entry)
         void operator()(city_country_entity &entry) const {
             entry.city=city;
@@ -123,6 +122,42 @@ boost::multi_index_container<
     boost::interprocess::allocator<city_country_entity<Alloc>,typename Alloc::segment_manager>
 > ;
 
+//hashed variant of the above, same tags but no partial ( city only ) search on unique_city_country_tag
+template<typename Alloc>
+using city_country_hashed_container =
+boost::multi_index_container<
+    city_country_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename city_country_entity<Alloc>::city_tag>,
+                BOOST_MULTI_INDEX_MEMBER(city_country_entity<Alloc>,typename city_country_entity<Alloc>::char_string,city),
+            ufw::any_str_hash<Alloc>,
+            ufw::any_str_equal<Alloc>
+        >,
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename city_country_entity<Alloc>::country_tag>,
+                BOOST_MULTI_INDEX_MEMBER(city_country_entity<Alloc>,typename city_country_entity<Alloc>::char_string,country),
+            ufw::any_str_hash<Alloc>,
+            ufw::any_str_equal<Alloc>
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::tag<typename city_country_entity<Alloc>::unique_city_country_tag>,
+            boost::multi_index::composite_key<
+                city_country_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(city_country_entity<Alloc>,typename city_country_entity<Alloc>::char_string,city),
+                BOOST_MULTI_INDEX_MEMBER(city_country_entity<Alloc>,typename city_country_entity<Alloc>::char_string,country)
+            >,
+            boost::multi_index::composite_key_hash<
+                ufw::any_str_hash<Alloc>, ufw::any_str_hash<Alloc>
+            >,
+            boost::multi_index::composite_key_equal_to<
+                ufw::any_str_equal<Alloc>, ufw::any_str_equal<Alloc>
+            >
+        >
+    >,
+    boost::interprocess::allocator<city_country_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
 }}
  
 #endif     /* __IPC_DATA_ACCOUNT_ENTITY_HPP__  */
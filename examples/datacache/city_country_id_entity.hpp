@@ -0,0 +1,129 @@
+/*
+ * File:   city_country_id_entity.hpp
+ * Author: Vladimir Venediktov vvenedict@gmail.com
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef __IPC_DATA_CITY_COUNTRY_ID_ENTITY_HPP__
+#define __IPC_DATA_CITY_COUNTRY_ID_ENTITY_HPP__
+
+#include <cstdint>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace ipc { namespace data {
+
+    /*
+     * city_country_entity keyed by datacache::string_dictionary ids of the case folded
+     * city and country, index nodes hold three integers and compare them instead of strings.
+     */
+    template <typename Alloc>
+    struct city_country_id_entity
+    {
+        //for tagging in multi_index_container
+        struct city_tag {}; // search on city id
+        struct country_tag {}; // search on country id
+        struct geo_id_tag {}; // search on geo_id
+        struct unique_city_country_tag {}; //search on city+country ids or city id when using partial search
+
+        city_country_id_entity( const Alloc & ) :
+            city{},
+            country{},
+            geo_id{}
+        {} //ctor END
+
+        uint32_t city;
+        uint32_t country;
+        uint32_t geo_id;
+
+        template<typename Key, typename Serializable>
+        void store(Key && key, Serializable  && data)  {
+            city    = key.template get<city_tag>() ;
+            country = key.template get<country_tag>() ;
+            geo_id  = data.geo_id;
+        }
+        //strings are resolved through the dictionary, only geo_id is kept here
+        template<typename Serializable>
+        void retrieve(Serializable  & data) const {
+            data.geo_id=geo_id;
+        }
+        template<typename Serializable>
+        void retrieve_hot(Serializable  & data) const {
+            data.geo_id=geo_id;
+        }
+        //needed for ability to update after matching by calling index.modify(itr,entry)
+        void operator()(city_country_id_entity &entry) const {
+            entry.city=city;
+            entry.country=country;
+            entry.geo_id=geo_id;
+        }
+    };
+
+template<typename Alloc>
+using city_country_id_container =
+boost::multi_index_container<
+    city_country_id_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::unique_city_country_tag>,
+            boost::multi_index::composite_key<
+                city_country_id_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,city),
+                BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,country)
+            >
+        >,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::country_tag>,
+            BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,country)
+        >,
+        boost::multi_index::ordered_non_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::geo_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,geo_id)
+        >
+    >,
+    boost::interprocess::allocator<city_country_id_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+//hashed variant of the above, no partial ( city only ) search on unique_city_country_tag
+template<typename Alloc>
+using city_country_id_hashed_container =
+boost::multi_index_container<
+    city_country_id_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::unique_city_country_tag>,
+            boost::multi_index::composite_key<
+                city_country_id_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,city),
+                BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,country)
+            >
+        >,
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::country_tag>,
+            BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,country)
+        >,
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename city_country_id_entity<Alloc>::geo_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(city_country_id_entity<Alloc>,uint32_t,geo_id)
+        >
+    >,
+    boost::interprocess::allocator<city_country_id_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+}}
+
+#endif /* __IPC_DATA_CITY_COUNTRY_ID_ENTITY_HPP__ */
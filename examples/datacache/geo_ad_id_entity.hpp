@@ -0,0 +1,98 @@
+/*
+ * File:   geo_ad_id_entity.hpp
+ * Author: Vladimir Venediktov vvenedict@gmail.com
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef __IPC_DATA_GEO_AD_ID_ENTITY_HPP__
+#define __IPC_DATA_GEO_AD_ID_ENTITY_HPP__
+
+#include <cstdint>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+namespace ipc { namespace data {
+    
+    //geo_entity with ad_id replaced by its datacache::string_dictionary id
+    template <typename Alloc>
+    struct geo_ad_id_entity
+    {
+        //for tagging in multi_index_container
+        struct geo_id_tag {}; // search on geo_id
+        struct ad_id_tag {};
+        
+        geo_ad_id_entity( const Alloc & ) :
+            geo_id{},
+            ad_id{}
+        {}
+            
+        uint32_t geo_id;
+        uint32_t ad_id;
+        
+        template<typename Key, typename Serializable>
+        void store(Key && key, Serializable  &&)  {
+            geo_id = key.template get<geo_id_tag>();  
+            ad_id = key.template get<ad_id_tag>();  
+        }
+        //needed for ability to update after matching by calling index.modify(itr,entry)
+        void operator()(geo_ad_id_entity &entry) const {
+            entry.geo_id=geo_id;
+            entry.ad_id=ad_id;
+        }
+    };
+ 
+template<typename Alloc>
+using geo_ad_id_container =
+boost::multi_index_container<
+    geo_ad_id_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            boost::multi_index::tag<typename geo_ad_id_entity<Alloc>::geo_id_tag>,
+            boost::multi_index::composite_key<
+              geo_ad_id_entity<Alloc>,
+              BOOST_MULTI_INDEX_MEMBER(geo_ad_id_entity<Alloc>,uint32_t,geo_id),
+              BOOST_MULTI_INDEX_MEMBER(geo_ad_id_entity<Alloc>,uint32_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<geo_ad_id_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+//hashed variant, O(1) lookup on geo_id, the second index only keeps geo-ad pairs unique
+template<typename Alloc>
+using geo_ad_id_hashed_container =
+boost::multi_index_container<
+    geo_ad_id_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename geo_ad_id_entity<Alloc>::geo_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(geo_ad_id_entity<Alloc>,uint32_t,geo_id)
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+              geo_ad_id_entity<Alloc>,
+              BOOST_MULTI_INDEX_MEMBER(geo_ad_id_entity<Alloc>,uint32_t,geo_id),
+              BOOST_MULTI_INDEX_MEMBER(geo_ad_id_entity<Alloc>,uint32_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<geo_ad_id_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+  
+}}
+
+#endif /* __IPC_DATA_GEO_AD_ID_ENTITY_HPP__ */
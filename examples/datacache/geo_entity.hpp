@@ -9,12 +9,14 @@
 #define __IPC_DATA_GEO_ENTITY_HPP__
 
 #include "rtb/datacache/base_entity.hpp"
+#include "rtb/datacache/any_str_ops.hpp"
 #include <string>
 #include <cstdint>
 #include <boost/interprocess/containers/string.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/composite_key.hpp>
 
@@ -44,13 +46,8 @@ namespace ipc { namespace data {
             ad_id =  char_string(data.ad_id.data(), data.ad_id.size(), base_type::allocator);
         }
         template<typename Serializable>
-        static std::size_t size(const Serializable && data) {
-            std::stringstream ss;
-            boost::archive::binary_oarchive oarch(ss);
-            oarch << std::forward<Serializable>(data) ;
-            return base_type::size(std::forward<Serializable>(data)) +                
-                   sizeof(data.geo_id) +                
-                   ss.str().size() ;
+        static std::size_t size(const Serializable & data) {
+            return data.ad_id.size() ;
         }
         template<typename Serializable>
         void retrieve(Serializable  & data) const {
@@ -82,6 +79,33 @@ boost::multi_index_container<
     >,
     boost::interprocess::allocator<geo_entity<Alloc>,typename Alloc::segment_manager>
 > ;
+
+//hashed variant, O(1) lookup on geo_id, the second index only keeps geo-ad pairs unique
+template<typename Alloc>
+using geo_hashed_container =
+boost::multi_index_container<
+    geo_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename geo_entity<Alloc>::geo_id_tag>,
+            BOOST_MULTI_INDEX_MEMBER(geo_entity<Alloc>,uint32_t,geo_id)
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+              geo_entity<Alloc>,
+              BOOST_MULTI_INDEX_MEMBER(geo_entity<Alloc>,uint32_t,geo_id),
+              BOOST_MULTI_INDEX_MEMBER(geo_entity<Alloc>,typename geo_entity<Alloc>::char_string,ad_id)
+            >,
+            boost::multi_index::composite_key_hash<
+              boost::hash<uint32_t>, ufw::any_str_hash<Alloc>
+            >,
+            boost::multi_index::composite_key_equal_to<
+              std::equal_to<uint32_t>, ufw::any_str_equal<Alloc>
+            >
+        >
+    >,
+    boost::interprocess::allocator<geo_entity<Alloc>,typename Alloc::segment_manager>
+> ;
   
   
 }}
@@ -0,0 +1,67 @@
+
+/*
+ * Offline cache compiler, loads the bidder caches from their source files into
+ * mapped segment files of output_dir and exits. Bidders started with
+ * bidder.memory_backend = mapped , bidder.cache_base_dir = output_dir and
+ * bidder.warm_start = true map these images read only instead of parsing the sources.
+ * Segment files are sparse, copy them with cp --sparse=always or tar -S.
+ */
+#include <boost/log/trivial.hpp>
+#include <boost/program_options.hpp>
+#include "rtb/config/config.hpp"
+#include "datacache/city_country_entity.hpp"
+#include "datacache/entity_cache.hpp"
+#include "datacache/memory_types.hpp"
+#include "rtb/common/perf_timer.hpp"
+#include "bidder/bidder_caches.hpp"
+#include "config.hpp"
+
+
+#include "rtb/core/core.hpp"
+
+extern void init_framework_logging(const std::string &) ;
+
+
+int main(int argc, char *argv[]) {
+    CacheLoadConfig config([](cache_loader_config_data &d, boost::program_options::options_description &desc){
+        desc.add_options()
+            ("cache-compiler.log", boost::program_options::value<std::string>(&d.log_file_name), "cache_compiler log file name log")
+            ("cache-compiler.output_dir", boost::program_options::value<std::string>(&d.output_dir)->default_value("/tmp/CACHE_IMAGES"), "directory the cache images are written to")
+            ("datacache.ads_source", boost::program_options::value<std::string>(&d.ads_source)->default_value("bidder/data/ads"), "ads_source file name")
+            ("datacache.ads_ipc_name", boost::program_options::value<std::string>(&d.ads_ipc_name)->default_value("vanilla-ads-ipc"), "ads ipc name")
+            ("datacache.geo_source", boost::program_options::value<std::string>(&d.geo_source)->default_value("bidder/data/geo"), "geo_source file name")
+            ("datacache.geo_ipc_name", boost::program_options::value<std::string>(&d.geo_ipc_name)->default_value("vanilla-geo-ipc"), "geo ipc name")
+            ("bidder.geo_campaign_ipc_name", boost::program_options::value<std::string>(&d.geo_campaign_ipc_name)->default_value("vanilla-geo-campaign-ipc"), "geo campaign ipc name")
+            ("bidder.geo_campaign_source", boost::program_options::value<std::string>(&d.geo_campaign_source)->default_value("data/geo_campaign"), "geo_campaign_source file name")
+            ("bidder.campaign_data_source", boost::program_options::value<std::string>(&d.campaign_data_source)->default_value("data/campaign_data"), "campaign_data_source file name")
+            ("bidder.geo_size_ads_ipc_name", boost::program_options::value<std::string>(&d.geo_size_ads_ipc_name)->default_value("vanilla-geo-size-ads-ipc"), "geo size ads ipc name")
+            ("bidder.dictionary_ipc_name", boost::program_options::value<std::string>(&d.dictionary_ipc_name)->default_value("vanilla-dictionary-ipc"), "string dictionary ipc name, shared by id keyed caches")
+        ;
+    });
+
+    try {
+        config.parse(argc, argv);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 1;
+    }
+    LOG(debug) << config;
+    init_framework_logging(config.data().log_file_name);
+    try {
+        //images are always mapped files, a compiled directory replaces the previous generation in place
+        mpclmi::ipc::configure("mapped", config.data().output_dir);
+        auto sp = std::make_shared<std::stringstream>();
+        {
+            perf_timer<std::stringstream> timer(sp, "\ncache compile");
+            vanilla::BidderCaches<CacheLoadConfig> bidder_caches(config);
+            bidder_caches.load();
+        }
+        LOG(info) << sp->str() << "\ncache images written to " << config.data().output_dir;
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 1;
+    }
+    return 0;
+}
@@ -39,6 +39,11 @@ int main(int argc, char *argv[]) {
             ("bidder.geo_campaign_source", boost::program_options::value<std::string>(&d.geo_campaign_source)->default_value("data/geo_campaign"), "geo_campaign_source file name")
             ("bidder.campaign_data_ipc_name", boost::program_options::value<std::string>(&d.campaign_data_ipc_name)->default_value("vanilla-campaign-data-ipc"), "campaign data ipc name")
             ("bidder.campaign_data_source", boost::program_options::value<std::string>(&d.campaign_data_source)->default_value("data/campaign_data"), "campaign_data_source file name")
+            ("bidder.geo_size_ads_ipc_name", boost::program_options::value<std::string>(&d.geo_size_ads_ipc_name)->default_value("vanilla-geo-size-ads-ipc"), "geo size ads ipc name")
+            ("bidder.dictionary_ipc_name", boost::program_options::value<std::string>(&d.dictionary_ipc_name)->default_value("vanilla-dictionary-ipc"), "string dictionary ipc name, shared by id keyed caches")
+            ("datacache.memory_backend", boost::program_options::value<std::string>(&d.memory_backend)->default_value("shared"), "caches memory backend : shared, mapped or heap")
+            ("datacache.cache_base_dir", boost::program_options::value<std::string>(&d.cache_base_dir)->default_value("/tmp/CACHE"), "directory of mapped cache segments")
+            ("datacache.huge_pages", boost::program_options::value<bool>(&d.huge_pages)->default_value(false), "ask for transparent huge pages on cache segments, falls back to 4k pages")
         ;
     });
     
@@ -51,18 +56,82 @@ int main(int argc, char *argv[]) {
     }
     LOG(debug) << config;
     init_framework_logging(config.data().log_file_name);
+    try {
+        mpclmi::ipc::configure(config.data().memory_backend, config.data().cache_base_dir, false, config.data().huge_pages);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
     vanilla::BidderCaches<CacheLoadConfig> bidder_caches(config);
     GeoAdDataEntity<CacheLoadConfig>  geo_ad_cache(config);
     GeoDataEntity<CacheLoadConfig>    geo_cache(config);
     AdDataEntity<CacheLoadConfig>     ad_cache(config);
+    CampaignDataEntity<CacheLoadConfig> campaign_data_cache(config);
+    auto &geo_size_ads = bidder_caches.geo_size_ads_entity;
     
+    //geo_size_ads is derived from geo, geo_campaign, campaign_data and ads, rebuilt after any of them
     std::map<std::string, std::function<void()>> caches = {
         {"geo_ad" , [&geo_ad_cache](){geo_ad_cache.load();}},
-        {"geo"    , [&geo_cache]   (){geo_cache.load();}   },
-        {"ad"     , [&ad_cache]    (){ad_cache.load();}    },
+        {"geo"    , [&geo_cache, &bidder_caches, &geo_size_ads](){geo_cache.load(); bidder_caches.geo_data_entity.load(); geo_size_ads.load();}},
+        {"ad"     , [&ad_cache, &geo_size_ads]    (){ad_cache.load(); geo_size_ads.load();}    },
+        {"geo_campaign" , [&bidder_caches, &geo_size_ads](){bidder_caches.geo_campaign_entity.load(); geo_size_ads.load();}},
+        {"campaign_data", [&campaign_data_cache, &geo_size_ads](){campaign_data_cache.load(); geo_size_ads.load();}},
+        {"geo_size_ads" , [&geo_size_ads](){geo_size_ads.load();}},
         {""       , [&bidder_caches]    (){bidder_caches.load();}    }
     };
     
+    //deltas are applied in place, request body is the delta file path ( "<source>.delta" when empty )
+    //geo_size_ads then updates the posting lists the parsed source records touch, see GeoSizeAdsEntity::apply_delta
+    auto delta_source = [](const std::string &path, const std::string &source) {
+        return path.empty() ? source + ".delta" : path;
+    };
+    auto apply_geo_size_ads = [&](const auto &records) {
+        geo_size_ads.apply_delta(records, ad_cache, bidder_caches.geo_data_entity, bidder_caches.geo_campaign_entity, campaign_data_cache);
+    };
+    std::map<std::string, std::function<std::string(const std::string &)>> deltas = {
+        {"geo", [&](const std::string &path) {
+            auto source = delta_source(path, config.data().geo_source);
+            auto applied = geo_cache.apply_delta(source);
+            //a city moved to another geo_id changes the lists of both geos
+            std::vector<Geo> records;
+            bidder_caches.geo_data_entity.apply_delta(source, [&](const auto &delta) {
+                records.push_back(delta.second);
+                Geo before;
+                if ( bidder_caches.geo_data_entity.retrieve_hot(before, delta.second.city, delta.second.country) && before.geo_id != delta.second.geo_id ) {
+                    records.push_back(before);
+                }
+            });
+            apply_geo_size_ads(records);
+            return "applied=" + std::to_string(applied) + " sequence=" + std::to_string(geo_cache.sequence());
+        }},
+        {"ad", [&](const std::string &path) {
+            std::vector<Ad> records;
+            auto applied = ad_cache.apply_delta(delta_source(path, config.data().ads_source), [&records](const auto &delta) {
+                records.push_back(delta.second);
+            });
+            apply_geo_size_ads(records);
+            return "applied=" + std::to_string(applied) + " sequence=" + std::to_string(ad_cache.sequence());
+        }},
+        {"geo_campaign", [&](const std::string &path) {
+            auto &geo_campaign_cache = bidder_caches.geo_campaign_entity;
+            std::vector<GeoCampaign> records;
+            auto applied = geo_campaign_cache.apply_delta(delta_source(path, config.data().geo_campaign_source), [&records](const auto &delta) {
+                records.push_back(delta.second);
+            });
+            apply_geo_size_ads(records);
+            return "applied=" + std::to_string(applied) + " sequence=" + std::to_string(geo_campaign_cache.sequence());
+        }},
+        {"campaign_data", [&](const std::string &path) {
+            std::vector<CampaignData> records;
+            auto applied = campaign_data_cache.apply_delta(delta_source(path, config.data().campaign_data_source), [&records](const auto &delta) {
+                records.push_back(delta.second);
+            });
+            apply_geo_size_ads(records);
+            return "applied=" + std::to_string(applied) + " sequence=" + std::to_string(campaign_data_cache.sequence());
+        }}
+    };
+
     //initialize and setup CRUD dispatcher
     restful_dispatcher_t dispatcher(config.get("cache-loader.root")) ;
     dispatcher.crud_match(boost::regex("/cache_loader/(\\w*)"))
@@ -74,6 +143,26 @@ int main(int argc, char *argv[]) {
                   LOG(error) << e.what();
               }
     });
+    dispatcher.crud_match(boost::regex("/cache_loader/delta/(\\w+)"))
+              .put([&](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
+              LOG(info) << "received cache delta event url=" << match[0] << " delta=" << match.data;
+              auto delta = deltas.find(match[1].str());
+              if ( delta == deltas.end() ) {
+                  r << "no delta for " + match[1].str() << http::server::reply::flush("text");
+                  return;
+              }
+              try {
+                  r << delta->second(match.data) << http::server::reply::flush("text");
+              } catch (std::exception const& e) {
+                  LOG(error) << e.what();
+                  r << std::string(e.what()) << http::server::reply::flush("text");
+              }
+    });
+    dispatcher.crud_match(boost::regex("/status"))
+              .get([&](http::server::reply & r, const http::crud::crud_match<boost::cmatch> & match) {
+              r << bidder_caches.stats() + geo_ad_cache.stats().to_string() + "\n" + geo_cache.stats().to_string() + "\n" +
+                   ad_cache.stats().to_string() + "\n" + campaign_data_cache.stats().to_string() + "\n" << http::server::reply::flush("text");
+    });
     auto host = config.get("cache-loader.host");
     auto port = config.get("cache-loader.port");
     http::server::server<restful_dispatcher_t> server(host,port,dispatcher);
@@ -15,6 +15,12 @@ struct cache_loader_config_data {
     std::string geo_campaign_source;
     std::string campaign_data_source;
     std::string campaign_data_ipc_name;
+    std::string geo_size_ads_ipc_name;
+    std::string dictionary_ipc_name;
+    std::string memory_backend;
+    std::string cache_base_dir;
+    bool huge_pages;
+    std::string output_dir;
 };
 using CacheLoadConfig = vanilla::config::config<cache_loader_config_data>;
 
@@ -4,6 +4,8 @@ output=`curl -X PUT -H "Content-Type: application/json" http://localhost:10081/c
 output=`curl -X PUT -H "Content-Type: application/json" http://localhost:10081/cache_loader/geo_ad 2> /dev/null`
 output=`curl -X PUT -H "Content-Type: application/json" http://localhost:10081/cache_loader/ad 2> /dev/null`
 #output=`curl -X PUT -H "Content-Type: application/json" http://localhost:10081/cache_loader/ 2> /dev/null`
+#output=`curl -X PUT --data "bidder/data/ads.delta" http://localhost:10081/cache_loader/delta/ad 2> /dev/null`
+#output=`curl http://localhost:10081/status 2> /dev/null`
 
 echo $output
 
@@ -34,46 +34,19 @@
 
 extern void init_framework_logging(const std::string &) ;
 
-int main(int argc, char* argv[]) {
+/*
+ * Serves /bid/ with requests and responses of DSL, with DSL::GenericDSL<jsonv::string_view> strings
+ * point into the request body and bidder replies owned by the handler for the auction.
+ */
+template<typename DSL>
+void run(vanilla::multiexchange::multiexchange_config &config, vanilla::multiexchange::multi_exchange_status &status) {
     using restful_dispatcher_t =  http::crud::crud_dispatcher<http::server::request, http::server::reply> ;
     using namespace vanilla::exchange;
-    using namespace vanilla::multiexchange;
-    namespace po = boost::program_options;   
- 
-    using string_view = std::string;
-    using BidRequest = openrtb::BidRequest<string_view>;
-    //using BidResponse = openrtb::BidResponse<string_view>;
+    using BidRequest = typename DSL::deserialized_type;
+    using string_view = typename DSL::serialized_type::data_type;
 
-    vanilla::multiexchange::multiexchange_config config([&](multi_exchange_handler_config_data &d, po::options_description &desc){
-        desc.add_options()
-            ("multi_exchange.log", po::value<std::string>(&d.log_file_name), "exchange_handler_test log file name log")
-            ("multi_exchange.host", "multi_exchange_handler_test Host")
-            ("multi_exchange.port", "multi_exchange_handler_test Port")
-            ("multi_exchange.root", "multi_exchange_handler_test Root")
-            ("multi_bidder.concurrency", po::value<int>(&d.concurrency)->default_value(0), "concurrency")
-            ("multi_exchange.timeout", po::value<int>(&d.handler_timeout)->required(), "multi_exchange_handler_timeout")
-            ("multi_bidder.timeout", po::value<int>(&d.bidders_response_timeout)->required(), "multi exchange handler bidders request timeout")
-            ("multi_bidder.port", po::value<int>(&d.bidders_port)->required(), "udp port for broadcast")
-            ("multi_bidder.num_of_bidders", po::value<int>(&d.num_bidders)->default_value(1), "number of bidders to wait for")
-            ("multi_bidder.key_value_host", po::value<std::string>(&d.key_value_host), "key value storage host")
-            ("multi_bidder.key_value_port", po::value<int>(&d.key_value_port), "key value storage port")
-        ;
-    });
-    try {
-        config.parse(argc, argv);
-    }
-    catch(std::exception const& e) {
-        LOG(error) << e.what();
-        return 0;
-    }
-    LOG(debug) << config;
-    init_framework_logging(config.data().log_file_name);
-    
-    // status 
-    vanilla::multiexchange::multi_exchange_status status;
-    
     // bid exchange handler
-    vanilla::exchange::exchange_handler<DSL::GenericDSL<>> openrtb_handler_distributor(std::chrono::milliseconds(config.data().handler_timeout));
+    vanilla::exchange::exchange_handler<DSL> openrtb_handler_distributor(std::chrono::milliseconds(config.data().handler_timeout));
     openrtb_handler_distributor
     .logger([](const std::string &data) {
         //LOG(debug) << "request_data for distribution=" << data ;
@@ -86,13 +59,14 @@ int main(int argc, char* argv[]) {
         using namespace vanilla::messaging;
         ++status.request_count;
                 
-        vanilla::VanillaRequest vanilla_request;
+        vanilla::BasicVanillaRequest<DSL> vanilla_request;
         vanilla_request.bid_request = request; // optimize
         
         if(request.user) {
-            vanilla_request.user_info.user_id = request.user.get().buyeruid;
+            auto &buyeruid = request.user.get().buyeruid;
+            vanilla_request.user_info.user_id.assign(buyeruid.data(), buyeruid.size());
         }
-        vanilla::multibidder_communicator<DSL::GenericDSL<> > communicator(
+        vanilla::multibidder_communicator<DSL> communicator(
             config.data().bidders_port, 
             std::chrono::milliseconds(config.data().bidders_response_timeout)
         );
@@ -159,6 +133,45 @@ int main(int argc, char* argv[]) {
     catch (std::exception const & e) {
         LOG(error) << e.what();
     }
-    return 0;
 }
 
+int main(int argc, char* argv[]) {
+    using namespace vanilla::multiexchange;
+    namespace po = boost::program_options;   
+ 
+    vanilla::multiexchange::multiexchange_config config([&](multi_exchange_handler_config_data &d, po::options_description &desc){
+        desc.add_options()
+            ("multi_exchange.log", po::value<std::string>(&d.log_file_name), "exchange_handler_test log file name log")
+            ("multi_exchange.host", "multi_exchange_handler_test Host")
+            ("multi_exchange.port", "multi_exchange_handler_test Port")
+            ("multi_exchange.root", "multi_exchange_handler_test Root")
+            ("multi_bidder.concurrency", po::value<int>(&d.concurrency)->default_value(0), "concurrency")
+            ("multi_exchange.timeout", po::value<int>(&d.handler_timeout)->required(), "multi_exchange_handler_timeout")
+            ("multi_bidder.timeout", po::value<int>(&d.bidders_response_timeout)->required(), "multi exchange handler bidders request timeout")
+            ("multi_bidder.port", po::value<int>(&d.bidders_port)->required(), "udp port for broadcast")
+            ("multi_bidder.num_of_bidders", po::value<int>(&d.num_bidders)->default_value(1), "number of bidders to wait for")
+            ("multi_bidder.key_value_host", po::value<std::string>(&d.key_value_host), "key value storage host")
+            ("multi_bidder.key_value_port", po::value<int>(&d.key_value_port), "key value storage port")
+            ("multi_exchange.zero_copy", po::value<bool>(&d.zero_copy)->default_value(false), "string_view requests and responses, wire format is the same either way")
+        ;
+    });
+    try {
+        config.parse(argc, argv);
+    }
+    catch(std::exception const& e) {
+        LOG(error) << e.what();
+        return 0;
+    }
+    LOG(debug) << config;
+    init_framework_logging(config.data().log_file_name);
+    
+    // status 
+    vanilla::multiexchange::multi_exchange_status status;
+    
+    if (config.data().zero_copy) {
+        run<DSL::GenericDSL<jsonv::string_view>>(config, status);
+    } else {
+        run<DSL::GenericDSL<>>(config, status);
+    }
+    return 0;
+}
@@ -23,11 +23,13 @@ namespace vanilla {
             int concurrency;
             std::string key_value_host;
             int key_value_port;
+            bool zero_copy;
 
 
             multi_exchange_handler_config_data() :
                 log_file_name{}, handler_timeout{}, num_bidders{}, bidders_port{}, bidders_response_timeout{}, concurrency{},
-                key_value_host{}, key_value_port{}
+                key_value_host{}, key_value_port{},
+                zero_copy{}
             {
             }
         };
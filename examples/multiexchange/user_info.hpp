@@ -18,7 +18,10 @@ namespace vanilla {
         std::string user_data{};
     };
     
-    using VanillaRequest = vanilla::BidRequest<DSL::GenericDSL<std::string>, vanilla::UserInfo>;
+    //DSL::GenericDSL<jsonv::string_view> for requests pointing into the bytes they were read from
+    template<typename DSL>
+    using BasicVanillaRequest = vanilla::BidRequest<DSL, vanilla::UserInfo>;
+    using VanillaRequest = BasicVanillaRequest<DSL::GenericDSL<std::string>>;
 }
 
 
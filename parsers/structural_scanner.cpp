@@ -0,0 +1,368 @@
+/*
+ * File:   structural_scanner.cpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#include "structural_scanner.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define PARSERS_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace parsers {
+
+namespace {
+
+    //one bit per byte of a 64 byte block
+    struct block_masks {
+        uint64_t op;        // { } [ ] : ,
+        uint64_t ws;        // space \t \n \r
+        uint64_t quote;
+        uint64_t backslash;
+    };
+
+    enum : uint8_t { OP = 1, WS = 2, QUOTE = 4, BACKSLASH = 8 };
+
+    struct char_classes {
+        uint8_t table[256];
+
+        constexpr char_classes() : table{} {
+            for (const char c : {'{', '}', '[', ']', ':', ','}) {
+                table[uint8_t(c)] = OP;
+            }
+            for (const char c : {' ', '\t', '\n', '\r'}) {
+                table[uint8_t(c)] = WS;
+            }
+            table[uint8_t('"')] = QUOTE;
+            table[uint8_t('\\')] = BACKSLASH;
+        }
+    };
+
+    struct scalar_classifier {
+        static block_masks classify(const char *block) {
+            static constexpr char_classes classes{};
+            block_masks masks{};
+            for (unsigned i = 0; i < 64; ++i) {
+                const uint64_t c = classes.table[uint8_t(block[i])];
+                masks.op |= (c & 1) << i;
+                masks.ws |= (c >> 1 & 1) << i;
+                masks.quote |= (c >> 2 & 1) << i;
+                masks.backslash |= (c >> 3 & 1) << i;
+            }
+            return masks;
+        }
+    };
+
+#ifdef PARSERS_SCANNER_X86
+    [[gnu::target("sse4.2")]]
+    inline uint64_t equal_sse42(const __m128i (&chunks)[4], char c) {
+        const __m128i value = _mm_set1_epi8(c);
+        uint64_t mask = 0;
+        for (unsigned i = 0; i < 4; ++i) {
+            mask |= uint64_t(uint16_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunks[i], value)))) << (16 * i);
+        }
+        return mask;
+    }
+
+    struct sse42_classifier {
+        [[gnu::target("sse4.2")]]
+        static block_masks classify(const char *block) {
+            const __m128i case_bit = _mm_set1_epi8(0x20);
+            __m128i chunks[4], folded[4];
+            for (unsigned i = 0; i < 4; ++i) {
+                chunks[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+                folded[i] = _mm_or_si128(chunks[i], case_bit); // [ ] fold onto { }
+            }
+            return {
+                equal_sse42(folded, '{') | equal_sse42(folded, '}') | equal_sse42(chunks, ':') | equal_sse42(chunks, ','),
+                equal_sse42(chunks, ' ') | equal_sse42(chunks, '\t') | equal_sse42(chunks, '\n') | equal_sse42(chunks, '\r'),
+                equal_sse42(chunks, '"'),
+                equal_sse42(chunks, '\\')
+            };
+        }
+    };
+
+    [[gnu::target("avx2")]]
+    inline uint64_t equal_avx2(__m256i low, __m256i high, char c) {
+        const __m256i value = _mm256_set1_epi8(c);
+        return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, value)))) |
+               uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, value)))) << 32;
+    }
+
+    struct avx2_classifier {
+        [[gnu::target("avx2")]]
+        static block_masks classify(const char *block) {
+            const __m256i case_bit = _mm256_set1_epi8(0x20);
+            const __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+            const __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32));
+            const __m256i low_folded = _mm256_or_si256(low, case_bit); // [ ] fold onto { }
+            const __m256i high_folded = _mm256_or_si256(high, case_bit);
+            return {
+                equal_avx2(low_folded, high_folded, '{') | equal_avx2(low_folded, high_folded, '}') |
+                equal_avx2(low, high, ':') | equal_avx2(low, high, ','),
+                equal_avx2(low, high, ' ') | equal_avx2(low, high, '\t') | equal_avx2(low, high, '\n') | equal_avx2(low, high, '\r'),
+                equal_avx2(low, high, '"'),
+                equal_avx2(low, high, '\\')
+            };
+        }
+    };
+#endif
+
+    //bit i set when an odd number of bits at or below i are set
+    inline uint64_t prefix_xor(uint64_t bits) {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    //quotes preceded by an odd run of backslashes, carry tells the next block its first byte is escaped
+    inline uint64_t escaped_quotes(uint64_t quote, uint64_t backslash, uint64_t &carry) {
+        uint64_t escaped = carry;
+        carry = 0;
+        while (backslash) {
+            const uint64_t bit = backslash & (0 - backslash);
+            if (!(escaped & bit)) {
+                if (bit >> 63) {
+                    carry = 1;
+                } else {
+                    escaped |= bit << 1;
+                }
+            }
+            backslash ^= bit;
+        }
+        return quote & escaped;
+    }
+
+    template<typename Classifier>
+    std::size_t index_blocks(const char *json, std::size_t length, uint32_t *out) {
+        uint32_t *const first = out;
+        uint64_t in_string = 0;     // all ones when the previous block ended inside a string
+        uint64_t escape_carry = 0;
+        uint64_t scalar_carry = 0;  // previous block ended inside a primitive
+        char tail[64];
+        for (std::size_t base = 0; base < length; base += 64) {
+            const char *block = json + base;
+            if (length - base < 64) {
+                std::memset(tail, ' ', sizeof(tail));
+                std::memcpy(tail, block, length - base);
+                block = tail;
+            }
+            const block_masks masks = Classifier::classify(block);
+            uint64_t quote = masks.quote;
+            if (masks.backslash | escape_carry) {
+                quote &= ~escaped_quotes(quote, masks.backslash, escape_carry);
+            }
+            const uint64_t inside = prefix_xor(quote) ^ in_string; // opening quote and string body
+            in_string = uint64_t(0) - (inside >> 63);
+            const uint64_t scalar = ~(masks.op | masks.ws | quote | inside);
+            const uint64_t starts = scalar & ~(scalar << 1 | scalar_carry);
+            scalar_carry = scalar >> 63;
+            uint64_t structurals = (masks.op & ~inside) | quote | starts;
+            while (structurals) {
+                *out++ = uint32_t(base + __builtin_ctzll(structurals));
+                structurals &= structurals - 1;
+            }
+        }
+        return out - first;
+    }
+
+    inline bool is_hex(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'A' && c <= 'F') || (c >= 'a' && c <= 'f');
+    }
+
+    //escapes jsmn accepts
+    bool valid_escapes(const char *first, const char *last) {
+        while ((first = static_cast<const char*>(std::memchr(first, '\\', last - first)))) {
+            if (++first == last) {
+                return false;
+            }
+            switch (*first++) {
+                case '"': case '/' : case '\\' : case 'b' :
+                case 'f' : case 'r' : case 'n'  : case 't' :
+                    break;
+                case 'u':
+                    for (unsigned i = 0; i < 4; ++i, ++first) {
+                        if (first == last || !is_hex(*first)) {
+                            return false;
+                        }
+                    }
+                    break;
+                default:
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    inline void fill(jsmntok_t &token, jsmntype_t type, int start, int end) {
+        token.type = type;
+        token.start = start;
+        token.end = end;
+        token.size = 0;
+    }
+}
+
+constexpr unsigned structural_scanner::UNLIMITED;
+
+structural_scanner::simd structural_scanner::detected() {
+#ifdef PARSERS_SCANNER_X86
+    static const simd level = [] {
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? simd::AVX2 :
+               __builtin_cpu_supports("sse4.2") ? simd::SSE42 : simd::SCALAR;
+    }();
+    return level;
+#else
+    return simd::SCALAR;
+#endif
+}
+
+structural_scanner::structural_scanner(std::size_t tokens, simd level) :
+    level_{level > detected() ? detected() : level}, tape_(tokens)
+{}
+
+int structural_scanner::parse(const char *json, std::size_t length, unsigned depth) {
+    if (length > std::size_t(std::numeric_limits<int>::max())) {
+        return JSMN_ERROR_NOMEM;
+    }
+    const std::size_t structurals = index(json, length);
+    if (tape_.size() < structurals) { // every token starts at its own structural
+        tape_.resize(structurals);
+    }
+    return build(json, length, structurals, depth);
+}
+
+std::size_t structural_scanner::index(const char *json, std::size_t length) {
+    if (index_.size() < length) {
+        index_.resize(length);
+    }
+    switch (level_) {
+#ifdef PARSERS_SCANNER_X86
+        case simd::AVX2:
+            return index_blocks<avx2_classifier>(json, length, index_.data());
+        case simd::SSE42:
+            return index_blocks<sse42_classifier>(json, length, index_.data());
+#endif
+        default:
+            return index_blocks<scalar_classifier>(json, length, index_.data());
+    }
+}
+
+//same token tree as jsmn_parse, toksuper becomes super
+int structural_scanner::build(const char *json, std::size_t length, std::size_t structurals, unsigned depth) {
+    const uint32_t *index = index_.data();
+    jsmntok_t *tape = tape_.data();
+    int next = 0;
+    int super = -1;
+    open_.clear();
+    for (std::size_t k = 0; k < structurals; ++k) {
+        const uint32_t pos = index[k];
+        const char c = json[pos];
+        switch (c) {
+            case '{': case '[': {
+                const jsmntype_t type = c == '{' ? JSMN_OBJECT : JSMN_ARRAY;
+                if (super != -1) {
+                    tape[super].size++;
+                }
+                fill(tape[next], type, pos, -1);
+                if (open_.size() < depth) {
+                    open_.push_back(next);
+                    super = next++;
+                    break;
+                }
+                //too deep, find the matching bracket and keep the subtree as is
+                closers_.assign(1, c == '{' ? '}' : ']');
+                for (++k; k < structurals && !closers_.empty(); ++k) {
+                    const char inner = json[index[k]];
+                    if (inner == '{' || inner == '[') {
+                        closers_.push_back(inner == '{' ? '}' : ']');
+                    } else if (inner == '}' || inner == ']') {
+                        if (inner != closers_.back()) {
+                            return JSMN_ERROR_INVAL;
+                        }
+                        closers_.pop_back();
+                    }
+                }
+                if (!closers_.empty()) {
+                    return JSMN_ERROR_PART;
+                }
+                tape[next++].end = index[--k] + 1;
+                super = open_.empty() ? -1 : open_.back();
+                break;
+            }
+            case '}': case ']':
+                if (open_.empty() || tape[open_.back()].type != (c == '}' ? JSMN_OBJECT : JSMN_ARRAY)) {
+                    return JSMN_ERROR_INVAL;
+                }
+                tape[open_.back()].end = pos + 1;
+                open_.pop_back();
+                super = open_.empty() ? -1 : open_.back();
+                break;
+            case '"': {
+                if (++k == structurals) {
+                    return JSMN_ERROR_PART;
+                }
+                const uint32_t end = index[k]; // closing quote
+                if (!valid_escapes(json + pos + 1, json + end)) {
+                    return JSMN_ERROR_INVAL;
+                }
+                fill(tape[next++], JSMN_STRING, pos + 1, end);
+                if (super != -1) {
+                    tape[super].size++;
+                }
+                break;
+            }
+            case ':':
+                super = next - 1;
+                break;
+            case ',':
+                if (super != -1 && tape[super].type != JSMN_ARRAY && tape[super].type != JSMN_OBJECT) {
+                    super = open_.empty() ? -1 : open_.back();
+                }
+                break;
+            default: {
+                std::size_t end = pos;
+                for (; end < length; ++end) {
+                    const uint8_t d = json[end];
+                    if (d == '\t' || d == '\r' || d == '\n' || d == ' ' || d == ',' || d == ']' || d == '}' || d == ':') {
+                        break;
+                    }
+                    if (d < 32 || d >= 127 || d == '"') { // a quote would put the index out of step with strings
+                        return JSMN_ERROR_INVAL;
+                    }
+                }
+                fill(tape[next++], JSMN_PRIMITIVE, pos, int(end));
+                if (super != -1) {
+                    tape[super].size++;
+                }
+                while (k + 1 < structurals && index[k + 1] < end) { // jsmn reads brackets into the primitive
+                    ++k;
+                }
+                break;
+            }
+        }
+    }
+    if (!open_.empty()) {
+        return JSMN_ERROR_PART;
+    }
+    return next;
+}
+
+} //namespace
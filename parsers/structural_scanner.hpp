@@ -0,0 +1,77 @@
+/*
+ * File:   structural_scanner.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef PARSERS_STRUCTURAL_SCANNER_HPP
+#define PARSERS_STRUCTURAL_SCANNER_HPP
+
+#include "jsmn.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace parsers {
+
+    /*
+     * Drop-in for jsmn_parse producing the same tokens ( non strict mode ) without a token limit.
+     *
+     * The first pass classifies 64 byte blocks with AVX2, SSE4.2 or plain C++ picked at runtime
+     * and writes the offsets of brackets, separators, unescaped quotes and primitive starts
+     * outside of strings into a structural index. The second pass walks the index into the
+     * token tape. Containers nested deeper than the requested depth are not tokenized : they
+     * become one token spanning the whole subtree with size 0, their brackets only counted.
+     *
+     * Index and tape grow on demand and are reused by the next parse, keep one scanner
+     * per thread.
+     */
+    class structural_scanner {
+    public:
+        enum class simd { SCALAR, SSE42, AVX2 };
+
+        static constexpr unsigned UNLIMITED = std::numeric_limits<unsigned>::max();
+
+        //best level the cpu supports
+        static simd detected();
+
+        explicit structural_scanner(std::size_t tokens = 128, simd level = detected());
+
+        //number of tokens or jsmnerr, tokens valid until the next parse
+        int parse(const char *json, std::size_t length, unsigned depth = UNLIMITED);
+
+        jsmntok_t * tokens() {
+            return tape_.data();
+        }
+        const jsmntok_t * tokens() const {
+            return tape_.data();
+        }
+        simd level() const {
+            return level_;
+        }
+
+    private:
+        std::size_t index(const char *json, std::size_t length);
+        int build(const char *json, std::size_t length, std::size_t structurals, unsigned depth);
+
+        simd level_;
+        std::vector<uint32_t> index_;
+        std::vector<jsmntok_t> tape_;
+        std::vector<int> open_;
+        std::vector<char> closers_;
+    };
+
+} //namespace
+
+#endif /* PARSERS_STRUCTURAL_SCANNER_HPP */
@@ -21,6 +21,7 @@
 #define RTB_DSL_MAPPER_HPP
 
 #include "core/openrtb.hpp"
+#include "token_decoder.hpp"
 #include <vector>
 #include <boost/optional.hpp>
 
@@ -56,6 +57,95 @@ namespace DSL {
             
         
     public:
+        //static description of build_request for token_decoder, keep the two in sync
+        static constexpr auto members(type_tag<Banner>) {
+            return fields(field("h", &Banner::h), field("w", &Banner::w), field("pos", &Banner::pos));
+        }
+        static constexpr auto members(type_tag<Impression>) {
+            return fields(field("id", &Impression::id), field("banner", &Impression::banner),
+                          field("bidfloor", &Impression::bidfloor), field("bidfloorcur", &Impression::bidfloorcur));
+        }
+        static constexpr auto members(type_tag<User>) {
+            return fields(field("id", &User::id), field("buyeruid", &User::buyeruid), field("geo", &User::geo));
+        }
+        static constexpr auto members(type_tag<Geo>) {
+            return fields(field("city", &Geo::city), field("country", &Geo::country));
+        }
+        static constexpr auto members(type_tag<Site>) {
+            return fields(field("id", &Site::id));
+        }
+        static constexpr auto members(type_tag<BidRequest>) {
+            return fields(field("id", &BidRequest::id), field("imp", &BidRequest::imp),
+                          field("cur", &BidRequest::cur), field("tmax", &BidRequest::tmax),
+                          field("user", &BidRequest::user), field("site", &BidRequest::site));
+        }
+        //static description of build_response for response_writer, keep the two in sync
+        static constexpr auto members(type_tag<Bid>) {
+            return fields(field("id", &Bid::id), field("impid", &Bid::impid), field("price", &Bid::price),
+                          field("adid", &Bid::adid), field("nurl", &Bid::nurl), field("adm", &Bid::adm),
+                          field("adomain", &Bid::adomain), field("iurl", &Bid::iurl), field("cid", &Bid::cid),
+                          field("crid", &Bid::crid), field("attr", &Bid::attr));
+        }
+        static constexpr auto members(type_tag<SeatBid>) {
+            return fields(field("bid", &SeatBid::bid), field("seat", &SeatBid::seat),
+                          field("group", &SeatBid::group), field("ext", &SeatBid::ext));
+        }
+        static constexpr auto members(type_tag<BidResponse>) {
+            return fields(field("id", &BidResponse::id), field("seatbid", &BidResponse::seatbid),
+                          field("bidid", &BidResponse::bidid), field("cur", &BidResponse::cur),
+                          field("customdata", &BidResponse::customdata), field("nbr", &BidResponse::nbr),
+                          field("ext", &BidResponse::ext));
+        }
+        static constexpr auto values(type_tag<AdPosition>) {
+            using pos = enum_value<AdPosition>;
+            return enum_values<AdPosition>(
+                pos{ AdPosition::UNKNOWN,  0 },
+                pos{ AdPosition::ABOVE, 1 },
+                pos{ AdPosition::BETWEEN_DEPRECATED, 2 },
+                pos{ AdPosition::BELOW, 3 },
+                pos{ AdPosition::HEADER, 4 },
+                pos{ AdPosition::FOOTER, 5 },
+                pos{ AdPosition::SIDEBAR, 6 },
+                pos{ AdPosition::FULLSCREEN, 7 }
+            );
+        }
+        static constexpr auto values(type_tag<CreativeAttribute>) {
+            using attr = enum_value<CreativeAttribute>;
+            return enum_values<CreativeAttribute>(
+                attr{ CreativeAttribute::UNDEFINED, -1 },
+                attr{ CreativeAttribute::AUDIO_AD_AUTO_PLAY, 1 },
+                attr{ CreativeAttribute::AUDIO_AD_USER_INITIATED, 2 },
+                attr{ CreativeAttribute::EXPANDABLE_AUTOMATIC, 3 },
+                attr{ CreativeAttribute::EXPANDABLE_USER_INITIATED_CLICK, 4 },
+                attr{ CreativeAttribute::EXPANDABLE_USER_INITIATED_ROLLOVER, 5 },
+                attr{ CreativeAttribute::IN_BANNER_VIDEO_AD_AUTO_PLAY, 6 },
+                attr{ CreativeAttribute::IN_BANNER_VIDEO_AD_USER_INITIATED, 7 },
+                attr{ CreativeAttribute::POP, 8 },
+                attr{ CreativeAttribute::PROVOCATIVE_OR_SUGGESTIVE_IMAGERY, 9 },
+                attr{ CreativeAttribute::SHAKY_FLASHING_FLICKERING_EXTREME_ANIMATION_SMILEYS, 10 },
+                attr{ CreativeAttribute::SURVEYS, 11 },
+                attr{ CreativeAttribute::TEXT_ONLY, 12 },
+                attr{ CreativeAttribute::USER_INTERACTIVE, 13 },
+                attr{ CreativeAttribute::WINDOWS_DIALOG_OR_ALERT_STYLE, 14 },
+                attr{ CreativeAttribute::HAS_AUDIO_ON_OFF_BUTTON, 15 },
+                attr{ CreativeAttribute::AD_CAN_BE_SKIPPED, 16 }
+            );
+        }
+        static constexpr auto values(type_tag<NoBidReason>) {
+            using nbr = enum_value<NoBidReason>;
+            return enum_values<NoBidReason>(
+                nbr{ NoBidReason::UNKNOWN_ERROR, 0 },
+                nbr{ NoBidReason::TECHNICAL_ERROR, 1 },
+                nbr{ NoBidReason::INVALID_REQUEST, 2 },
+                nbr{ NoBidReason::KNOWN_WEB_SPIDER, 3 },
+                nbr{ NoBidReason::SUSPECTED_NON_HUMAN_TRAFFIC, 4 },
+                nbr{ NoBidReason::CLOUD_DATACENTER_OR_PROXY_IP, 5 },
+                nbr{ NoBidReason::UNSUPPORTED_DEVICE, 6 },
+                nbr{ NoBidReason::BLOCKED_PUBLISHER_OR_SITE, 7 },
+                nbr{ NoBidReason::UNMATCHED_USER, 8 }
+            );
+        }
+
         formats build_request() 
         {
             formats base_in = formats_builder()
@@ -92,6 +182,8 @@ namespace DSL {
                 .template type<BidRequest>()
                 .member("id", &BidRequest::id)
                 .member("imp", &BidRequest::imp)
+                .member("cur", &BidRequest::cur)
+                .member("tmax", &BidRequest::tmax)
                 .member("user", &BidRequest::user)
                 .member("site", &BidRequest::site)
                 .encode_if([](const jsonv::serialization_context&, const boost::optional<Site>& x) {return bool(x);})
@@ -21,6 +21,8 @@
 
 #include "encoders.hpp"
 #include "dsl_mapper.hpp"
+#include "response_writer.hpp"
+#include "parsers/structural_scanner.hpp"
 
 namespace DSL {
     using namespace jsonv;
@@ -38,26 +40,77 @@ namespace DSL {
             response_fmt_ = this->build_response(); 
         }
 
+        /*
+         * Mappers describing their request types ( see dsl_mapper::members ) are decoded straight
+         * from the scanner tokens, subtrees deeper than the description are not tokenized. Others
+         * go through the jsonv DOM. With T = jsonv::string_view strings of the request point into
+         * bid_request itself ( into the token tree of the calling thread for the DOM ) and must
+         * not outlive it.
+         */
         template<typename string_view_type>
         deserialized_type extract_request(const string_view_type & bid_request) {
-            jsmn_parser parser;
-            jsmntok_t t[Size];
-            thread_local jsonv::value encoded;
-            encoded.clear();
-            jsmn_init(&parser);
-            auto r = jsmn_parse(&parser, bid_request.c_str(), bid_request.length(), t, sizeof(t)/sizeof(t[0]));
-            if (r < 0) {
-                throw std::runtime_error("DSL::jsmn_parse exception");
-            }
-            encoders::encode(bid_request.c_str(), &t[0], parser.toknext, encoded);
-            return extract<deserialized_type>(encoded, request_fmt_);
+            using decoded = has_members<Mapper<T>, deserialized_type>;
+            const int r = tokenize(bid_request, decoded::value ? nesting<Mapper<T>, deserialized_type>::value :
+                                                                 parsers::structural_scanner::UNLIMITED);
+            return decode(bid_request.data(), scanner().tokens(), r, decoded{});
+        }
+
+        //reference path through encoders::encode and jsonv::extract
+        template<typename string_view_type>
+        deserialized_type extract_request_dom(const string_view_type & bid_request) {
+            const int r = tokenize(bid_request, parsers::structural_scanner::UNLIMITED);
+            return decode(bid_request.data(), scanner().tokens(), r, std::false_type{});
         }
 
         auto create_response(const serialized_type & bid_response) {
             return to_json(bid_response, response_fmt_);
         }
 
+        /*
+         * Appends the json of create_response to out, byte for byte. Mappers describing their
+         * response types are written straight from the response without a jsonv value.
+         */
+        void write_response(const serialized_type & bid_response, std::string & out) {
+            write(bid_response, out, has_members<Mapper<T>, serialized_type>{});
+        }
+
     private:
+        //token tape of the calling thread, Size is only its initial capacity
+        static parsers::structural_scanner & scanner() {
+            thread_local parsers::structural_scanner scanner{Size};
+            return scanner;
+        }
+
+        template<typename string_view_type>
+        static int tokenize(const string_view_type & bid_request, unsigned depth) {
+            auto r = scanner().parse(bid_request.data(), bid_request.length(), depth);
+            if (r < 0) {
+                throw std::runtime_error("DSL::structural_scanner exception");
+            }
+            return r;
+        }
+
+        void write(const serialized_type & bid_response, std::string & out, std::true_type) {
+            response_writer<Mapper<T>>(out).write(bid_response);
+        }
+
+        void write(const serialized_type & bid_response, std::string & out, std::false_type) {
+            out += to_string(create_response(bid_response));
+        }
+
+        deserialized_type decode(const char *json, jsmntok_t *t, int count, std::true_type) {
+            deserialized_type request{};
+            token_decoder<Mapper<T>>(json, t, count).decode(request);
+            return request;
+        }
+
+        deserialized_type decode(const char *json, jsmntok_t *t, int count, std::false_type) {
+            thread_local jsonv::value encoded;
+            encoded.clear();
+            encoders::encode(json, t, count, encoded);
+            return extract<deserialized_type>(encoded, request_fmt_);
+        }
+
         formats request_fmt_;
         formats response_fmt_;
     };
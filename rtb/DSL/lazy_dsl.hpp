@@ -0,0 +1,187 @@
+/*
+ * File:   lazy_dsl.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef RTB_DSL_LAZY_DSL_HPP
+#define RTB_DSL_LAZY_DSL_HPP
+
+#include "generic_dsl.hpp"
+#include <array>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+namespace DSL {
+
+    namespace detail {
+        //Member is the type of a described member
+        template<typename Member, typename Fields>
+        struct describes;
+
+        template<typename Member, typename ...Classes, typename ...Members>
+        struct describes<Member, std::tuple<member_field<Classes, Members>...>> :
+            std::integral_constant<bool, !std::is_same<std::integer_sequence<bool, false, std::is_same<Member, Members>::value...>,
+                                                       std::integer_sequence<bool, std::is_same<Member, Members>::value..., false>>::value> {};
+    }
+
+    /*
+     * Bid request decoding its members the first time they are read. Construction only indexes
+     * the top level object, nested objects and arrays are not tokenized : each member of the
+     * mapper description remembers where its value is, get(&request_type::member) decodes that
+     * one value with token_decoder and keeps it. Members outside of the description stay value
+     * initialized as with GenericDSL.
+     *
+     * Values nobody reads are never checked, a malformed member throws from the get() touching
+     * it. The json must outlive the request whatever T is, and one thread at a time uses it.
+     */
+    template<typename T, typename Mapper>
+    class lazy_request {
+        using fields_type = std::decay_t<decltype(Mapper::members(type_tag<openrtb::BidRequest<T>>{}))>;
+        using indices = std::make_index_sequence<std::tuple_size<fields_type>::value>;
+        static_assert(std::tuple_size<fields_type>::value <= 64, "members are tracked in a 64 bit mask");
+
+        struct span {
+            int start;
+            int end;
+        };
+
+    public:
+        using request_type = openrtb::BidRequest<T>;
+
+        lazy_request() : json{}, spans{}, fields{}, decoded{} {
+            spans.fill(span{-1, -1});
+        }
+
+        lazy_request(const char *json, std::size_t length) : lazy_request() {
+            this->json = json;
+            index(length);
+        }
+
+        template<typename Member>
+        const Member & get(Member request_type::*member) const {
+            return get(member, detail::describes<Member, fields_type>{});
+        }
+
+        //same interface as openrtb::BidRequest
+        const lazy_request & request() const {
+            return *this;
+        }
+
+    private:
+        template<typename Member>
+        const Member & get(Member request_type::*member, std::true_type) const {
+            const int i = index_of(member, indices{});
+            if (i >= 0 && !(decoded & (uint64_t(1) << i))) {
+                decode(fields.*member, spans[i]);
+                decoded |= uint64_t(1) << i;
+            }
+            return fields.*member;
+        }
+
+        template<typename Member>
+        const Member & get(Member request_type::*member, std::false_type) const {
+            return fields.*member;
+        }
+
+        static parsers::structural_scanner & scanner() {
+            thread_local parsers::structural_scanner scanner;
+            return scanner;
+        }
+
+        //key and value of every top level member, the first of duplicate keys wins
+        void index(std::size_t length) {
+            static constexpr auto members = Mapper::members(type_tag<request_type>{});
+            static constexpr auto keys = detail::key_names(members, indices{});
+            static constexpr auto table = detail::make_key_table(keys);
+
+            const int count = scanner().parse(json, length, 1);
+            if (count < 0) {
+                throw std::runtime_error("DSL::structural_scanner exception");
+            }
+            const jsmntok_t *tokens = scanner().tokens();
+            if (count == 0 || tokens[0].type != JSMN_OBJECT || 2 * tokens[0].size >= count) {
+                throw std::runtime_error("DSL::lazy_request object expected");
+            }
+            for (int i = 0; i < tokens[0].size; ++i) {
+                const jsmntok_t &key = tokens[1 + 2 * i];
+                const jsmntok_t &value = tokens[2 + 2 * i];
+                if (key.type != JSMN_STRING) {
+                    throw std::runtime_error("DSL::lazy_request unexpected json type");
+                }
+                const char *name = json + key.start;
+                const std::size_t name_length = key.end - key.start;
+                const int8_t m = table.find(name, name_length);
+                if (m >= 0 && spans[m].start < 0 &&
+                    keys[m].length == name_length && std::memcmp(keys[m].name, name, name_length) == 0) {
+                    spans[m] = value.type == JSMN_STRING ? span{value.start - 1, value.end + 1} : span{value.start, value.end};
+                }
+            }
+        }
+
+        template<typename Member>
+        void decode(Member &out, span value) const {
+            if (value.start < 0) {
+                return;
+            }
+            const char *first = json + value.start;
+            const int count = scanner().parse(first, value.end - value.start, nesting<Mapper, Member>::value);
+            if (count < 0) {
+                throw std::runtime_error("DSL::structural_scanner exception");
+            }
+            token_decoder<Mapper>(first, scanner().tokens(), count).decode(out);
+        }
+
+        template<typename Member, std::size_t ...I>
+        static int index_of(Member request_type::*member, std::index_sequence<I...>) {
+            static constexpr auto members = Mapper::members(type_tag<request_type>{});
+            int index = -1;
+            (void)std::initializer_list<int>{ (index < 0 && same(std::get<I>(members).pointer, member) ? index = int(I) : 0)... };
+            return index;
+        }
+
+        template<typename Member>
+        static bool same(Member request_type::*mapped, Member request_type::*member) {
+            return mapped == member;
+        }
+
+        template<typename Other, typename Member>
+        static bool same(Other request_type::*, Member request_type::*) {
+            return false;
+        }
+
+        const char *json;
+        std::array<span, std::tuple_size<fields_type>::value> spans;
+        mutable request_type fields;
+        mutable uint64_t decoded;
+    };
+
+    /*
+     * GenericDSL handing out lazy_request, for handlers reading a few members of the request
+     * and answering most of them with no bid.
+     */
+    template<typename T=std::string , template<class> class Mapper = DSL::dsl_mapper>
+    class LazyDSL : public GenericDSL<T, Mapper> {
+    public:
+        using deserialized_type = lazy_request<T, Mapper<T>>;
+
+        template<typename string_view_type>
+        deserialized_type extract_request(const string_view_type & bid_request) {
+            return deserialized_type(bid_request.data(), bid_request.length());
+        }
+    };
+
+} //namespace
+
+#endif /* RTB_DSL_LAZY_DSL_HPP */
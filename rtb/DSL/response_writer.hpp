@@ -0,0 +1,373 @@
+/*
+ * File:   response_writer.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef RTB_DSL_RESPONSE_WRITER_HPP
+#define RTB_DSL_RESPONSE_WRITER_HPP
+
+#include "token_decoder.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace DSL {
+
+    namespace detail {
+        //std::string ordering of two keys, the order of a jsonv object
+        constexpr bool key_less(const key_name &a, const key_name &b) {
+            for (std::size_t i = 0; i < a.length && i < b.length; ++i) {
+                if (uint8_t(a.name[i]) != uint8_t(b.name[i])) {
+                    return uint8_t(a.name[i]) < uint8_t(b.name[i]);
+                }
+            }
+            return a.length < b.length;
+        }
+
+        template<std::size_t N>
+        struct key_order {
+            std::size_t index[N];
+        };
+
+        //indices of the keys sorted by name
+        template<std::size_t N>
+        constexpr key_order<N> make_key_order(const std::array<key_name, N> &keys) {
+            key_order<N> order{};
+            for (std::size_t i = 0; i < N; ++i) {
+                std::size_t j = i;
+                for (; j > 0 && key_less(keys[i], keys[order.index[j - 1]]); --j) {
+                    order.index[j] = order.index[j - 1];
+                }
+                order.index[j] = i;
+            }
+            return order;
+        }
+
+        //per byte : 0 copied as is, escape letter after a backslash, 'u' for \u escapes
+        struct escape_table {
+            char code[256];
+        };
+
+        constexpr escape_table make_escape_table() {
+            escape_table table{};
+            for (unsigned c = 0; c < 256; ++c) {
+                table.code[c] = c < 0x20 || c >= 0x7f ? 'u' : 0;
+            }
+            table.code[uint8_t('\b')] = 'b';
+            table.code[uint8_t('\f')] = 'f';
+            table.code[uint8_t('\n')] = 'n';
+            table.code[uint8_t('\r')] = 'r';
+            table.code[uint8_t('\t')] = 't';
+            table.code[uint8_t('\\')] = '\\';
+            table.code[uint8_t('/')] = '/';
+            table.code[uint8_t('"')] = '"';
+            return table;
+        }
+    }
+
+    /*
+     * Writes the types of a mapper as json straight into a string, members of a type are
+     * Mapper::members(type_tag<Type>) and enums Mapper::values(type_tag<Enum>) as for
+     * token_decoder.
+     *
+     * Output is byte for byte jsonv::to_string of jsonv::to_json with the equivalent formats :
+     * keys in std::map order, strings escaped to ascii the way jsonv escapes them, doubles
+     * as std::ostream prints them ( %g ), non finite doubles and enumerators without a json
+     * value as null. Doubles take a fixed point path where the 6 significant digits are not
+     * a rounding tie, snprintf otherwise.
+     */
+    template<typename Mapper>
+    class response_writer {
+    public:
+        explicit response_writer(std::string &out) : out{out}, cursor{}, last{}
+        {}
+
+        //appends the json of value, out is sized up front to the recent json sizes of the thread
+        template<typename Type>
+        void write(const Type &value) {
+            const std::size_t start = out.size();
+            out.resize(start + hint());
+            cursor = &out[start];
+            last = &out[0] + out.size();
+            write_value(value);
+            out.resize(cursor - &out[0]);
+            //a large response raises the hint at once, it decays by an eighth per smaller one
+            const std::size_t written = out.size() - start;
+            hint() = std::min(std::size_t{MAX_HINT}, std::max({std::size_t{MIN_HINT}, written, hint() - hint() / 8}));
+        }
+
+    private:
+        static constexpr std::size_t MIN_HINT = 256;
+        static constexpr std::size_t MAX_HINT = 65536; // larger json grows out as it is written
+
+        static std::size_t & hint() {
+            thread_local std::size_t size = MIN_HINT;
+            return size;
+        }
+
+        //cursor with at least size bytes after it
+        char * room(std::size_t size) {
+            if (std::size_t(last - cursor) < size) {
+                const std::size_t used = cursor - &out[0];
+                out.resize(std::max(2 * out.size(), used + size));
+                cursor = &out[used];
+                last = &out[0] + out.size();
+            }
+            return cursor;
+        }
+
+        void put(char c) {
+            *room(1) = c;
+            ++cursor;
+        }
+
+        void put(const char *text, std::size_t length) {
+            std::memcpy(room(length), text, length);
+            cursor += length;
+        }
+
+        void write_value(const std::string &value) {
+            write_string(value.data(), value.size());
+        }
+
+        void write_value(const jsonv::string_view &value) {
+            write_string(value.data(), value.size());
+        }
+
+        void write_value(bool value) {
+            value ? put("true", 4) : put("false", 5);
+        }
+
+        template<typename Number>
+        std::enable_if_t<std::is_integral<Number>::value> write_value(Number value) {
+            write_integer(static_cast<int64_t>(value));
+        }
+
+        template<typename Number>
+        std::enable_if_t<std::is_floating_point<Number>::value> write_value(Number value) {
+            write_decimal(static_cast<double>(value));
+        }
+
+        template<typename Enum>
+        std::enable_if_t<std::is_enum<Enum>::value> write_value(Enum value) {
+            static constexpr auto values = Mapper::values(type_tag<Enum>{});
+            for (const auto &candidate : values) {
+                if (candidate.value == value) {
+                    write_integer(candidate.json);
+                    return;
+                }
+            }
+            put("null", 4);
+        }
+
+        template<typename Value>
+        void write_value(const boost::optional<Value> &value) {
+            if (value) {
+                write_value(*value);
+            } else {
+                put("null", 4);
+            }
+        }
+
+        template<typename Value>
+        void write_value(const std::vector<Value> &values) {
+            put('[');
+            for (std::size_t i = 0; i < values.size(); ++i) {
+                if (i) {
+                    put(',');
+                }
+                write_value(values[i]);
+            }
+            put(']');
+        }
+
+        template<typename Class>
+        std::enable_if_t<has_members<Mapper, Class>::value> write_value(const Class &value) {
+            using fields_type = std::decay_t<decltype(Mapper::members(type_tag<Class>{}))>;
+            put('{');
+            write_members(value, std::make_index_sequence<std::tuple_size<fields_type>::value>{});
+            put('}');
+        }
+
+        template<typename Class, std::size_t ...I>
+        void write_members(const Class &value, std::index_sequence<I...>) {
+            static constexpr auto members = Mapper::members(type_tag<Class>{});
+            static constexpr auto order = detail::make_key_order(detail::key_names(members, std::index_sequence<I...>{}));
+            (void)std::initializer_list<int>{ (write_member(value, std::get<order.index[I]>(members), I == 0), 0)... };
+        }
+
+        template<typename Class, typename Member>
+        void write_member(const Class &value, const member_field<Class, Member> &member, bool first) {
+            if (!first) {
+                put(',');
+            }
+            write_string(member.name, member.length);
+            put(':');
+            write_value(value.*(member.pointer));
+        }
+
+        void write_integer(int64_t value) {
+            char digits[20];
+            char *first = digits + sizeof digits;
+            uint64_t magnitude = value < 0 ? 0 - uint64_t(value) : uint64_t(value);
+            do {
+                *--first = char('0' + magnitude % 10);
+                magnitude /= 10;
+            } while (magnitude);
+            if (value < 0) {
+                *--first = '-';
+            }
+            put(first, digits + sizeof digits - first);
+        }
+
+        void write_decimal(double value) {
+            static constexpr double powers[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9 };
+            if (!std::isfinite(value)) {
+                put("null", 4);
+                return;
+            }
+            const double magnitude = std::abs(value);
+            //%g keeps fixed point from 1e-4 up to 1e6, exponent of the leading digit picks the scale
+            int exponent = 5;
+            while (exponent >= -4 && magnitude < (exponent >= 0 ? powers[exponent] : 1.0 / powers[-exponent])) {
+                --exponent;
+            }
+            if (exponent < -4 || magnitude >= 1e6) {
+                return write_printf(value);
+            }
+            const double scaled = magnitude * powers[5 - exponent];
+            double whole = std::floor(scaled);
+            const double fraction = scaled - whole;
+            //scaled is off by half an ulp at most, far smaller than the distance to a tie
+            if (std::abs(fraction - 0.5) < 1e-6) {
+                return write_printf(value);
+            }
+            whole += fraction > 0.5 ? 1.0 : 0.0;
+            if (whole >= 1e6) {
+                return write_printf(value);
+            }
+            char digits[6];
+            uint32_t significant = uint32_t(whole);
+            for (int i = 5; i >= 0; --i) {
+                digits[i] = char('0' + significant % 10);
+                significant /= 10;
+            }
+            int length = 6;
+            const int integer_digits = exponent + 1;
+            while (length > std::max(integer_digits, 0) && digits[length - 1] == '0') {
+                --length;
+            }
+            char *first = room(16);
+            char *text = first;
+            if (std::signbit(value)) {
+                *text++ = '-';
+            }
+            if (integer_digits > 0) {
+                text = std::copy(digits, digits + integer_digits, text);
+                if (length > integer_digits) {
+                    *text++ = '.';
+                    text = std::copy(digits + integer_digits, digits + length, text);
+                }
+            } else {
+                *text++ = '0';
+                *text++ = '.';
+                text = std::fill_n(text, -integer_digits, '0');
+                text = std::copy(digits, digits + length, text);
+            }
+            cursor += text - first;
+        }
+
+        void write_printf(double value) {
+            char text[32];
+            const int length = std::snprintf(text, sizeof text, "%g", value);
+            put(text, length);
+        }
+
+        //no byte takes more than 6 escaped
+        void write_string(const char *value, std::size_t length) {
+            static constexpr detail::escape_table escapes = detail::make_escape_table();
+            char *text = room(6 * length + 2);
+            *text++ = '"';
+            for (std::size_t i = 0; i < length;) {
+                const char code = escapes.code[uint8_t(value[i])];
+                if (!code) {
+                    *text++ = value[i++];
+                } else if (code == 'u') {
+                    i += write_unicode(value + i, length - i, text);
+                } else {
+                    *text++ = '\\';
+                    *text++ = code;
+                    ++i;
+                }
+            }
+            *text++ = '"';
+            cursor = text;
+        }
+
+        //one code point as \u escapes, bytes that are no utf-8 escaped one by one as jsonv does
+        static std::size_t write_unicode(const char *value, std::size_t length, char *&text) {
+            const uint8_t lead = uint8_t(value[0]);
+            std::size_t size = 1;
+            uint32_t code = lead;
+            if (lead >= 0x80) {
+                uint8_t mask = 0;
+                for (std::size_t bits = 2; bits <= 6 && !mask; ++bits) {
+                    const uint8_t prefix = uint8_t(0xff << (8 - bits));
+                    if ((lead & prefix) == prefix && !(lead & (0x80 >> bits))) {
+                        size = bits;
+                        mask = uint8_t(0xff >> (bits + 1));
+                    }
+                }
+                code = lead & mask;
+                for (std::size_t i = 1; mask && i < size; ++i) {
+                    const uint8_t next = i < length ? uint8_t(value[i]) : 0;
+                    if ((next & 0xc0) != 0x80) {
+                        mask = 0;
+                        break;
+                    }
+                    code = (code << 6) | (next & 0x3f);
+                }
+                if (!mask) {
+                    size = 1;
+                    code = lead;
+                }
+            }
+            if (code < 0x10000) {
+                write_hex(uint16_t(code), text);
+            } else {
+                const uint32_t surrogate = code - 0x10000;
+                write_hex(uint16_t(surrogate >> 10) | 0xd800, text);
+                write_hex(uint16_t(surrogate & 0x03ff) | 0xdc00, text);
+            }
+            return size;
+        }
+
+        static void write_hex(uint16_t code, char *&text) {
+            static constexpr char hex[] = "0123456789abcdef";
+            *text++ = '\\';
+            *text++ = 'u';
+            *text++ = hex[code >> 12];
+            *text++ = hex[(code >> 8) & 0xf];
+            *text++ = hex[(code >> 4) & 0xf];
+            *text++ = hex[code & 0xf];
+        }
+
+        std::string &out;
+        char *cursor;
+        char *last;
+    };
+
+} //namespace
+
+#endif /* RTB_DSL_RESPONSE_WRITER_HPP */
@@ -0,0 +1,450 @@
+/*
+ * File:   token_decoder.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*/
+
+#ifndef RTB_DSL_TOKEN_DECODER_HPP
+#define RTB_DSL_TOKEN_DECODER_HPP
+
+#include "parsers/jsmn.h"
+#include "jsonv/string_view.hpp"
+#include <boost/optional.hpp>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace DSL {
+
+    template<typename Type>
+    struct type_tag {};
+
+    //json key of a mapped member
+    template<typename Class, typename Member>
+    struct member_field {
+        const char *name;
+        std::size_t length;
+        Member Class::*pointer;
+    };
+
+    template<typename Class, typename Member, std::size_t N>
+    constexpr member_field<Class, Member> field(const char (&name)[N], Member Class::*pointer) {
+        return {name, N - 1, pointer};
+    }
+
+    template<typename ...Fields>
+    constexpr std::tuple<Fields...> fields(Fields ...members) {
+        return std::tuple<Fields...>(members...);
+    }
+
+    //json number of an enumerator, see jsonv enum_type
+    template<typename Enum>
+    struct enum_value {
+        Enum value;
+        int64_t json;
+    };
+
+    template<typename Enum, typename ...Values>
+    constexpr std::array<enum_value<Enum>, sizeof...(Values)> enum_values(Values ...values) {
+        return {{ values... }};
+    }
+
+    namespace detail {
+        struct key_name {
+            const char *name;
+            std::size_t length;
+        };
+
+        constexpr uint32_t key_hash(const char *key, std::size_t length, uint32_t seed) {
+            uint32_t h = (seed ^ uint32_t(length)) * 0x9E3779B1u;
+            if (length) {
+                h = (h ^ uint8_t(key[0])) * 0x85EBCA6Bu;
+                h = (h ^ uint8_t(key[length / 2])) * 0xC2B2AE35u;
+                h = (h ^ uint8_t(key[length - 1])) * 0x27D4EB2Fu;
+            }
+            return h ^ (h >> 16);
+        }
+
+        constexpr std::size_t key_slots(std::size_t keys) {
+            std::size_t slots = 1;
+            while (slots < 2 * keys) {
+                slots <<= 1;
+            }
+            return slots;
+        }
+
+        //slot of key_hash(key, seed) holds index of the key, no two keys share a slot
+        template<std::size_t N>
+        struct key_table {
+            static constexpr std::size_t SLOTS = key_slots(N);
+            uint32_t seed;
+            int8_t index[SLOTS];
+
+            constexpr int8_t find(const char *key, std::size_t length) const {
+                return index[key_hash(key, length, seed) & (SLOTS - 1)];
+            }
+        };
+
+        //smallest seed giving a perfect hash, found by the compiler
+        template<std::size_t N>
+        constexpr key_table<N> make_key_table(const std::array<key_name, N> &keys) {
+            for (uint32_t seed = 0; seed < 65536; ++seed) {
+                key_table<N> table{seed, {}};
+                for (std::size_t slot = 0; slot < key_table<N>::SLOTS; ++slot) {
+                    table.index[slot] = -1;
+                }
+                bool perfect = true;
+                for (std::size_t i = 0; i < N && perfect; ++i) {
+                    int8_t &slot = table.index[key_hash(keys[i].name, keys[i].length, seed) & (key_table<N>::SLOTS - 1)];
+                    perfect = slot < 0;
+                    slot = int8_t(i);
+                }
+                if (perfect) {
+                    return table;
+                }
+            }
+            throw std::logic_error("no perfect hash for member names");
+        }
+
+        template<typename Fields, std::size_t ...I>
+        constexpr std::array<key_name, sizeof...(I)> key_names(const Fields &members, std::index_sequence<I...>) {
+            return {{ key_name{std::get<I>(members).name, std::get<I>(members).length}... }};
+        }
+    }
+
+    template<typename Mapper, typename Type, typename = void>
+    struct has_members : std::false_type {};
+
+    template<typename Mapper, typename Type>
+    struct has_members<Mapper, Type, decltype(Mapper::members(type_tag<Type>{}), void())> : std::true_type {};
+
+    //levels of json containers the members of Type reach, deeper ones are never decoded
+    template<typename Mapper, typename Type, typename = void>
+    struct nesting : std::integral_constant<unsigned, 0> {};
+
+    template<typename Mapper, typename Value>
+    struct nesting<Mapper, boost::optional<Value>> : nesting<Mapper, Value> {};
+
+    template<typename Mapper, typename Value>
+    struct nesting<Mapper, std::vector<Value>> : std::integral_constant<unsigned, 1 + nesting<Mapper, Value>::value> {};
+
+    namespace detail {
+        constexpr unsigned deepest(std::initializer_list<unsigned> levels) {
+            unsigned level = 0;
+            for (const unsigned l : levels) {
+                level = l > level ? l : level;
+            }
+            return level;
+        }
+
+        template<typename Mapper, typename Fields>
+        struct fields_nesting;
+
+        template<typename Mapper, typename ...Classes, typename ...Members>
+        struct fields_nesting<Mapper, std::tuple<member_field<Classes, Members>...>> :
+            std::integral_constant<unsigned, deepest({0u, nesting<Mapper, Members>::value...})> {};
+    }
+
+    template<typename Mapper, typename Type>
+    struct nesting<Mapper, Type, std::enable_if_t<has_members<Mapper, Type>::value>> :
+        std::integral_constant<unsigned, 1 + detail::fields_nesting<Mapper, std::decay_t<decltype(Mapper::members(type_tag<Type>{}))>>::value> {};
+
+    /*
+     * Decodes jsmn tokens straight into the types of a mapper, members of a type are
+     * Mapper::members(type_tag<Type>) built with fields(field("key", &Type::member)...) and
+     * enums are Mapper::values(type_tag<Enum>). Keys are dispatched through a perfect hash
+     * computed at compile time, numbers are parsed in place.
+     *
+     * For well formed json the result is the same as jsonv extraction of encoders::encode
+     * with the equivalent formats : keys and strings are raw bytes, the first of duplicate keys
+     * wins, integers don't take decimals, enums take numbers equal to their value, and any
+     * primitive encode would not convert throws even where no member reads it. Containers
+     * deeper than nesting<Mapper, Type> may come as single tokens of size 0 ( see
+     * parsers::structural_scanner ) and are skipped unchecked. Members absent from the json are
+     * left value initialized. With T = jsonv::string_view strings point into the json itself.
+     */
+    template<typename Mapper>
+    class token_decoder {
+    public:
+        token_decoder(const char *json, const jsmntok_t *tokens, int count) :
+            json{json}, tokens{tokens}, count{count}, next{}
+        {}
+
+        template<typename Type>
+        void decode(Type &out) {
+            decode_value(out);
+        }
+
+    private:
+        enum class number_kind { INTEGER, DECIMAL, BOOLEAN };
+
+        struct primitive {
+            number_kind kind;
+            int64_t integer;
+            double decimal;
+            bool boolean;
+        };
+
+        [[noreturn]] static void fail(const char *what) {
+            throw std::runtime_error(std::string("DSL::token_decoder ") + what);
+        }
+
+        const jsmntok_t & take() {
+            if (next >= count) {
+                fail("ran out of tokens");
+            }
+            return tokens[next++];
+        }
+
+        const jsmntok_t & take(jsmntype_t type) {
+            const jsmntok_t &token = take();
+            if (token.type != type) {
+                fail("unexpected json type");
+            }
+            return token;
+        }
+
+        primitive take_primitive() {
+            return parse(take(JSMN_PRIMITIVE));
+        }
+
+        void decode_value(std::string &out) {
+            const jsmntok_t &token = take(JSMN_STRING);
+            out.assign(json + token.start, token.end - token.start);
+        }
+
+        void decode_value(jsonv::string_view &out) {
+            const jsmntok_t &token = take(JSMN_STRING);
+            out = jsonv::string_view(json + token.start, token.end - token.start);
+        }
+
+        void decode_value(bool &out) {
+            const primitive value = take_primitive();
+            if (value.kind != number_kind::BOOLEAN) {
+                fail("boolean expected");
+            }
+            out = value.boolean;
+        }
+
+        template<typename Number>
+        std::enable_if_t<std::is_integral<Number>::value> decode_value(Number &out) {
+            const primitive value = take_primitive();
+            if (value.kind != number_kind::INTEGER) {
+                fail("integer expected");
+            }
+            out = static_cast<Number>(value.integer);
+        }
+
+        template<typename Number>
+        std::enable_if_t<std::is_floating_point<Number>::value> decode_value(Number &out) {
+            const primitive value = take_primitive();
+            if (value.kind == number_kind::BOOLEAN) {
+                fail("number expected");
+            }
+            out = static_cast<Number>(value.kind == number_kind::INTEGER ? double(value.integer) : value.decimal);
+        }
+
+        template<typename Enum>
+        std::enable_if_t<std::is_enum<Enum>::value> decode_value(Enum &out) {
+            static constexpr auto values = Mapper::values(type_tag<Enum>{});
+            const jsmntok_t &token = take();
+            if (token.type == JSMN_PRIMITIVE) {
+                const primitive value = parse(token);
+                for (const auto &candidate : values) {
+                    if (value.kind == number_kind::INTEGER ? value.integer == candidate.json :
+                        value.kind == number_kind::DECIMAL && std::abs(value.decimal - double(candidate.json)) < std::numeric_limits<double>::denorm_min() * 10.0) {
+                        out = candidate.value;
+                        return;
+                    }
+                }
+            } else if (token.type != JSMN_STRING) {
+                skip_children(token);
+            }
+            fail("invalid enum value");
+        }
+
+        template<typename Value>
+        void decode_value(boost::optional<Value> &out) {
+            out = Value();
+            decode_value(*out);
+        }
+
+        template<typename Value>
+        void decode_value(std::vector<Value> &out) {
+            const jsmntok_t &array = take(JSMN_ARRAY);
+            out.clear();
+            out.reserve(array.size);
+            for (int i = 0; i < array.size; ++i) {
+                out.emplace_back();
+                decode_value(out.back());
+            }
+        }
+
+        template<typename Class>
+        std::enable_if_t<has_members<Mapper, Class>::value> decode_value(Class &out) {
+            static constexpr auto members = Mapper::members(type_tag<Class>{});
+            using fields_type = std::decay_t<decltype(members)>;
+            using indices = std::make_index_sequence<std::tuple_size<fields_type>::value>;
+            static constexpr auto keys = detail::key_names(members, indices{});
+            static constexpr auto table = detail::make_key_table(keys);
+            static_assert(std::tuple_size<fields_type>::value <= 64, "members are tracked in a 64 bit mask");
+
+            const jsmntok_t &object = take(JSMN_OBJECT);
+            uint64_t seen{};
+            for (int i = 0; i < object.size; ++i) {
+                const jsmntok_t &key = take(JSMN_STRING);
+                const char *name = json + key.start;
+                const std::size_t length = key.end - key.start;
+                const int8_t index = table.find(name, length);
+                if (index >= 0 && !(seen & (uint64_t(1) << index)) &&
+                    keys[index].length == length && std::memcmp(keys[index].name, name, length) == 0) {
+                    seen |= uint64_t(1) << index;
+                    decode_member(index, out, members, indices{});
+                } else {
+                    skip();
+                }
+            }
+        }
+
+        template<typename Class, typename Fields, std::size_t ...I>
+        void decode_member(std::size_t index, Class &out, const Fields &members, std::index_sequence<I...>) {
+            using member_decoder = void (token_decoder::*)(Class &, const Fields &);
+            static constexpr member_decoder decoders[] = { &token_decoder::template decode_field<I, Class, Fields>... };
+            (this->*decoders[index])(out, members);
+        }
+
+        template<typename Class, typename Fields>
+        void decode_member(std::size_t, Class &, const Fields &, std::index_sequence<>) {}
+
+        template<std::size_t I, typename Class, typename Fields>
+        void decode_field(Class &out, const Fields &members) {
+            decode_value(out.*(std::get<I>(members).pointer));
+        }
+
+        //value nobody reads, checked the way encoders::encode would convert it
+        void skip() {
+            const jsmntok_t &token = take();
+            if (token.type == JSMN_PRIMITIVE) {
+                parse(token);
+            } else {
+                skip_children(token);
+            }
+        }
+
+        void skip_children(const jsmntok_t &token) {
+            if (token.type == JSMN_OBJECT) {
+                for (int i = 0; i < token.size; ++i) {
+                    take(JSMN_STRING);
+                    skip();
+                }
+            } else if (token.type == JSMN_ARRAY) {
+                for (int i = 0; i < token.size; ++i) {
+                    skip();
+                }
+            } else if (token.type != JSMN_STRING) {
+                fail("undefined token");
+            }
+        }
+
+        //same classification as encoders::encode
+        primitive parse(const jsmntok_t &token) const {
+            const char *first = json + token.start;
+            const char *last = json + token.end;
+            primitive value{number_kind::INTEGER, 0, 0.0, false};
+            if (first == last) {
+                fail("empty primitive");
+            }
+            if (std::memchr(first, '.', last - first)) {
+                value.kind = number_kind::DECIMAL;
+                if (!parse_decimal(first, last, value.decimal)) {
+                    fail("invalid decimal");
+                }
+            } else if (*first == '-') {
+                uint64_t magnitude;
+                if (!parse_digits(first + 1, last, magnitude) || magnitude > uint64_t(std::numeric_limits<int64_t>::max()) + 1) {
+                    fail("invalid integer");
+                }
+                value.integer = static_cast<int64_t>(0 - magnitude);
+            } else if (*first == 't' || *first == 'f') {
+                value.kind = number_kind::BOOLEAN;
+                value.boolean = *first == 't';
+            } else {
+                uint64_t number;
+                if (!parse_digits(*first == '+' ? first + 1 : first, last, number)) {
+                    fail("invalid integer");
+                }
+                value.integer = static_cast<int64_t>(number);
+            }
+            return value;
+        }
+
+        static bool parse_digits(const char *first, const char *last, uint64_t &value) {
+            if (first == last) {
+                return false;
+            }
+            value = 0;
+            for (; first != last; ++first) {
+                const unsigned digit = unsigned(*first) - '0';
+                if (digit > 9 || value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+                    return false;
+                }
+                value = value * 10 + digit;
+            }
+            return true;
+        }
+
+        //what boost::lexical_cast<double> takes : the whole text as a finite number
+        static bool parse_decimal(const char *first, const char *last, double &value) {
+            const std::size_t length = last - first;
+            for (const char *c = first; c != last; ++c) {
+                if (!std::strchr("0123456789.eE+-", *c) || !*c) {
+                    return false;
+                }
+            }
+            if (std::strchr("eE+-", last[-1])) {
+                return false;
+            }
+            char buffer[64];
+            std::string long_text;
+            const char *text = buffer;
+            if (length < sizeof(buffer)) {
+                std::memcpy(buffer, first, length);
+                buffer[length] = '\0';
+            } else {
+                long_text.assign(first, length);
+                text = long_text.c_str();
+            }
+            char *end;
+            value = std::strtod(text, &end);
+            return end == text + length && std::isfinite(value);
+        }
+
+        const char *json;
+        const jsmntok_t *tokens;
+        int count;
+        int next;
+    };
+
+} //namespace
+
+#endif /* RTB_DSL_TOKEN_DECODER_HPP */
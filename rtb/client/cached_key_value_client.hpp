@@ -0,0 +1,88 @@
+/*
+ * File:   cached_key_value_client.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef CACHED_KEY_VALUE_CLIENT_HPP
+#define CACHED_KEY_VALUE_CLIENT_HPP
+
+#include <string>
+#include <cstdint>
+#include "rtb/datacache/lru_cache.hpp"
+
+namespace vanilla {
+    namespace client {
+        /*
+         * Key value client looking keys up in a shared datacache::lru_cache first,
+         * Client is asked only on a miss and what it returns is put into the cache.
+         * Same interface as the wrapped client so it can replace it in place.
+         * Empty values ( unknown user or failed request ) are not cached.
+         * Only worth it in front of a storage client returning data, the empty clients never do.
+         */
+        template <typename Client, typename Cache = datacache::lru_cache<>>
+        class cached_key_value_client {
+        public:
+            using self_type = cached_key_value_client;
+            using response_handler_type = typename Client::response_handler_type;
+
+            cached_key_value_client(Cache &cache) :
+                cache{cache}, client{}, response_handler{}
+            {
+                client.response([](auto && ...) {}); // response is delivered by this wrapper
+            }
+
+            self_type &response(const response_handler_type &handler) {
+                response_handler = handler;
+                return *this;
+            }
+
+            void request(const std::string &key, std::string &data) {
+                if (!cache.get(key, data)) {
+                    client.request(key, data);
+                    if (!data.empty()) {
+                        cache.put(key, data);
+                    }
+                }
+                if (response_handler) {
+                    respond(response_handler, data, 0);
+                }
+            }
+
+            void connect(const std::string &host, uint16_t port) {
+                client.connect(host, port);
+            }
+
+            bool connected() const {
+                return client.connected();
+            }
+
+        private:
+            //handlers of the wrapped clients either take the value or nothing
+            template<typename Handler>
+            static auto respond(Handler &handler, const std::string &data, int) -> decltype(handler(data), void()) {
+                handler(data);
+            }
+            template<typename Handler>
+            static void respond(Handler &handler, const std::string &, long) {
+                handler();
+            }
+
+            Cache &cache;
+            Client client;
+            response_handler_type response_handler;
+        };
+    }
+}
+
+#endif /* CACHED_KEY_VALUE_CLIENT_HPP */
@@ -102,6 +102,12 @@ namespace vanilla { namespace config {
             else if (auto v = boost::any_cast<int>(&value)) {
                 s << *v << std::endl;
             }
+            else if (auto v = boost::any_cast<unsigned long>(&value)) {
+                s << *v << std::endl;
+            }
+            else if (auto v = boost::any_cast<bool>(&value)) {
+                s << std::boolalpha << *v << std::noboolalpha << std::endl;
+            }
             else if (auto v = boost::any_cast<std::string>(&value)) {
                 s << *v << std::endl;
             }
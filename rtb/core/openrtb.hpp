@@ -401,6 +401,12 @@ namespace openrtb {
         const request_type& request() const {
             return *this;
         }
+
+        //member access shared with DSL::lazy_request
+        template<typename Member>
+        const Member& get(Member request_type::*member) const {
+            return this->*member;
+        }
     };
 
 
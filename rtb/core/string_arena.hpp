@@ -0,0 +1,118 @@
+/*
+ * File:   string_arena.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef STRING_ARENA_HPP
+#define STRING_ARENA_HPP
+
+#include <cstddef>
+#include <deque>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "jsonv/string_view.hpp"
+
+namespace vanilla {
+
+/*
+ * Owner of the characters string_view typed requests and responses point to when they
+ * don't come straight from the request body ( deserialized from a datagram, generated by
+ * the bidder ). Strings stay where they are until clear(), which keeps their buffers for
+ * the next request so a warmed up arena doesn't allocate.
+ *
+ * Whoever owns a request for its whole life installs a scope over its arena : exchange_handler
+ * for an auction, messaging::communicator for one inbound message and its response. Loading
+ * a string_view outside of any scope is an error rather than a dangling view.
+ */
+class string_arena {
+public:
+    class scope {
+    public:
+        explicit scope(string_arena &arena) : previous{installed()} {
+            installed() = &arena;
+        }
+        ~scope() {
+            installed() = previous;
+        }
+        scope(const scope &) = delete;
+        scope & operator=(const scope &) = delete;
+    private:
+        string_arena *previous;
+    };
+
+    string_arena() : used{} {}
+    string_arena(const string_arena &) = delete;
+    string_arena & operator=(const string_arena &) = delete;
+
+    //arena of the innermost scope of this thread
+    static string_arena & current() {
+        if (!installed()) {
+            throw std::logic_error("string_view loaded outside of a string_arena::scope");
+        }
+        return *installed();
+    }
+
+    //n characters to fill in, valid until clear()
+    std::string & allocate(std::size_t n) {
+        if (used == strings.size()) {
+            strings.emplace_back();
+        }
+        std::string &value = strings[used++];
+        value.assign(n, '\0');
+        return value;
+    }
+
+    jsonv::string_view store(const char *data, std::size_t n) {
+        return allocate(n).assign(data, n);
+    }
+
+    //value as T, a string_view T points into the arena
+    template<typename T>
+    T keep(std::string &&value) {
+        return keep(std::move(value), static_cast<T*>(nullptr));
+    }
+
+    string_arena & clear() {
+        used = 0;
+        return *this;
+    }
+
+    std::size_t size() const {
+        return used;
+    }
+
+private:
+    static string_arena *& installed() {
+        thread_local string_arena *arena{};
+        return arena;
+    }
+
+    std::string keep(std::string &&value, std::string*) {
+        return std::move(value);
+    }
+    jsonv::string_view keep(std::string &&value, jsonv::string_view*) {
+        std::string &kept = allocate(0);
+        kept.swap(value);
+        return kept;
+    }
+
+    std::deque<std::string> strings; // deque never moves its elements
+    std::size_t used;
+};
+
+}
+
+#endif /* STRING_ARENA_HPP */
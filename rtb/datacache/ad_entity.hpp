@@ -15,6 +15,7 @@
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
 #include <boost/archive/binary_oarchive.hpp>
   
@@ -58,21 +59,18 @@ namespace ipc { namespace data {
         }
         
         template<typename Serializable>
-        static std::size_t size(const Serializable && data) {
-            std::stringstream ss;
-            boost::archive::binary_oarchive oarch(ss);
-            oarch << std::forward<Serializable>(data) ;
-            return base_type::size(std::forward<Serializable>(data)) +                
-                   sizeof(data.campaign_id) +
-                   sizeof(data.width) +
-                   sizeof(data.height) +                
-                   sizeof(data.ad_id) +
-                   ss.str().size() ;
+        static std::size_t size(const Serializable & data) {
+            return base_type::size(data) ;
         }
         template<typename Serializable>
         void retrieve(Serializable  & data) const {
             base_type::template retrieve(data) ;
         }
+        //blob has to be deserialized as a whole
+        template<typename Serializable>
+        void retrieve_hot(Serializable  & data) const {
+            retrieve(data) ;
+        }
         //needed for ability to update after matching by calling index.modify(itr,entry)
         void operator()(ad_entity &entry) const {
             base_entity<Alloc>::operator()(static_cast<base_type &>(entry));            
@@ -107,6 +105,34 @@ boost::multi_index_container<
     >,
     boost::interprocess::allocator<ad_entity<Alloc>,typename Alloc::segment_manager>
 > ;
+
+//hashed variant, O(1) lookup on campaign-width-height, the second index only keeps ads unique
+template<typename Alloc>
+using ad_hashed_container =
+boost::multi_index_container<
+    ad_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename ad_entity<Alloc>::campaign_size_tag>,
+            boost::multi_index::composite_key<
+                ad_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint32_t,campaign_id),
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint16_t,height)
+            >
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+                ad_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint32_t,campaign_id),
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint16_t,height),
+                BOOST_MULTI_INDEX_MEMBER(ad_entity<Alloc>,uint64_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<ad_entity<Alloc>,typename Alloc::segment_manager>
+> ;
   
     
 }}
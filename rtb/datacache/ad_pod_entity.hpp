@@ -0,0 +1,168 @@
+/*
+ * File:   ad_pod_entity.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __IPC_DATA_AD_POD_ENTITY_HPP__
+#define __IPC_DATA_AD_POD_ENTITY_HPP__
+
+#include "rtb/datacache/arena.hpp"
+#include <cstdint>
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+
+namespace ipc { namespace data {
+
+    /*
+     * Ad stored with a fixed layout instead of an archive blob : fields the selector
+     * compares are plain members of the index node and the creative code lives in the
+     * segment string_arena. retrieve_hot() copies only the fixed fields so choosing
+     * among hundreds of candidates never touches the code, retrieve() copies everything.
+     */
+    template <typename Alloc>
+    struct ad_pod_entity {
+        using arena_t = datacache::string_arena<typename Alloc::segment_manager>;
+
+        //for tagging in multi_index_container
+        struct ad_id_tag {}; // search on ad_id
+        struct campaign_tag{}; // search on campaign
+        struct campaign_size_tag {}; // search on campaign-width-height
+        struct width_tag {}; // search on width
+        struct height_tag {}; // search on height
+
+        ad_pod_entity( const Alloc & a ) :
+            allocator{a},
+            ad_id{},
+            max_bid_micros{},
+            campaign_id{},
+            width{},
+            height{},
+            position{},
+            code{}
+        {} //ctor END
+
+        Alloc allocator;
+        uint64_t ad_id;
+        uint64_t max_bid_micros;
+        uint32_t campaign_id;
+        uint16_t width;
+        uint16_t height;
+        uint16_t position;
+        datacache::arena_string code;
+
+        template<typename Key, typename Serializable>
+        void store(Key && key, Serializable  && data)  {
+            campaign_id = key.template get<campaign_tag>();
+            width = key.template get<width_tag>();
+            height = key.template get<height_tag>();
+            ad_id = key.template get<ad_id_tag>();
+            position = data.position;
+            max_bid_micros = data.max_bid_micros;
+            code = arena_t::instance(allocator.get_segment_manager()).store(data.code);
+        }
+
+        //index members only, finds the record a delta removes without storing its code
+        template<typename Key, typename Serializable>
+        void store_key(Key && key, Serializable  &&)  {
+            campaign_id = key.template get<campaign_tag>();
+            width = key.template get<width_tag>();
+            height = key.template get<height_tag>();
+            ad_id = key.template get<ad_id_tag>();
+        }
+
+        template<typename Serializable>
+        static std::size_t size(const Serializable & data) {
+            return data.code.size() ;
+        }
+        template<typename Serializable>
+        void retrieve(Serializable  & data) const {
+            retrieve_hot(data);
+            data.code = code.str();
+        }
+        template<typename Serializable>
+        void retrieve_hot(Serializable  & data) const {
+            data.ad_id = ad_id;
+            data.campaign_id = campaign_id;
+            data.width = width;
+            data.height = height;
+            data.position = position;
+            data.max_bid_micros = max_bid_micros;
+        }
+        //needed for ability to update after matching by calling index.modify(itr,entry)
+        void operator()(ad_pod_entity &entry) const {
+            entry.ad_id = ad_id;
+            entry.max_bid_micros = max_bid_micros;
+            entry.campaign_id = campaign_id;
+            entry.width = width;
+            entry.height = height;
+            entry.position = position;
+            entry.code = code;
+        }
+    };
+
+template<typename Alloc>
+using ad_pod_container =
+boost::multi_index_container<
+    ad_pod_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::ordered_unique<
+            boost::multi_index::tag<typename ad_pod_entity<Alloc>::campaign_size_tag>,
+            boost::multi_index::composite_key<
+                ad_pod_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint32_t,campaign_id),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,height),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint64_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<ad_pod_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+//hashed variant, O(1) lookup on campaign-width-height, the second index only keeps ads unique
+template<typename Alloc>
+using ad_pod_hashed_container =
+boost::multi_index_container<
+    ad_pod_entity<Alloc>,
+    boost::multi_index::indexed_by<
+        boost::multi_index::hashed_non_unique<
+            boost::multi_index::tag<typename ad_pod_entity<Alloc>::campaign_size_tag>,
+            boost::multi_index::composite_key<
+                ad_pod_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint32_t,campaign_id),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,height)
+            >
+        >,
+        boost::multi_index::hashed_unique<
+            boost::multi_index::composite_key<
+                ad_pod_entity<Alloc>,
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint32_t,campaign_id),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,width),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint16_t,height),
+                BOOST_MULTI_INDEX_MEMBER(ad_pod_entity<Alloc>,uint64_t,ad_id)
+            >
+        >
+    >,
+    boost::interprocess::allocator<ad_pod_entity<Alloc>,typename Alloc::segment_manager>
+> ;
+
+}}
+
+#endif /* __IPC_DATA_AD_POD_ENTITY_HPP__ */
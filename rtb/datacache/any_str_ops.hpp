@@ -27,6 +27,8 @@ namespace boost {
 #include <boost/utility/string_view.hpp>
 #endif
 
+#include <boost/functional/hash.hpp>
+#include <functional>
 #include <string>
 
 namespace ufw {
@@ -35,14 +37,8 @@ namespace ufw {
      * Functor for containers transparent across `std::string`,
      * `boost::container::string`, `boost::string_view`, and `char const*`.
      */
-    template<typename Alloc, typename Op>
-    struct any_str_op {
-        template <typename X, typename Y>
-        bool operator () (X&& l, Y&& r) const { return op_(view(l), view(r)); }
-
-    private:
-        Op op_;
-
+    template<typename Alloc>
+    struct any_str_view {
         using char_t = char;
         using char_traits_t = std::char_traits<char_t>;
         using shm_str_t = typename boost::container::basic_string<char_t, char_traits_t, Alloc>;
@@ -55,7 +51,32 @@ namespace ufw {
         static str_view_t view(str_view_t x) { return x; }
     };
 
+    template<typename Alloc, typename Op>
+    struct any_str_op : private any_str_view<Alloc> {
+        template <typename X, typename Y>
+        bool operator () (X&& l, Y&& r) const { return op_(this->view(l), this->view(r)); }
+
+    private:
+        Op op_;
+    };
+
+    /**
+     * Hash functor for hashed indices, any of the above string types
+     * with the same characters produce the same hash.
+     */
+    template<typename Alloc>
+    struct any_str_hash : private any_str_view<Alloc> {
+        template <typename X>
+        std::size_t operator () (X&& x) const {
+            auto v = this->view(x);
+            return boost::hash_range(v.begin(), v.end());
+        }
+    };
+
     template <typename Alloc>
     using any_str_less = any_str_op<Alloc, std::less<void>>;
 
+    template <typename Alloc>
+    using any_str_equal = any_str_op<Alloc, std::equal_to<void>>;
+
 } // namespace ufw
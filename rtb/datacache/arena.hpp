@@ -0,0 +1,120 @@
+/*
+ * File:   arena.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_ARENA_HPP__
+#define __DATACACHE_ARENA_HPP__
+
+#include <boost/interprocess/offset_ptr.hpp>
+#include <boost/interprocess/segment_manager.hpp>
+#if BOOST_VERSION <= 106000
+#include <boost/utility/string_ref.hpp>
+namespace boost {
+    using string_view = string_ref;
+}
+#else
+#include <boost/utility/string_view.hpp>
+#endif
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+
+namespace datacache {
+
+/*
+ * Variable length value kept out of the entity in a string_arena of the same segment.
+ * The entity only holds this fixed size handle so index nodes stay small and
+ * the bytes are touched only when somebody reads them.
+ */
+class arena_string {
+public:
+    arena_string() : _data(), _size() {}
+    arena_string(const char *data, std::size_t size) : _data(data), _size(size) {}
+
+    const char * data() const { return _data.get(); }
+    std::size_t size() const { return _size; }
+    bool empty() const { return !_size; }
+    boost::string_view view() const { return {data(), size()}; }
+    std::string str() const { return std::string(data(), size()); }
+private:
+    boost::interprocess::offset_ptr<const char> _data;
+    std::size_t _size;
+};
+
+/*
+ * Append only storage for arena_string values, one per segment.
+ * Strings are copied into CHUNK_SIZE blocks allocated from the segment, space of
+ * updated or removed values is given back only when the whole segment is dropped
+ * ( next full reload ). Callers serialize stores with the cache writer lock.
+ */
+template<typename SegmentManager>
+class string_arena {
+public:
+    static constexpr std::size_t CHUNK_SIZE = 65536 ;
+
+    explicit string_arena(SegmentManager *segment_manager) :
+        _segment_manager(segment_manager), _chunk(), _used(), _capacity()
+    {}
+
+    static string_arena & instance(SegmentManager *segment_manager) {
+        return *segment_manager->template find_or_construct<string_arena>(boost::interprocess::unique_instance)(segment_manager);
+    }
+
+    arena_string store(const char *data, std::size_t size) {
+        return arena_string(copy(data, size, 1), size) ;
+    }
+
+    template<typename String>
+    arena_string store(const String &value) {
+        return store(value.data(), value.size()) ;
+    }
+
+    //contiguous copy of count trivially copyable T aligned for T, the caller keeps it in an offset_ptr
+    template<typename T>
+    const T * store_array(const T *data, std::size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "string_arena stores trivially copyable types only");
+        return reinterpret_cast<const T *>(copy(data, count * sizeof(T), alignof(T))) ;
+    }
+private:
+    //segment allocations are aligned at least for any fundamental type, so only _used needs rounding
+    const char * copy(const void *data, std::size_t size, std::size_t alignment) {
+        const std::size_t used = (_used + alignment - 1) / alignment * alignment ;
+        if ( _capacity < used || _capacity - used < size ) {
+            const std::size_t capacity = size > CHUNK_SIZE ? size : CHUNK_SIZE ;
+            _chunk = static_cast<char *>(_segment_manager->allocate(capacity)) ;
+            _used = 0 ;
+            _capacity = capacity ;
+        } else {
+            _used = used ;
+        }
+        char *p = _chunk.get() + _used ;
+        if ( size ) {
+            std::memcpy(p, data, size) ;
+        }
+        _used += size ;
+        return p ;
+    }
+
+    boost::interprocess::offset_ptr<SegmentManager> _segment_manager;
+    boost::interprocess::offset_ptr<char> _chunk;
+    std::size_t _used;
+    std::size_t _capacity;
+};
+
+}
+
+#endif /* __DATACACHE_ARENA_HPP__ */
@@ -55,12 +55,13 @@ namespace ipc { namespace data {
             oarch << std::forward<Serializable>(data) ;
         }
 
+        //bytes the entity allocates in the segment for data, used to pre-size bulk loads
         template<typename Serializable>
-        static std::size_t size(const Serializable && data) {
+        static std::size_t size(const Serializable & data) {
             std::stringstream ss;
             oarchive_t oarch(ss);
-            oarch << std::forward<Serializable>(data) ;
-            return sizeof(data.allocator) + ss.str().size() ;
+            oarch << data ;
+            return ss.str().size() ;
         }
 
         template<typename Serializable>
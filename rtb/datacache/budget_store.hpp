@@ -0,0 +1,338 @@
+/*
+ * File:   budget_store.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_BUDGET_STORE_HPP__
+#define __DATACACHE_BUDGET_STORE_HPP__
+
+#include "rtb/datacache/memory_types.hpp"
+#include <boost/scoped_ptr.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace datacache {
+
+//copy of one budget record, amounts are micro dollars
+struct budget_snapshot {
+    uint32_t campaign_id{};
+    uint64_t limit{};      // left to spend
+    uint64_t spent{};
+    uint64_t overdraft{};  // won above the limit
+    uint64_t leased{};     // handed out by lease() or held from credit()
+
+    friend std::ostream &operator<<(std::ostream &os, const budget_snapshot &value) {
+        return os << value.campaign_id << "|" << value.limit << "|" << value.spent << "|" << value.overdraft << "|" << value.leased;
+    }
+};
+
+/*
+ * Slot of the budget table, a cache line each so spends on neighbouring campaigns
+ * don't bounce the same line between cores, the table is allocated on a cache line
+ * boundary for that. campaign_id is claimed once and never cleared, removed campaigns
+ * keep their slot with active unset.
+ */
+struct alignas(64) budget_record {
+    std::atomic<uint32_t> campaign_id{0};
+    std::atomic<uint32_t> active{0};
+    std::atomic<uint64_t> limit{0};
+    std::atomic<uint64_t> spent{0};
+    std::atomic<uint64_t> overdraft{0};
+    std::atomic<uint64_t> leased{0};
+    std::atomic<uint64_t> version{0}; // of the last versioned assign()
+};
+
+/*
+ * Campaign budgets in a named segment as an open addressing table of budget_record keyed
+ * by campaign_id ( 0 is never a valid id ). Records are claimed with a CAS on campaign_id
+ * and every amount is a std::atomic updated with fetch_add / compare_exchange, so spends,
+ * lookups and assignments from any process attached to the segment take no lock and don't
+ * serialize anything. Fields of a record are individually atomic, a reader racing with
+ * assign() may see the new limit next to the old spent. Capacity is fixed when the segment
+ * is created, rounded up to a power of two; attaching processes use whatever it was.
+ *
+ * The same table serves both ends of budget leasing : the owner of a campaign budget
+ * hands chunks of its limit out with lease() and takes them back with settle(), a lessee
+ * ( one bidder node ) adds granted chunks to its own limit with credit(), spends them
+ * locally and reports what it spent with drain().
+ */
+template<typename Memory = mpclmi::ipc::Shared>
+class budget_store {
+    using segment_t = typename Memory::segment_t ;
+    static_assert(sizeof(budget_record) == 64 && alignof(budget_record) == 64, "budget_record is one cache line");
+
+    //named objects get the default alignment only, records are allocated apart and found by handle
+    struct budget_table {
+        std::size_t capacity;
+        typename segment_t::handle_t records;
+    };
+public:
+    static constexpr std::size_t DEFAULT_CAPACITY = 65536 ;
+
+    explicit budget_store(const std::string &name, std::size_t capacity = DEFAULT_CAPACITY) :
+        _segment(Memory::open_or_create_segment(Memory::convert_base_dir(mpclmi::ipc::base_dir()) + name, segment_size(round_up(capacity)))),
+        _records{},
+        _mask{}
+    {
+        budget_table *table{};
+        //processes attaching at the same time see the table with its records or none
+        auto find_or_construct = [&]() {
+            table = _segment->template find<budget_table>("budget_table").first;
+            if ( table ) {
+                return;
+            }
+            const std::size_t size = round_up(capacity);
+            auto *records = static_cast<budget_record *>(_segment->allocate_aligned(size * sizeof(budget_record), alignof(budget_record)));
+            for ( std::size_t slot = 0 ; slot < size ; ++slot ) {
+                new (records + slot) budget_record();
+            }
+            table = _segment->template construct<budget_table>("budget_table")(budget_table{size, _segment->get_handle_from_address(records)});
+        };
+        _segment->atomic_func(find_or_construct);
+        _records = static_cast<budget_record *>(_segment->get_address_from_handle(table->records));
+        _mask = table->capacity - 1;
+    }
+
+    //claims a record for campaign_id if needed and sets all of its amounts
+    void assign(uint32_t campaign_id, uint64_t limit, uint64_t spent, uint64_t overdraft) {
+        budget_record &record = claim(campaign_id);
+        record.limit.store(limit, std::memory_order_relaxed);
+        record.spent.store(spent, std::memory_order_relaxed);
+        record.overdraft.store(overdraft, std::memory_order_relaxed);
+        record.active.store(1, std::memory_order_release);
+    }
+
+    /*
+     * assign() of amounts sent by another store, version orders the copies of one campaign.
+     * A copy not newer than the last one assigned is dropped and false returned, copies of
+     * a campaign are assigned by one thread.
+     */
+    bool assign(uint32_t campaign_id, uint64_t version, uint64_t limit, uint64_t spent, uint64_t overdraft) {
+        budget_record &record = claim(campaign_id);
+        uint64_t current = record.version.load(std::memory_order_relaxed);
+        do {
+            if ( current >= version ) {
+                return false;
+            }
+        } while ( !record.version.compare_exchange_weak(current, version, std::memory_order_relaxed) );
+        assign(campaign_id, limit, spent, overdraft);
+        return true;
+    }
+
+    //same as CampaignBudget::update(types::budget)
+    bool set_limit(uint32_t campaign_id, uint64_t limit) {
+        budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return false;
+        }
+        record->limit.store(limit, std::memory_order_relaxed);
+        return true;
+    }
+
+    /*
+     * Win of price micro dollars, same as CampaignBudget::update(types::price) : as much
+     * of price as the limit allows moves from limit to spent, the rest goes to overdraft.
+     * after is the record as this spend left it. False for an unknown campaign.
+     */
+    bool spend(uint32_t campaign_id, uint64_t price, budget_snapshot &after) {
+        budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return false;
+        }
+        uint64_t limit;
+        const uint64_t covered = take(record->limit, price, limit);
+        after.campaign_id = campaign_id;
+        after.limit = limit - covered;
+        after.spent = record->spent.fetch_add(covered, std::memory_order_relaxed) + covered;
+        after.overdraft = price > covered ?
+            record->overdraft.fetch_add(price - covered, std::memory_order_relaxed) + price - covered :
+            record->overdraft.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    bool read(uint32_t campaign_id, budget_snapshot &snapshot) const {
+        const budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return false;
+        }
+        snapshot.campaign_id = campaign_id;
+        snapshot.limit = record->limit.load(std::memory_order_relaxed);
+        snapshot.spent = record->spent.load(std::memory_order_relaxed);
+        snapshot.overdraft = record->overdraft.load(std::memory_order_relaxed);
+        snapshot.leased = record->leased.load(std::memory_order_relaxed);
+        return true;
+    }
+
+    //owner side, moves up to amount of the limit to leased and returns what was granted
+    uint64_t lease(uint32_t campaign_id, uint64_t amount) {
+        budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return 0;
+        }
+        uint64_t limit;
+        const uint64_t granted = take(record->limit, amount, limit);
+        record->leased.fetch_add(granted, std::memory_order_relaxed);
+        return granted;
+    }
+
+    /*
+     * Owner side, a lessee reports spent out of its leases and gives unused back to the limit.
+     * What goes beyond the outstanding leases was spent over them and is added to overdraft.
+     */
+    bool settle(uint32_t campaign_id, uint64_t spent, uint64_t unused) {
+        budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return false;
+        }
+        uint64_t leased;
+        const uint64_t returned = take(record->leased, spent + unused, leased);
+        record->spent.fetch_add(spent, std::memory_order_relaxed);
+        record->limit.fetch_add(unused, std::memory_order_relaxed);
+        if ( returned < spent + unused ) {
+            record->overdraft.fetch_add(spent + unused - returned, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    //lessee side, adds a granted lease to the limit
+    void credit(uint32_t campaign_id, uint64_t amount) {
+        budget_record &record = claim(campaign_id);
+        record.limit.fetch_add(amount, std::memory_order_relaxed);
+        record.leased.fetch_add(amount, std::memory_order_relaxed);
+        record.active.store(1, std::memory_order_release);
+    }
+
+    //lessee side, record with nothing to spend yet so the next lease renewal asks for it
+    void track(uint32_t campaign_id) {
+        claim(campaign_id).active.store(1, std::memory_order_release);
+    }
+
+    /*
+     * Lessee side, takes spent and overdraft accumulated since the previous drain and with
+     * release the unused limit as well, concurrent spends land either before or after.
+     */
+    bool drain(uint32_t campaign_id, budget_snapshot &drained, bool release) {
+        budget_record *record = find(campaign_id);
+        if ( !record ) {
+            return false;
+        }
+        drained.campaign_id = campaign_id;
+        drained.spent = record->spent.exchange(0, std::memory_order_relaxed);
+        drained.overdraft = record->overdraft.exchange(0, std::memory_order_relaxed);
+        drained.limit = release ? record->limit.exchange(0, std::memory_order_relaxed) : 0;
+        drained.leased = release ? record->leased.exchange(0, std::memory_order_relaxed) : 0;
+        return true;
+    }
+
+    //visitor(const budget_snapshot &) on every active record, amounts are read one by one
+    template<typename Visitor>
+    std::size_t visit(Visitor && visitor) const {
+        std::size_t visited{};
+        budget_snapshot snapshot;
+        for ( std::size_t slot = 0 ; slot <= _mask ; ++slot ) {
+            const uint32_t campaign_id = _records[slot].campaign_id.load(std::memory_order_acquire);
+            if ( campaign_id && _records[slot].active.load(std::memory_order_acquire) && read(campaign_id, snapshot) ) {
+                visitor(snapshot);
+                ++visited;
+            }
+        }
+        return visited;
+    }
+
+    //nothing left to spend, campaigns without a record are not limited here
+    bool exhausted(uint32_t campaign_id) const {
+        const budget_record *record = find(campaign_id);
+        return record && record->limit.load(std::memory_order_relaxed) == 0;
+    }
+
+    void remove(uint32_t campaign_id) {
+        if ( budget_record *record = find(campaign_id) ) {
+            record->active.store(0, std::memory_order_release);
+        }
+    }
+
+    std::size_t capacity() const {
+        return _mask + 1;
+    }
+
+private:
+    static std::size_t round_up(std::size_t capacity) {
+        std::size_t size = 1;
+        while ( size < capacity ) {
+            size <<= 1;
+        }
+        return size;
+    }
+    static std::size_t segment_size(std::size_t capacity) {
+        return capacity * sizeof(budget_record) + 65536; // plus alignment, segment manager and name index
+    }
+    //takes up to wanted off amount, before is what amount held right before
+    static uint64_t take(std::atomic<uint64_t> &amount, uint64_t wanted, uint64_t &before) {
+        before = amount.load(std::memory_order_relaxed);
+        uint64_t taken;
+        do {
+            taken = std::min(before, wanted);
+        } while ( !amount.compare_exchange_weak(before, before - taken, std::memory_order_relaxed) );
+        return taken;
+    }
+    std::size_t slot_of(uint32_t campaign_id) const {
+        return (campaign_id * 2654435761u) & _mask; // Knuth multiplicative, ids are mostly sequential
+    }
+
+    budget_record * find(uint32_t campaign_id) const {
+        if ( !campaign_id ) {
+            return nullptr;
+        }
+        for ( std::size_t i = 0, slot = slot_of(campaign_id) ; i <= _mask ; ++i, slot = (slot + 1) & _mask ) {
+            const uint32_t id = _records[slot].campaign_id.load(std::memory_order_acquire);
+            if ( id == campaign_id ) {
+                return _records[slot].active.load(std::memory_order_acquire) ? &_records[slot] : nullptr;
+            }
+            if ( !id ) {
+                return nullptr;
+            }
+        }
+        return nullptr;
+    }
+
+    budget_record & claim(uint32_t campaign_id) {
+        if ( !campaign_id ) {
+            throw std::invalid_argument("campaign_id 0 can't be stored in budget_store");
+        }
+        for ( std::size_t i = 0, slot = slot_of(campaign_id) ; i <= _mask ; ++i, slot = (slot + 1) & _mask ) {
+            uint32_t id = _records[slot].campaign_id.load(std::memory_order_acquire);
+            if ( !id && _records[slot].campaign_id.compare_exchange_strong(id, campaign_id, std::memory_order_acq_rel) ) {
+                return _records[slot];
+            }
+            if ( id == campaign_id ) {
+                return _records[slot];
+            }
+        }
+        throw std::runtime_error("budget_store is full, capacity=" + std::to_string(capacity()));
+    }
+
+    boost::scoped_ptr<segment_t> _segment ;
+    budget_record *_records ;
+    std::size_t _mask ;
+};
+
+}
+
+#endif /* __DATACACHE_BUDGET_STORE_HPP__ */
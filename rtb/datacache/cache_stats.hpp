@@ -0,0 +1,288 @@
+/*
+ * File:   cache_stats.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_CACHE_STATS_HPP__
+#define __DATACACHE_CACHE_STATS_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace datacache {
+
+/*
+ * log2 histogram of nanoseconds in shared memory, bucket i counts durations
+ * in [2^i, 2^(i+1)) ns, the last one everything longer.
+ */
+struct latency_histogram {
+    static constexpr std::size_t BUCKETS = 32;
+
+    latency_histogram() {
+        for ( auto &bucket : buckets ) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void record(uint64_t ns) {
+        std::size_t bucket{};
+        while ( ns >>= 1 ) {
+            ++bucket;
+        }
+        buckets[bucket < BUCKETS ? bucket : BUCKETS - 1].fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> buckets[BUCKETS];
+};
+
+//copy of a latency_histogram, percentiles are upper bounds of the bucket they fall into
+struct latency_summary {
+    uint64_t count{};
+    uint64_t p50{};
+    uint64_t p99{};
+    uint64_t max{};
+
+    explicit latency_summary(const latency_histogram &histogram) {
+        uint64_t buckets[latency_histogram::BUCKETS];
+        for ( std::size_t i = 0 ; i < latency_histogram::BUCKETS ; ++i ) {
+            buckets[i] = histogram.buckets[i].load(std::memory_order_relaxed);
+            count += buckets[i];
+        }
+        uint64_t seen{};
+        for ( std::size_t i = 0 ; i < latency_histogram::BUCKETS ; ++i ) {
+            if ( !buckets[i] ) {
+                continue;
+            }
+            const uint64_t upper = (uint64_t(2) << i) - 1;
+            seen += buckets[i];
+            if ( !p50 && seen * 2 >= count ) {
+                p50 = upper;
+            }
+            if ( !p99 && seen * 100 >= count * 99 ) {
+                p99 = upper;
+            }
+            max = upper;
+        }
+    }
+
+    //percentiles of a merge are the worst of the two, counts add up
+    latency_summary & operator+=(const latency_summary &other) {
+        count += other.count;
+        p50 = std::max(p50, other.p50);
+        p99 = std::max(p99, other.p99);
+        max = std::max(max, other.max);
+        return *this;
+    }
+
+    friend std::ostream &operator<<(std::ostream &os, const latency_summary &summary) {
+        return os << summary.count << "/" << summary.p50 << "/" << summary.p99 << "/" << summary.max;
+    }
+};
+
+//wait for and hold time of one kind of lock acquisition
+struct lock_times {
+    latency_histogram wait;
+    latency_histogram hold;
+};
+
+/*
+ * Counters of one cache, kept in its control segment next to cache_control so they
+ * survive reloads and every process attached to the cache adds to and reads the same ones.
+ * Updates are relaxed atomic increments, the lock histograms are fed by timed_lock.
+ */
+struct cache_counters {
+    std::atomic<uint64_t> inserts{0};
+    std::atomic<uint64_t> updates{0};
+    std::atomic<uint64_t> removes{0};
+    std::atomic<uint64_t> retrieves{0};
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> reloads{0};
+    std::atomic<uint64_t> commits{0};   // committed part of the reservation extended
+    std::atomic<uint64_t> grows{0};     // segment grown and remapped
+    lock_times read;
+    lock_times write;
+
+    void lookup(bool found) {
+        lookups(found, !found);
+    }
+    void lookups(uint64_t found, uint64_t missed) {
+        retrieves.fetch_add(found + missed, std::memory_order_relaxed);
+        if ( found ) {
+            hits.fetch_add(found, std::memory_order_relaxed);
+        }
+        if ( missed ) {
+            misses.fetch_add(missed, std::memory_order_relaxed);
+        }
+    }
+};
+
+/*
+ * RAII guard like bip::scoped_lock ( Sharable false ) or bip::sharable_lock ( Sharable true )
+ * which records how long it waited for the lock and held it. Writes are always timed,
+ * reads one in READ_SAMPLE per thread so the hot path pays for a clock read only rarely.
+ */
+template<typename Lock, bool Sharable>
+class timed_lock {
+    using clock = std::chrono::steady_clock;
+public:
+    static constexpr uint32_t READ_SAMPLE = 16;
+
+    timed_lock(Lock &lock, lock_times &times) : _lock(lock), _times(times), _sampled(sampled()) {
+        if ( !_sampled ) {
+            acquire();
+            return;
+        }
+        const auto start = clock::now();
+        acquire();
+        _acquired = clock::now();
+        _times.wait.record(std::chrono::duration_cast<std::chrono::nanoseconds>(_acquired - start).count());
+    }
+
+    ~timed_lock() {
+        if ( _sampled ) {
+            _times.hold.record(std::chrono::duration_cast<std::chrono::nanoseconds>(clock::now() - _acquired).count());
+        }
+        release();
+    }
+
+    timed_lock(const timed_lock &) = delete;
+    timed_lock & operator=(const timed_lock &) = delete;
+
+private:
+    static bool sampled() {
+        if ( !Sharable ) {
+            return true;
+        }
+        thread_local uint32_t acquisitions{};
+        return acquisitions++ % READ_SAMPLE == 0;
+    }
+    void acquire() {
+        Sharable ? _lock.lock_sharable() : _lock.lock();
+    }
+    void release() {
+        Sharable ? _lock.unlock_sharable() : _lock.unlock();
+    }
+
+    Lock &_lock;
+    lock_times &_times;
+    const bool _sampled;
+    clock::time_point _acquired;
+};
+
+//snapshot of a cache, counters plus what its published segment looks like right now
+struct cache_stats {
+    std::string name;
+    uint64_t generation{};
+    uint64_t sequence{};
+    uint64_t entries{};
+    uint64_t bytes_used{};
+    uint64_t bytes_free{};
+    uint64_t bytes_committed{};
+    const char *huge_pages{""};
+    uint64_t inserts{};
+    uint64_t updates{};
+    uint64_t removes{};
+    uint64_t retrieves{};
+    uint64_t hits{};
+    uint64_t misses{};
+    uint64_t reloads{};
+    uint64_t commits{};
+    uint64_t grows{};
+    latency_summary read_wait;
+    latency_summary read_hold;
+    latency_summary write_wait;
+    latency_summary write_hold;
+
+    explicit cache_stats(const cache_counters &counters) :
+        inserts(counters.inserts.load(std::memory_order_relaxed)),
+        updates(counters.updates.load(std::memory_order_relaxed)),
+        removes(counters.removes.load(std::memory_order_relaxed)),
+        retrieves(counters.retrieves.load(std::memory_order_relaxed)),
+        hits(counters.hits.load(std::memory_order_relaxed)),
+        misses(counters.misses.load(std::memory_order_relaxed)),
+        reloads(counters.reloads.load(std::memory_order_relaxed)),
+        commits(counters.commits.load(std::memory_order_relaxed)),
+        grows(counters.grows.load(std::memory_order_relaxed)),
+        read_wait(counters.read.wait), read_hold(counters.read.hold),
+        write_wait(counters.write.wait), write_hold(counters.write.hold)
+    {}
+
+    //adds up another cache, see sharded_entity_cache
+    cache_stats & operator+=(const cache_stats &other) {
+        generation = std::max(generation, other.generation);
+        sequence = std::max(sequence, other.sequence);
+        entries += other.entries;
+        bytes_used += other.bytes_used;
+        bytes_free += other.bytes_free;
+        bytes_committed += other.bytes_committed;
+        inserts += other.inserts;
+        updates += other.updates;
+        removes += other.removes;
+        retrieves += other.retrieves;
+        hits += other.hits;
+        misses += other.misses;
+        reloads += other.reloads;
+        commits += other.commits;
+        grows += other.grows;
+        read_wait += other.read_wait;
+        read_hold += other.read_hold;
+        write_wait += other.write_wait;
+        write_hold += other.write_hold;
+        return *this;
+    }
+
+    double hit_ratio() const {
+        return retrieves ? double(hits) / retrieves : 0.0;
+    }
+
+    //lock times are count/p50/p99/max in ns
+    friend std::ostream &operator<<(std::ostream &os, const cache_stats &stats) {
+        os << stats.name
+           << " generation=" << stats.generation
+           << " sequence=" << stats.sequence
+           << " entries=" << stats.entries
+           << " bytes=" << stats.bytes_used << "/" << stats.bytes_committed << "/" << stats.bytes_used + stats.bytes_free
+           << " huge_pages=" << stats.huge_pages
+           << " inserts=" << stats.inserts
+           << " updates=" << stats.updates
+           << " removes=" << stats.removes
+           << " retrieves=" << stats.retrieves
+           << " hit_ratio=" << stats.hit_ratio()
+           << " reloads=" << stats.reloads
+           << " commits=" << stats.commits
+           << " grows=" << stats.grows
+           << " read_wait=" << stats.read_wait
+           << " read_hold=" << stats.read_hold
+           << " write_wait=" << stats.write_wait
+           << " write_hold=" << stats.write_hold;
+        return os;
+    }
+
+    std::string to_string() const {
+        std::stringstream ss;
+        ss << *this;
+        return ss.str();
+    }
+};
+
+}
+
+#endif /* __DATACACHE_CACHE_STATS_HPP__ */
@@ -53,13 +53,8 @@ namespace ipc { namespace data {
             campaign_id = key.template get<campaign_id_tag>();  
         }
         template<typename Serializable>
-        static std::size_t size(const Serializable && data) {
-            std::stringstream ss;
-            boost::archive::binary_oarchive oarch(ss);
-            oarch << std::forward<Serializable>(data) ;
-            return base_type::size(std::forward<Serializable>(data)) +                
-                   sizeof(data.campaign_id) +                
-                   ss.str().size() ;
+        static std::size_t size(const Serializable & data) {
+            return base_type::size(data) ;
         }
         template<typename Serializable>
         void retrieve(Serializable  & data) const {
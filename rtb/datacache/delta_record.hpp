@@ -0,0 +1,64 @@
+/*
+ * File:   delta_record.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_DELTA_RECORD_HPP__
+#define __DATACACHE_DELTA_RECORD_HPP__
+
+#include "rtb/datacache/tsv_loader.hpp"
+#include <cstdint>
+
+namespace datacache {
+
+enum class delta_op : char {
+    upsert = 'U',
+    remove = 'D'
+};
+
+/*
+ * One change of a delta file, first and second are the key and data the same way
+ * entity loaders pass (key, data) pairs to entity_cache::reload / insert.
+ */
+template<typename Key, typename Data>
+struct delta_record {
+    uint64_t sequence{};
+    delta_op op{delta_op::upsert};
+    Key first;
+    Data second;
+};
+
+/*
+ * Delta line is "<sequence>\t<U|D>\t<record>" where record has the columns of the
+ * entity source file, parse_record(boost::string_view, Data &) is the entity line parser.
+ * Delete lines still carry the record, only its key columns are used.
+ */
+template<typename Key, typename Data, typename RecordParser>
+bool parse_delta(boost::string_view line, delta_record<Key, Data> &delta, RecordParser && parse_record) {
+    boost::string_view fields[3];
+    if ( tsv::split(line, '\t', fields, 3) < 3 || !tsv::parse_number(fields[0], delta.sequence) || fields[1].size() != 1 ) {
+        return false;
+    }
+    switch ( fields[1].front() ) {
+        case 'U' : delta.op = delta_op::upsert; break;
+        case 'D' : delta.op = delta_op::remove; break;
+        default : return false;
+    }
+    return parse_record(fields[2], delta.second);
+}
+
+}
+
+#endif /* __DATACACHE_DELTA_RECORD_HPP__ */
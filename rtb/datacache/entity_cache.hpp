@@ -24,16 +24,34 @@
 #include <boost/interprocess/exceptions.hpp>
 #include <boost/interprocess/allocators/allocator.hpp>
 #include <boost/interprocess/containers/string.hpp>
-#include <boost/interprocess/sync/named_upgradable_mutex.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
 #include <boost/interprocess/sync/scoped_lock.hpp>
 #include <boost/interprocess/sync/sharable_lock.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/tuple/tuple.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+#include <boost/mpl/size.hpp>
+#include <boost/mpl/begin_end.hpp>
+#include <boost/mpl/distance.hpp>
+#include <boost/mpl/find_if.hpp>
+#include <boost/mpl/placeholders.hpp>
+#include <boost/multi_index/hashed_index_fwd.hpp>
+#include <boost/multi_index/ordered_index_fwd.hpp>
+#include <iterator>
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
  
 #include <boost/version.hpp>
 #include <boost/core/demangle.hpp>
 #include "rtb/core/core.hpp"
+#include "rtb/datacache/cache_stats.hpp"
+#include "rtb/datacache/lock_types.hpp"
+#include "rtb/datacache/memory_types.hpp"
+#include "rtb/datacache/delta_record.hpp"
 
 namespace {
     namespace bip = boost::interprocess ;
@@ -91,7 +109,64 @@ struct retriever<Tag,std::vector<std::shared_ptr<Serializable>>> {
     }
 };
  
-template<typename Memory, template <class> class Container, size_t MEMORY_SIZE = 67108864 >
+template<typename Specifier>
+struct is_unique_index : std::false_type {};
+
+template<typename Arg1, typename Arg2, typename Arg3>
+struct is_unique_index<boost::multi_index::ordered_unique<Arg1, Arg2, Arg3>> : std::true_type {};
+
+template<typename Arg1, typename Arg2, typename Arg3, typename Arg4>
+struct is_unique_index<boost::multi_index::hashed_unique<Arg1, Arg2, Arg3, Arg4>> : std::true_type {};
+
+//position of the first unique index of a multi_index_container, records are told apart by it
+template<typename Container>
+struct unique_index {
+    using specifiers = typename Container::index_specifier_type_list;
+    using found = typename boost::mpl::find_if<specifiers, is_unique_index<boost::mpl::_1>>::type;
+    static constexpr std::size_t value = boost::mpl::distance<typename boost::mpl::begin<specifiers>::type, found>::value;
+    static_assert(value < boost::mpl::size<specifiers>::value, "container needs a unique index to match records");
+};
+
+//entities with store_key() fill only the members their indices read, others store everything
+template<typename Entity, typename Key, typename Serializable>
+auto store_key(Entity &entity, Key &&key, Serializable &&data, int) -> decltype(entity.store_key(key, data)) {
+    return entity.store_key(std::forward<Key>(key), std::forward<Serializable>(data));
+}
+
+template<typename Entity, typename Key, typename Serializable>
+void store_key(Entity &entity, Key &&key, Serializable &&data, long) {
+    entity.store(std::forward<Key>(key), std::forward<Serializable>(data));
+}
+
+/*
+ * Control block shared by all processes attached to the same cache.
+ * It lives in its own small segment "<store_name>_ctl" and tells readers 
+ * which generation of the data segment is currently published. A full reload
+ * builds generation N+1 in a separate segment and then publishes it by bumping 
+ * the generation, so readers never observe an empty or half-filled cache.
+ */
+struct cache_control {
+    boost::interprocess::interprocess_mutex reload_mutex; // serializes writers building the next generation
+    std::atomic<uint64_t> generation{0};                  // generation of the published data segment
+    std::atomic<uint64_t> sequence{0};                    // last delta applied to it, see apply_delta
+};
+
+/*
+ * Header of every data segment. Shared and Mapped segments reserve a large sparse range
+ * up front ( see memory_types.hpp ) and writers commit it geometrically as data grows,
+ * so the segment is remapped only when the reservation itself is exhausted. Every commit
+ * or grow bumps the capacity generation; processes compare it on lookup and re-attach
+ * lazily, only when the segment got bigger than their mapping.
+ */
+struct segment_capacity {
+    explicit segment_capacity(uint64_t size) : size(size) {}
+    std::atomic<uint64_t> size;            // size of the segment after the last grow
+    std::atomic<uint64_t> committed{0};    // bytes backed by memory
+    std::atomic<uint64_t> generation{0};   // bumped on every commit or grow
+};
+
+//Lock is a reader/writer policy from lock_types.hpp
+template<typename Memory, template <class> class Container, size_t MEMORY_SIZE = 67108864, typename Lock = named_upgradable_lock >
 class entity_cache
 {
 public:
@@ -105,117 +180,302 @@ public:
     using Data_t = typename Container_t::value_type;
        
     entity_cache(const std::string &name) : 
-        _segment_ptr(), _container_ptr(), _store_name(), _cache_name(name), _named_mutex(bip::open_or_create, (_cache_name + "_mutex").c_str()) {
-        //TODO: add to ctor to switch between mmap and shm
-        //TODO: maybe needs bip::scoped_lock to lock for other processes calling  grow_memory    
-        std::string data_base_dir = "/tmp/CACHE" ;
-        _store_name =  Memory::convert_base_dir(data_base_dir) + _cache_name;
-        _segment_ptr.reset(Memory::open_or_create_segment(_store_name.c_str(), MEMORY_SIZE) ) ;
-        _container_ptr = _segment_ptr->template find_or_construct<Container_t>( _cache_name.c_str() )
-        (typename Container_t::ctor_args_list() , typename Container_t::allocator_type(_segment_ptr->get_segment_manager()));
+        _cache_name(name),
+        _store_name(Memory::convert_base_dir(mpclmi::ipc::base_dir()) + _cache_name),
+        _control_ptr(Memory::open_or_create_segment(_store_name + "_ctl", CONTROL_SIZE)),
+        _control(_control_ptr->template find_or_construct<cache_control>("control")()),
+        _counters(_control_ptr->template find_or_construct<cache_counters>("stats")()),
+        _lock(*_control_ptr, _cache_name),
+        _view(), _view_mutex() {
+        std::atomic_store(&_view, attach_published());
     }
     
     void clear() {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex) ;
-        _container_ptr->clear() ;
+        write_lock guard(_lock, _counters->write) ;
+        current()->container->clear() ;
+    }
+
+    /*
+     * Full reload without a visible gap for readers ( blue/green ).
+     * The next generation is built in a separate segment, load is called with an
+     * inserter function(key, data) filling that segment, and once it returns the new
+     * generation is published through the control block. Readers switch on their next
+     * lookup; the old segment is unlinked and its memory is released by the OS once 
+     * the last process unmaps it.
+     */
+    template<typename Loader>
+    void reload(Loader && load) {
+        bip::scoped_lock<bip::interprocess_mutex> reload_guard(_control->reload_mutex) ;
+        auto staging = create_staging(MEMORY_SIZE, COMMIT_HEADROOM) ;
+        load([this,&staging](auto && key, auto && data) {
+            bool is_success {false};
+            commit_memory(*staging, COMMIT_HEADROOM) ;
+            try {
+                is_success = insert_data(*staging, std::forward<decltype(key)>(key), std::forward<decltype(data)>(data));
+            } catch (const bad_alloc_exception_t &e) {
+                LOG(debug) << boost::core::demangle(typeid(*this).name())
+                << " data was not inserted into generation " << staging->generation 
+                << " , MEMORY AVAILABLE=" <<  staging->segment->get_free_memory(); 
+                grow_memory(*staging, grow_size(*staging));
+                is_success = insert_data(*staging, std::forward<decltype(key)>(key), std::forward<decltype(data)>(data));
+            }
+            return is_success;
+        });
+        publish_staging(staging) ;
+    }
+
+    /*
+     * Bulk version of the above for a range of (key, data) pairs, see insert(first, last).
+     * Next generation segment has the whole range committed up front.
+     */
+    template<typename Iterator>
+    std::size_t reload(Iterator first, Iterator last) {
+        bip::scoped_lock<bip::interprocess_mutex> reload_guard(_control->reload_mutex) ;
+        const std::size_t needed = estimate_size(first, last) ;
+        auto staging = create_staging(std::max(MEMORY_SIZE, needed), std::max(std::size_t{COMMIT_HEADROOM}, needed)) ;
+        auto inserted = insert_range(*staging, first, last) ;
+        publish_staging(staging) ;
+        return inserted;
+    }
+
+    /*
+     * Bulk load of a range of (key, data) pairs ( anything with first and second ).
+     * Segment is pre-sized using entities size() helpers, lock is taken once and
+     * every record is inserted with the end() hint, so data sorted in the order of
+     * the first index goes in without searching the tree. Unsorted data is still
+     * inserted correctly, only slower. Returns number of inserted records.
+     */
+    template<typename Iterator>
+    std::size_t insert(Iterator first, Iterator last) {
+        const std::size_t needed = estimate_size(first, last) ;
+        bip::scoped_lock<bip::interprocess_mutex> reload_guard(_control->reload_mutex) ;
+        write_lock guard(_lock, _counters->write) ;
+        auto view = current();
+        commit_memory(*view, needed) ;
+        const std::size_t inserted = insert_range(*view, first, last) ;
+        _counters->inserts.fetch_add(inserted, std::memory_order_relaxed) ;
+        return inserted;
     }
    
     template<typename Tag, typename Key, typename Serializable, typename Arg>
     bool update( Key && key, Serializable && data, Arg&& arg) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex) ;
+        write_lock guard(_lock, _counters->write) ;
         bool is_success {false};
-        auto &index = _container_ptr->template get<Tag>();
+        auto view = current();
+        commit_memory(*view, COMMIT_HEADROOM) ;
+        auto &index = view->container->template get<Tag>();
         auto p = index.equal_range(std::forward<Arg>(arg));
         while ( p.first != p.second ) {
             try {
-              is_success |= update_data(std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
+              is_success |= update_data(*view,std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
             } catch (const bad_alloc_exception_t &e) {
               LOG(debug) << boost::core::demangle(typeid(*this).name())
               << " data was not updated , MEMORY AVAILABLE="
-              <<  _segment_ptr->get_free_memory() ;
-              grow_memory(MEMORY_SIZE);
-              is_success |= update_data(std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
+              <<  view->segment->get_free_memory() ;
+              grow_memory(*view, grow_size(*view));
+              is_success |= update_data(*view,std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
             }
         }
+        _counters->updates.fetch_add(is_success, std::memory_order_relaxed) ;
         return is_success;
     }
  
     template<typename Tag, typename Key, typename Serializable, typename ...Args>
     bool update( Key && key, Serializable && data, Args&& ...args) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex) ;
+        write_lock guard(_lock, _counters->write) ;
         bool is_success {false};
-        //Memory::attach([this](){attach();}); // reattach to newly created
-        auto &index = _container_ptr->template get<Tag>();
+        auto view = current();
+        commit_memory(*view, COMMIT_HEADROOM) ;
+        auto &index = view->container->template get<Tag>();
         auto p = index.equal_range(boost::make_tuple(std::forward<Args>(args)...));
          while ( p.first != p.second ) {
             try {
-              is_success |= update_data(std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
+              is_success |= update_data(*view,std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
             } catch (const bad_alloc_exception_t &e) {
               LOG(debug) << boost::core::demangle(typeid(*this).name())
               << " data was not updated , MEMORY AVAILABLE="
-              <<  _segment_ptr->get_free_memory() ;
-              grow_memory(MEMORY_SIZE);
-              is_success |= update_data(std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
+              <<  view->segment->get_free_memory() ;
+              grow_memory(*view, grow_size(*view));
+              is_success |= update_data(*view,std::forward<Key>(key),std::forward<Serializable>(data),index,p.first++);
             }
         }
+        _counters->updates.fetch_add(is_success, std::memory_order_relaxed) ;
         return is_success;
     }
  
+    /*
+     * Applies a batch of delta_records to the published generation in place under one
+     * write lock, so cost follows the size of the change and not of the data set.
+     * Records are found by the first unique index of the container : upsert replaces the
+     * record with the same key or adds it, remove erases it. An upsert colliding with
+     * another record on a further unique index is rejected and leaves the cache as it was.
+     * Records not above the last applied sequence are skipped so a delta file can be
+     * replayed. A full reload resets the sequence, deltas taken after the snapshot are
+     * applied on top of it. Arena bytes of replaced or removed records are reclaimed by
+     * the next full reload. Returns number of applied records.
+     */
+    template<typename Iterator>
+    std::size_t apply_delta(Iterator first, Iterator last) {
+        const std::size_t needed = estimate_size(first, last) ;
+        bip::scoped_lock<bip::interprocess_mutex> reload_guard(_control->reload_mutex) ;
+        write_lock guard(_lock, _counters->write) ;
+        auto view = current();
+        commit_memory(*view, needed) ;
+        uint64_t sequence = _control->sequence.load(std::memory_order_relaxed) ;
+        std::size_t applied{};
+        for ( ; first != last ; ++first ) {
+            if ( first->sequence <= sequence ) {
+                continue;
+            }
+            commit_memory(*view, COMMIT_HEADROOM) ;
+            bool is_applied;
+            try {
+                is_applied = apply_data(*view, *first);
+            } catch (const bad_alloc_exception_t &e) {
+                LOG(debug) << boost::core::demangle(typeid(*this).name())
+                << " delta " << first->sequence << " was not applied , MEMORY AVAILABLE="
+                <<  view->segment->get_free_memory();
+                grow_memory(*view, grow_size(*view));
+                is_applied = apply_data(*view, *first);
+            }
+            if ( !is_applied ) {
+                LOG(debug) << boost::core::demangle(typeid(*this).name())
+                << " delta " << first->sequence << " collides with another record and was rejected";
+            }
+            sequence = first->sequence ;
+            applied += is_applied;
+        }
+        _control->sequence.store(sequence, std::memory_order_release) ;
+        return applied;
+    }
+
+    //last delta sequence applied to the published generation, 0 right after a full reload
+    uint64_t sequence() const {
+        return _control->sequence.load(std::memory_order_acquire) ;
+    }
+
     template<typename Key, typename Serializable>
     bool insert( Key && key, Serializable &&data) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex) ;
+        write_lock guard(_lock, _counters->write) ;
         bool is_success {false};
+        auto view = current();
+        commit_memory(*view, COMMIT_HEADROOM) ;
         try {
-            is_success = insert_data(std::forward<Key>(key), std::forward<Serializable>(data));
+            is_success = insert_data(*view, std::forward<Key>(key), std::forward<Serializable>(data));
         } catch (const bad_alloc_exception_t &e) {
             LOG(debug) << boost::core::demangle(typeid(*this).name())
             << " data was not inserted , MEMORY AVAILABLE="
-            <<  _segment_ptr->get_free_memory(); 
-            grow_memory(MEMORY_SIZE);
-            is_success = insert_data(std::forward<Key>(key), std::forward<Serializable>(data));
+            <<  view->segment->get_free_memory(); 
+            grow_memory(*view, grow_size(*view));
+            is_success = insert_data(*view, std::forward<Key>(key), std::forward<Serializable>(data));
         }
- 
+        _counters->inserts.fetch_add(is_success, std::memory_order_relaxed) ;
         return is_success;
     }
   
-/***************** 
-    template<typename Serializable>
-    bool insert( const std::vector<Serializable> &data) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex) ;
-        bool is_success {false};
-        std::size_t n {data.size()} ;
-        for ( const auto &item : data) {
-            try {
-                if ( insert_data(data) ) { --n; }
-            } catch (const bad_alloc_exception_t &e) {
-                LOG(debug) << boost::core::demangle(typeid(*this).name())
-                << " data was not inserted , MEMORY AVAILABLE="
-                <<  _segment_ptr->get_free_memory(); 
-                grow_memory(MEMORY_SIZE);
-                if ( insert_data(data) ) { --n; }
-            }
-        }
-        return !n;
-    }
-*******************/
     
     template<typename Tag, typename Serializable, typename ...Args>
     bool retrieve(Serializable &entry, Args&& ...args) {
-        bip::sharable_lock<bip::named_upgradable_mutex> guard(_named_mutex);
-        return retriever<Tag,Serializable>()(*_container_ptr,entry,std::forward<Args>(args)...);
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        const bool is_found = retriever<Tag,Serializable>()(*view->container,entry,std::forward<Args>(args)...);
+        _counters->lookup(is_found);
+        return is_found;
     }
 
+    /*
+     * visit<Tag>(keys..., visitor) calls visitor(const Data_t &) on every record matching
+     * keys on index Tag, in place and under the read lock, nothing is copied or allocated.
+     * Visitor must not call back into the same cache and must not keep references to
+     * records after it returns. Returns number of visited records.
+     */
     template<typename Tag, typename ...Args>
-    auto retrieve_raw(Args&& ...args) {
-        bip::sharable_lock<bip::named_upgradable_mutex> guard(_named_mutex);
-        auto &idx = _container_ptr->template get<Tag>();
-        return equal_range(idx, std::forward<Args>(args)...);
+    std::size_t visit(Args&& ...args) {
+        static_assert(sizeof...(Args) > 1, "visit<Tag> takes key(s) followed by a visitor");
+        return visit_keys<Tag>(std::forward_as_tuple(std::forward<Args>(args)...), std::make_index_sequence<sizeof...(Args) - 1>());
     }
-    
+
+    /*
+     * visit_unique(keys..., visitor) finds the one record with keys of every member of the
+     * first unique index and calls visitor(const Data_t &) on it in place, see visit<Tag>.
+     * Returns whether it was found.
+     */
+    template<typename ...Args>
+    bool visit_unique(Args&& ...args) {
+        static_assert(sizeof...(Args) > 1, "visit_unique takes keys followed by a visitor");
+        return visit_unique_keys(std::forward_as_tuple(std::forward<Args>(args)...), std::make_index_sequence<sizeof...(Args) - 1>());
+    }
+
+    /*
+     * Batched visit for a range of keys ( single values or boost::tuple for composite keys )
+     * under one read lock. Keys are sorted in place, so consecutive tree descents share
+     * their path and duplicates are looked up once, and ranges are resolved LOOKUP_BATCH
+     * keys at a time with the first record of each prefetched before any of them is visited.
+     */
+    template<typename Tag, typename KeyRange, typename Visitor>
+    std::size_t visit_many(KeyRange &keys, Visitor && visitor) {
+        std::sort(std::begin(keys), std::end(keys));
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        auto &idx = view->container->template get<Tag>();
+        decltype(equal_range(idx, *std::begin(keys))) ranges[LOOKUP_BATCH];
+        std::size_t visited{}, found{}, missed{};
+        const auto end = std::end(keys);
+        auto key = std::begin(keys);
+        auto prev = end;
+        while ( key != end ) {
+            std::size_t batch{};
+            for ( ; key != end && batch < LOOKUP_BATCH ; prev = key++ ) {
+                if ( prev != end && !(*prev < *key) ) {
+                    continue; // duplicate
+                }
+                auto &range = ranges[batch];
+                range = equal_range(idx, *key);
+                if ( range.first != range.second ) {
+                    prefetch(&*range.first);
+                    ++batch;
+                } else {
+                    ++missed;
+                }
+            }
+            found += batch;
+            for ( std::size_t i = 0 ; i < batch ; ++i ) {
+                for ( auto p = ranges[i].first ; p != ranges[i].second ; ++p, ++visited ) {
+                    visitor(*p);
+                }
+            }
+        }
+        _counters->lookups(found, missed);
+        return visited;
+    }
+
+    //visitor(const Data_t &) on every record of the published generation, under the read lock
+    template<typename Visitor>
+    std::size_t visit_all(Visitor && visitor) {
+        read_lock guard(_lock, _counters->read);
+        std::size_t visited{};
+        auto view = current();
+        for ( const auto &data : *view->container ) {
+            visitor(data);
+            ++visited;
+        }
+        return visited;
+    }
+
+    //retrieve_many<Tag>(keys, out) appends every record matching any of keys to out
+    template<typename Tag, typename KeyRange, typename Collection>
+    bool retrieve_many(KeyRange &keys, Collection &out) {
+        return visit_many<Tag>(keys, [&out](const Data_t &data) {
+            out.emplace_back();
+            data.retrieve(out.back());
+        }) > 0;
+    }
+
     template<typename Serializable>
     bool retrieve(std::vector<std::shared_ptr<Serializable>> &entries) {
-        bip::sharable_lock<bip::named_upgradable_mutex> guard(_named_mutex);
-        auto p = std::make_pair(_container_ptr->begin(), _container_ptr->end());
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        auto p = std::make_pair(view->container->begin(), view->container->end());
         std::transform ( p.first, p.second, std::back_inserter(entries), [] ( const Data_t &data ) {
             std::shared_ptr<Serializable> impl_ptr { std::make_shared<Serializable>() } ;
             data.retrieve(*impl_ptr) ;
@@ -226,69 +486,405 @@ public:
 
     template<typename Tag, typename ...Args>
     void remove(Args&& ...args) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex);
-        auto p = _container_ptr->template get<Tag>().equal_range(boost::make_tuple(std::forward<Args>(args)...));
-        _container_ptr->erase(p.first, p.second);
+        write_lock guard(_lock, _counters->write);
+        auto view = current();
+        auto p = view->container->template get<Tag>().equal_range(boost::make_tuple(std::forward<Args>(args)...));
+        _counters->removes.fetch_add(std::distance(p.first, p.second), std::memory_order_relaxed);
+        view->container->erase(p.first, p.second);
     }
     
     template<typename Tag, typename Arg>
     void remove(Arg && arg) {
-        bip::scoped_lock<bip::named_upgradable_mutex> guard(_named_mutex);
-        auto p = _container_ptr->template get<Tag>().equal_range(std::forward<Arg>(arg));
-        _container_ptr->erase(p.first, p.second);
+        write_lock guard(_lock, _counters->write);
+        auto view = current();
+        auto p = view->container->template get<Tag>().equal_range(std::forward<Arg>(arg));
+        _counters->removes.fetch_add(std::distance(p.first, p.second), std::memory_order_relaxed);
+        view->container->erase(p.first, p.second);
     }
 
    char_string create_ipc_key(const std::string &key)  const {
+       auto view = current();
        try {
-           char_string tmp(key.data(), key.size(), _segment_ptr->get_segment_manager()) ;
+           char_string tmp(key.data(), key.size(), view->segment->get_segment_manager()) ;
            return tmp;
        } catch ( const  bad_alloc_exception_t &e ) {
            LOG(debug) << boost::core::demangle(typeid(*this).name())
            << " create_ipc_key failed , MEMORY AVAILABLE="
-           <<  _segment_ptr->get_free_memory(); 
-           grow_memory(MEMORY_SIZE) ;
-           char_string tmp(key.data(), key.size(), _segment_ptr->get_segment_manager()) ;
+           <<  view->segment->get_free_memory(); 
+           grow_memory(*view, grow_size(*view)) ;
+           char_string tmp(key.data(), key.size(), view->segment->get_segment_manager()) ;
            return tmp;
        }
    }
+
+    uint64_t generation() const {
+        return current()->generation;
+    }
+
+    //page size the published segment ended up with in this process, see memory_types.hpp
+    mpclmi::ipc::huge_page_mode huge_pages() const {
+        return current()->huge_pages;
+    }
+
+    /*
+     * Counters shared by every process attached to the cache plus the published segment
+     * as this process sees it. Entries are counted under the read lock, byte figures are
+     * read without it and may be a record behind a concurrent writer.
+     */
+    //records of the published generation
+    std::size_t size() const {
+        auto view = current();
+        read_lock guard(_lock, _counters->read);
+        return view->container->size();
+    }
+
+    //segment is read under the read lock, a writer may grow and remap it
+    cache_stats stats() const {
+        cache_stats stats(*_counters);
+        stats.name = _cache_name;
+        stats.sequence = sequence();
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        stats.generation = view->generation;
+        stats.bytes_free = view->segment->get_free_memory();
+        stats.bytes_used = view->segment->get_size() - stats.bytes_free;
+        stats.bytes_committed = view->capacity->committed.load(std::memory_order_relaxed);
+        stats.huge_pages = mpclmi::ipc::to_string(view->huge_pages);
+        stats.entries = view->container->size();
+        return stats;
+    }
 private:
-    void attach() const {
-    _segment_ptr.reset(new segment_t(bip::open_only,_store_name.c_str()) ) ;
-    _container_ptr = _segment_ptr->template find_or_construct<Container_t>(_cache_name.c_str())
-        (typename Container_t::ctor_args_list(), typename Container_t::allocator_type(_segment_ptr->get_segment_manager()));
+    static constexpr size_t CONTROL_SIZE = 65536 ;
+    using read_lock = timed_lock<Lock, true> ;
+    using write_lock = timed_lock<Lock, false> ;
+    static constexpr size_t COMMIT_HEADROOM = MEMORY_SIZE / 16 ; // committed ahead of single record writes
+    static constexpr size_t LOOKUP_BATCH = 16 ;                   // keys resolved before visiting, see visit_many
+
+    //one published generation of the data segment as mapped by this process
+    struct segment_view {
+        segment_ptr_t segment;
+        Container_t  *container{};
+        segment_capacity *capacity{};
+        std::string   name;
+        uint64_t      generation{};
+        std::size_t   mapped_size{};
+        std::atomic<uint64_t> capacity_generation{}; // last capacity generation seen by this process
+        mpclmi::ipc::huge_page_mode huge_pages{};
+    };
+    using segment_view_ptr = std::shared_ptr<segment_view> ;
+
+    static void prefetch(const void *address) {
+#if defined(__GNUC__)
+        __builtin_prefetch(address);
+#endif
     }
 
-    void grow_memory(size_t size) const {
+    template<typename Tag, typename Tuple, std::size_t ...Keys>
+    std::size_t visit_keys(Tuple && args, std::index_sequence<Keys...>) {
+        auto && visitor = std::get<sizeof...(Keys)>(args);
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        auto &idx = view->container->template get<Tag>();
+        std::size_t visited{};
+        for ( auto p = equal_range(idx, std::get<Keys>(args)...) ; p.first != p.second ; ++p.first, ++visited ) {
+            visitor(*p.first);
+        }
+        _counters->lookup(visited > 0);
+        return visited;
+    }
+
+    template<typename Tuple, std::size_t ...Keys>
+    bool visit_unique_keys(Tuple && args, std::index_sequence<Keys...>) {
+        auto && visitor = std::get<sizeof...(Keys)>(args);
+        read_lock guard(_lock, _counters->read);
+        auto view = current();
+        auto &idx = view->container->template get<unique_index<Container_t>::value>();
+        auto p = find(idx, std::get<Keys>(args)...);
+        const bool is_found = p != idx.end();
+        if ( is_found ) {
+            visitor(*p);
+        }
+        _counters->lookup(is_found);
+        return is_found;
+    }
+
+    //empty segment for the next generation, only visible to the writer until published
+    segment_view_ptr create_staging(std::size_t size, std::size_t committed) {
+        auto staging = std::make_shared<segment_view>() ;
+        staging->generation = _control->generation.load(std::memory_order_acquire) + 1 ;
+        staging->name = segment_name(staging->generation) ;
+        Memory::remove_segment(staging->name) ; // leftovers of a loader which did not publish
+        staging->segment.reset(Memory::open_or_create_segment(staging->name, Memory::reserve_size(size))) ;
+        locate(*staging, committed) ;
+        return staging;
+    }
+
+    void publish_staging(const segment_view_ptr &staging) {
+        segment_view_ptr published ;
+        {
+            write_lock guard(_lock, _counters->write) ;
+            published = current() ;
+            _control->generation.store(staging->generation, std::memory_order_release) ;
+            _control->sequence.store(0, std::memory_order_release) ;
+            publish(staging) ;
+        }
+        _counters->reloads.fetch_add(1, std::memory_order_relaxed) ;
+        _counters->inserts.fetch_add(staging->container->size(), std::memory_order_relaxed) ;
+        if ( published->name != staging->name ) {
+            Memory::remove_segment(published->name) ;
+        }
+    }
+
+    std::string segment_name(uint64_t generation) const {
+        return generation ? _store_name + "." + std::to_string(generation) : _store_name ;
+    }
+
+    static Container_t * construct_container(segment_view &view, const std::string &cache_name) {
+        return view.segment->template find_or_construct<Container_t>( cache_name.c_str() )
+        (typename Container_t::ctor_args_list() , typename Container_t::allocator_type(view.segment->get_segment_manager()));
+    }
+
+    Container_t * construct_container(segment_view &view) const {
+        return construct_container(view, _cache_name);
+    }
+
+    segment_view_ptr attach_published() const {
+        for (;;) {
+            const uint64_t generation = _control->generation.load(std::memory_order_acquire) ;
+            auto view = std::make_shared<segment_view>() ;
+            view->generation = generation ;
+            view->name = segment_name(generation) ;
+            try {
+                if ( generation ) {
+                    view->segment.reset(Memory::open_segment(view->name)) ;
+                } else {
+                    view->segment.reset(Memory::open_or_create_segment(view->name, Memory::reserve_size(MEMORY_SIZE))) ;
+                }
+            } catch (const bip::interprocess_exception &e) {
+                //published segment was replaced and unlinked before we managed to open it
+                if ( generation != _control->generation.load(std::memory_order_acquire) ) {
+                    continue;
+                }
+                throw;
+            }
+            locate(*view, COMMIT_HEADROOM) ;
+            return view;
+        }
+    }
+
+    //container and capacity header of a mapped segment, a new segment gets committed bytes backed
+    //every ( re )mapping goes through here so it is where huge pages are asked for
+    void locate(segment_view &view, std::size_t committed) const {
+        view.container = construct_container(view) ;
+        view.capacity = view.segment->template find_or_construct<segment_capacity>("segment_capacity")(view.segment->get_size()) ;
+        view.mapped_size = view.segment->get_size() ;
+        view.huge_pages = Memory::huge_pages(*view.segment, view.name) ;
+        view.capacity_generation.store(view.capacity->generation.load(std::memory_order_acquire), std::memory_order_relaxed) ;
+        if ( !view.capacity->committed.load(std::memory_order_acquire) ) {
+            committed = std::min(committed, view.mapped_size) ;
+            Memory::commit(view.name, committed) ;
+            uint64_t expected{};
+            view.capacity->committed.compare_exchange_strong(expected, committed) ;
+        }
+    }
+
+    /*
+     * Returns the view of the published generation, re-attaching first if another
+     * process has published a newer one or grew the segment past our mapping.
+     * Callers keep the returned view for as long as they touch its container, a view left
+     * behind by a switch is unmapped once the last of them lets go. Commits within the
+     * mapping need no re-attach.
+     */
+    segment_view_ptr current() const {
+        auto view = std::atomic_load(&_view) ;
+        if ( view->generation == _control->generation.load(std::memory_order_acquire) &&
+             view->capacity_generation.load(std::memory_order_relaxed) == view->capacity->generation.load(std::memory_order_acquire) ) {
+            return view;
+        }
+        std::lock_guard<std::mutex> guard(_view_mutex) ;
+        view = std::atomic_load(&_view) ;
+        if ( view->generation != _control->generation.load(std::memory_order_acquire) ||
+             view->mapped_size < view->capacity->size.load(std::memory_order_acquire) ) {
+            publish(attach_published()) ;
+            view = std::atomic_load(&_view) ;
+        } else {
+            view->capacity_generation.store(view->capacity->generation.load(std::memory_order_acquire), std::memory_order_relaxed) ;
+        }
+        return view;
+    }
+
+    void publish(const segment_view_ptr &view) const {
+        std::atomic_store(&_view, view) ;
+    }
+
+    /*
+     * Makes sure needed more bytes fit into the committed part of the segment.
+     * Capacity is committed geometrically out of the reserved range, the segment
+     * is grown and remapped only once the reservation is used up.
+     */
+    void commit_memory(segment_view &view, std::size_t needed) const {
+        const std::size_t used = view.segment->get_size() - view.segment->get_free_memory() ;
+        const std::size_t committed = view.capacity->committed.load(std::memory_order_relaxed) ;
+        if ( used + needed <= committed ) {
+            return;
+        }
+        std::size_t size = std::max<std::size_t>(2 * committed, used + needed) ;
+        if ( size > view.segment->get_size() ) {
+            grow_memory(view, std::max(size - view.segment->get_size(), grow_size(view))) ;
+        }
+        size = std::min(size, view.segment->get_size()) ;
+        Memory::commit(view.name, size) ;
+        view.capacity->committed.store(size, std::memory_order_relaxed) ;
+        _counters->commits.fetch_add(1, std::memory_order_relaxed) ;
+        view.capacity_generation.store(view.capacity->generation.fetch_add(1, std::memory_order_acq_rel) + 1, std::memory_order_relaxed) ;
+    }
+
+    //geometric growth, segment size is doubled
+    std::size_t grow_size(const segment_view &view) const {
+        return std::max(MEMORY_SIZE, view.segment->get_size()) ;
+    }
+
+    void grow_memory(segment_view &view, size_t size) const {
         try {
-          _segment_ptr.reset() ;
-          Memory::grow(_segment_ptr, _store_name.c_str(), size) ;
+          Memory::grow(view.segment, view.name.c_str(), size) ;
         } catch ( const  bad_alloc_exception_t &e ) {
+            if ( !view.segment ) {
+                view.segment.reset(Memory::open_segment(view.name)) ;
+            }
             LOG(debug) << boost::core::demangle(typeid(*this).name())       
-            << " failed to grow " << e.what() << ":free mem=" << _segment_ptr->get_free_memory() ;
+            << " failed to grow " << e.what() << ":free mem=" << view.segment->get_free_memory() ;
         }
-        Memory::attach([this](){attach();}); // reattach to newly created
+        locate(view, size) ; // heap memory is reallocated on grow
+        _counters->grows.fetch_add(1, std::memory_order_relaxed) ;
+        view.capacity->size.store(view.mapped_size, std::memory_order_release) ;
+        view.capacity_generation.store(view.capacity->generation.fetch_add(1, std::memory_order_acq_rel) + 1, std::memory_order_relaxed) ;
     }
  
     template<typename Key, typename Serializable>
-    bool insert_data(Key && key, Serializable &&data) {
-        Memory::attach([this](){attach();});
-        Data_t item(_segment_ptr->get_segment_manager());
+    bool insert_data(segment_view &view, Key && key, Serializable &&data) {
+        Data_t item(view.segment->get_segment_manager());
         item.store(std::forward<Key>(key), std::forward<Serializable>(data));
-        return _container_ptr->insert(item).second;
+        return view.container->insert(item).second;
     }
  
+    //record of the delta is found with find() on the unique index, a node is allocated only to add one
+    template<typename Delta>
+    bool apply_data(segment_view &view, Delta &delta) {
+        auto &index = view.container->template get<unique_index<Container_t>::value>();
+        Data_t item(view.segment->get_segment_manager());
+        if ( delta.op == delta_op::remove ) {
+            store_key(item, delta.first, delta.second, 0);
+            auto found = index.find(index.key_extractor()(item));
+            if ( found != index.end() ) {
+                index.erase(found);
+                _counters->removes.fetch_add(1, std::memory_order_relaxed);
+            }
+            return true;
+        }
+        item.store(delta.first, delta.second);
+        auto found = index.find(index.key_extractor()(item));
+        if ( found == index.end() ) {
+            const bool is_inserted = index.insert(item).second;
+            _counters->inserts.fetch_add(is_inserted, std::memory_order_relaxed);
+            return is_inserted;
+        }
+        //entities are modifiers of their own type, see update(), the original is put back on a collision
+        const Data_t original(*found);
+        const bool is_updated = index.modify(found, std::cref(item), std::cref(original));
+        _counters->updates.fetch_add(is_updated, std::memory_order_relaxed);
+        return is_updated;
+    }
+
+    //caller holds the lock for the whole range
+    template<typename Iterator>
+    std::size_t insert_range(segment_view &view, Iterator first, Iterator last) {
+        const std::size_t initial_size = view.container->size() ;
+        for ( ; first != last ; ++first ) {
+            commit_memory(view, COMMIT_HEADROOM) ;
+            try {
+                append_data(view, first->first, first->second);
+            } catch (const bad_alloc_exception_t &e) {
+                LOG(debug) << boost::core::demangle(typeid(*this).name())
+                << " bulk insert ran out of memory after " << view.container->size() - initial_size 
+                << " records , MEMORY AVAILABLE=" <<  view.segment->get_free_memory(); 
+                grow_memory(view, grow_size(view));
+                append_data(view, first->first, first->second);
+            }
+        }
+        return view.container->size() - initial_size ;
+    }
+
+    template<typename Key, typename Serializable>
+    void append_data(segment_view &view, Key && key, Serializable &&data) {
+        Data_t item(view.segment->get_segment_manager());
+        item.store(std::forward<Key>(key), std::forward<Serializable>(data));
+        view.container->insert(view.container->end(), item);
+    }
+
+    /*
+     * Bytes a range of records needs in the segment : entity size() of a sample
+     * extrapolated to the whole range plus the node of every index and allocator
+     * bookkeeping. Single pass ( input ) iterators can't be measured and give 0.
+     */
+    template<typename Iterator>
+    static std::size_t estimate_size(Iterator first, Iterator last) {
+        return estimate_size(first, last, typename std::iterator_traits<Iterator>::iterator_category());
+    }
+
+    template<typename Iterator>
+    static std::size_t estimate_size(Iterator, Iterator, std::input_iterator_tag) {
+        return 0;
+    }
+
+    template<typename Iterator>
+    static std::size_t estimate_size(Iterator first, Iterator last, std::forward_iterator_tag) {
+        static constexpr std::size_t SAMPLE_SIZE = 1024 ;
+        static constexpr std::size_t INDEX_NODE_SIZE = 3 * sizeof(void*) ;
+        static constexpr std::size_t ALLOCATION_OVERHEAD = 2 * 16 ;
+        const std::size_t count = std::distance(first, last) ;
+        if ( !count ) {
+            return 0;
+        }
+        const std::size_t stride = std::max<std::size_t>(1, count / SAMPLE_SIZE) ;
+        std::size_t sampled{}, sampled_bytes{};
+        for ( std::size_t i = 0 ; i < count ; i += stride ) {
+            sampled_bytes += entity_size(first->second, 0) ;
+            ++sampled;
+            if ( i + stride < count ) {
+                std::advance(first, stride) ;
+            }
+        }
+        const std::size_t record_size = sampled_bytes / sampled + sizeof(Data_t) + ALLOCATION_OVERHEAD +
+                                        INDEX_NODE_SIZE * boost::mpl::size<typename Container_t::index_type_list>::value ;
+        return count * record_size / 4 * 5 ; // 25% slack for fragmentation
+    }
+
+    template<typename Serializable, typename Entity = Data_t>
+    static auto entity_size(const Serializable &data, int) -> decltype(Entity::size(data)) {
+        return Entity::size(data);
+    }
+
+    //entities without size() helper store only what sizeof(Data_t) accounts for
+    template<typename Serializable>
+    static std::size_t entity_size(const Serializable &, long) {
+        return 0;
+    }
+
     template<typename Key, typename Serializable, typename Index, typename Iterator>
-    bool update_data(Key && key, Serializable && data, Index &index, Iterator itr) {
-        Data_t item(_segment_ptr->get_segment_manager());
+    bool update_data(segment_view &view, Key && key, Serializable && data, Index &index, Iterator itr) {
+        Data_t item(view.segment->get_segment_manager());
         item.store(std::forward<Key>(key), std::forward<Serializable>(data));
         return index.modify(itr,item) ;
     }
  
-    mutable boost::scoped_ptr<segment_t> _segment_ptr;
-    mutable Container_t  *_container_ptr ;
-    std::string _store_name ;
     std::string _cache_name ;
-    boost::interprocess::named_upgradable_mutex _named_mutex;
+    std::string _store_name ;
+    boost::scoped_ptr<segment_t> _control_ptr;
+    cache_control *_control;
+    cache_counters *_counters;
+    mutable Lock _lock;
+    mutable segment_view_ptr _view;
+    mutable std::mutex _view_mutex;
 };
  
 }
@@ -0,0 +1,141 @@
+/*
+ * File:   lock_types.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_LOCK_TYPES_HPP__
+#define __DATACACHE_LOCK_TYPES_HPP__
+
+#include <boost/interprocess/creation_tags.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/named_upgradable_mutex.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <sched.h>
+
+/*
+ * Lock policies for datacache::entity_cache.
+ * A policy is constructed from the cache control segment and the cache name,
+ * writers call lock()/unlock() and readers lock_sharable()/unlock_sharable()
+ * so bip::scoped_lock and bip::sharable_lock can be used on top of it.
+ */
+namespace datacache {
+
+/*
+ * Default policy, a named kernel upgradable mutex "<cache_name>_mutex".
+ * Every reader updates the same counter, fine for few readers.
+ */
+class named_upgradable_lock {
+public:
+    template<typename Segment>
+    named_upgradable_lock(Segment &, const std::string &name) :
+        _mutex(boost::interprocess::open_or_create, (name + "_mutex").c_str())
+    {}
+    void lock() { _mutex.lock(); }
+    void unlock() { _mutex.unlock(); }
+    void lock_sharable() { _mutex.lock_sharable(); }
+    void unlock_sharable() { _mutex.unlock_sharable(); }
+private:
+    boost::interprocess::named_upgradable_mutex _mutex;
+};
+
+/*
+ * Distributed reader-writer lock living in the cache control segment.
+ * Each reader thread sticks to one of SLOTS counters, each on its own cache line,
+ * picked by the cpu the thread first took the lock on, so readers on different
+ * cores do not pull the same cache line. A writer raises the writer flag and waits
+ * for all slots to drain; readers back off while the flag is up so writers are not starved.
+ * Writers are serialized with an interprocess_mutex in the same segment.
+ */
+template<std::size_t SLOTS = 64>
+class distributed_reader_lock {
+    static constexpr std::size_t CACHE_LINE = 64;
+    using counter_t = std::atomic<uint32_t>;
+
+    struct state_t {
+        state_t() {
+            for ( std::size_t i = 0 ; i < SLOTS ; ++i ) {
+                new (slot_address(i)) counter_t(0);
+            }
+        }
+        counter_t & slot(std::size_t i) {
+            return *reinterpret_cast<counter_t *>(slot_address(i));
+        }
+        void * slot_address(std::size_t i) {
+            //slot offset is the same in every process as segments are page aligned
+            auto base = (reinterpret_cast<std::uintptr_t>(slots) + CACHE_LINE - 1) & ~(CACHE_LINE - 1);
+            return reinterpret_cast<void *>(base + i * CACHE_LINE);
+        }
+        boost::interprocess::interprocess_mutex writer_mutex;
+        counter_t writer{0};
+        char slots[(SLOTS + 1) * CACHE_LINE];
+    };
+
+public:
+    template<typename Segment>
+    distributed_reader_lock(Segment &segment, const std::string &name) :
+        _state(segment.template find_or_construct<state_t>((name + "_readers").c_str())())
+    {}
+
+    void lock() {
+        _state->writer_mutex.lock();
+        _state->writer.store(1, std::memory_order_seq_cst);
+        for ( std::size_t i = 0 ; i < SLOTS ; ++i ) {
+            while ( _state->slot(i).load(std::memory_order_seq_cst) ) {
+                std::this_thread::yield();
+            }
+        }
+    }
+    void unlock() {
+        _state->writer.store(0, std::memory_order_release);
+        _state->writer_mutex.unlock();
+    }
+    void lock_sharable() {
+        auto &readers = _state->slot(this_slot());
+        for (;;) {
+            while ( _state->writer.load(std::memory_order_acquire) ) {
+                std::this_thread::yield();
+            }
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            if ( !_state->writer.load(std::memory_order_seq_cst) ) {
+                return;
+            }
+            readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+    void unlock_sharable() {
+        _state->slot(this_slot()).fetch_sub(1, std::memory_order_release);
+    }
+
+private:
+    static std::size_t this_slot() {
+        thread_local const std::size_t slot = [] {
+            int cpu = sched_getcpu();
+            return cpu < 0 ? std::hash<std::thread::id>()(std::this_thread::get_id()) % SLOTS
+                           : static_cast<std::size_t>(cpu) % SLOTS;
+        }();
+        return slot;
+    }
+
+    state_t *_state;
+};
+
+}
+
+#endif /* __DATACACHE_LOCK_TYPES_HPP__ */
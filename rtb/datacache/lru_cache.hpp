@@ -0,0 +1,230 @@
+/*
+ * File:   lru_cache.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_LRU_CACHE_HPP__
+#define __DATACACHE_LRU_CACHE_HPP__
+
+#include "rtb/datacache/any_str_ops.hpp"
+#include "rtb/datacache/memory_types.hpp"
+#include <boost/interprocess/allocators/allocator.hpp>
+#include <boost/interprocess/containers/string.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace datacache {
+
+namespace bip = boost::interprocess;
+
+struct lru_cache_stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t expirations;
+    uint64_t entries;
+    uint64_t bytes;
+    uint64_t capacity;
+    mpclmi::ipc::huge_page_mode huge_pages;
+
+    friend std::ostream &operator<<(std::ostream &os, const lru_cache_stats &stats) {
+        os << "hits=" << stats.hits
+           << " misses=" << stats.misses
+           << " evictions=" << stats.evictions
+           << " expirations=" << stats.expirations
+           << " entries=" << stats.entries
+           << " bytes=" << stats.bytes << "/" << stats.capacity
+           << " huge_pages=" << mpclmi::ipc::to_string(stats.huge_pages);
+        return os;
+    }
+
+    std::string to_string() const {
+        std::stringstream ss;
+        ss << *this;
+        return ss.str();
+    }
+};
+
+/*
+ * Bounded key-value cache in a named segment shared by every process opening the same name.
+ * Entries expire ttl after they were put and the least recently used ones are evicted
+ * once key and value bytes ( plus ENTRY_OVERHEAD per entry ) would exceed capacity.
+ * A hit moves the entry to the front of the LRU list so every call takes the segment mutex.
+ * Expiry uses steady_clock ( CLOCK_MONOTONIC ) which is the same for all processes of a host.
+ */
+template<typename Memory = mpclmi::ipc::Shared>
+class lru_cache {
+    using segment_t = typename Memory::segment_t ;
+    using segment_manager_t = typename Memory::segment_manager_t ;
+    using char_allocator = bip::allocator<char, segment_manager_t> ;
+    using char_string = bip::basic_string<char, std::char_traits<char>, char_allocator> ;
+    using clock = std::chrono::steady_clock ;
+
+    struct entry {
+        entry(const std::string &key, const std::string &value, int64_t expires, const char_allocator &allocator) :
+            key(key.data(), key.size(), allocator), value(value.data(), value.size(), allocator), expires(expires)
+        {}
+        char_string key;
+        char_string value;
+        int64_t expires; // steady_clock ticks
+    };
+
+    struct key_tag {};
+    using container_t = boost::multi_index_container<
+        entry,
+        boost::multi_index::indexed_by<
+            boost::multi_index::sequenced<>, // most recently used first
+            boost::multi_index::hashed_unique<
+                boost::multi_index::tag<key_tag>,
+                BOOST_MULTI_INDEX_MEMBER(entry, char_string, key),
+                ufw::any_str_hash<char_allocator>,
+                ufw::any_str_equal<char_allocator>
+            >
+        >,
+        bip::allocator<entry, segment_manager_t>
+    >;
+
+    struct header {
+        bip::interprocess_mutex mutex;
+        uint64_t bytes{};
+        std::atomic<uint64_t> hits{0};
+        std::atomic<uint64_t> misses{0};
+        std::atomic<uint64_t> evictions{0};
+        std::atomic<uint64_t> expirations{0};
+    };
+
+public:
+    static constexpr std::size_t ENTRY_OVERHEAD = sizeof(entry) + 8 * sizeof(void*) ; // index nodes and allocator bookkeeping
+
+    lru_cache(const std::string &name, std::size_t capacity, std::chrono::seconds ttl) :
+        _capacity(capacity),
+        _ttl(std::chrono::duration_cast<clock::duration>(ttl).count()),
+        //segment is sized to the capacity plus slack for fragmentation and hash buckets
+        _segment(Memory::open_or_create_segment(Memory::convert_base_dir(mpclmi::ipc::base_dir()) + name, capacity + capacity / 4 + SEGMENT_OVERHEAD)),
+        _huge_pages(Memory::huge_pages(*_segment, Memory::convert_base_dir(mpclmi::ipc::base_dir()) + name)),
+        _header(_segment->template find_or_construct<header>("lru_header")()),
+        _container(_segment->template find_or_construct<container_t>("lru_container")(
+            typename container_t::ctor_args_list(), _segment->get_segment_manager()))
+    {}
+
+    bool get(const std::string &key, std::string &value) {
+        bip::scoped_lock<bip::interprocess_mutex> guard(_header->mutex) ;
+        auto &index = _container->template get<key_tag>() ;
+        auto found = index.find(boost::string_view(key.data(), key.size())) ;
+        if ( found == index.end() ) {
+            _header->misses.fetch_add(1, std::memory_order_relaxed) ;
+            return false;
+        }
+        if ( found->expires <= now() ) {
+            erase(_container->template project<0>(found)) ;
+            _header->expirations.fetch_add(1, std::memory_order_relaxed) ;
+            _header->misses.fetch_add(1, std::memory_order_relaxed) ;
+            return false;
+        }
+        _container->relocate(_container->begin(), _container->template project<0>(found)) ;
+        value.assign(found->value.data(), found->value.size()) ;
+        _header->hits.fetch_add(1, std::memory_order_relaxed) ;
+        return true;
+    }
+
+    //values larger than the whole capacity are not cached
+    bool put(const std::string &key, const std::string &value) {
+        const std::size_t bytes = entry_bytes(key, value) ;
+        if ( bytes > _capacity ) {
+            return false;
+        }
+        bip::scoped_lock<bip::interprocess_mutex> guard(_header->mutex) ;
+        auto &index = _container->template get<key_tag>() ;
+        auto found = index.find(boost::string_view(key.data(), key.size())) ;
+        if ( found != index.end() ) {
+            erase(_container->template project<0>(found)) ;
+        }
+        while ( _header->bytes + bytes > _capacity ) {
+            evict() ;
+        }
+        for (;;) {
+            try {
+                _container->emplace_front(key, value, now() + _ttl, char_allocator(_segment->get_segment_manager())) ;
+                break;
+            } catch ( const bip::bad_alloc & ) {
+                //fragmented segment, the byte budget fits but no block is large enough
+                if ( _container->empty() ) {
+                    return false;
+                }
+                evict() ;
+            }
+        }
+        _header->bytes += bytes ;
+        return true;
+    }
+
+    lru_cache_stats stats() const {
+        bip::scoped_lock<bip::interprocess_mutex> guard(_header->mutex) ;
+        return lru_cache_stats{
+            _header->hits.load(std::memory_order_relaxed),
+            _header->misses.load(std::memory_order_relaxed),
+            _header->evictions.load(std::memory_order_relaxed),
+            _header->expirations.load(std::memory_order_relaxed),
+            _container->size(),
+            _header->bytes,
+            _capacity,
+            _huge_pages
+        };
+    }
+
+private:
+    static constexpr std::size_t SEGMENT_OVERHEAD = 65536 ;
+
+    static int64_t now() {
+        return clock::now().time_since_epoch().count() ;
+    }
+
+    static std::size_t entry_bytes(const std::string &key, const std::string &value) {
+        return key.size() + value.size() + ENTRY_OVERHEAD ;
+    }
+
+    //least recently used entry is at the back
+    void evict() {
+        erase(std::prev(_container->end())) ;
+        _header->evictions.fetch_add(1, std::memory_order_relaxed) ;
+    }
+
+    void erase(typename container_t::iterator item) {
+        _header->bytes -= item->key.size() + item->value.size() + ENTRY_OVERHEAD ;
+        _container->erase(item) ;
+    }
+
+    const std::size_t _capacity ;
+    const int64_t _ttl ;
+    boost::scoped_ptr<segment_t> _segment ;
+    const mpclmi::ipc::huge_page_mode _huge_pages ;
+    header *_header ;
+    container_t *_container ;
+};
+
+}
+
+#endif /* __DATACACHE_LRU_CACHE_HPP__ */
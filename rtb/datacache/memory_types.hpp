@@ -23,12 +23,131 @@
 #include <boost/interprocess/managed_mapped_file.hpp> //Variant-II , open(), mmap()
 #include <boost/interprocess/managed_heap_memory.hpp> // Variant III for heap
 #include <boost/interprocess/creation_tags.hpp>
+#include <boost/interprocess/exceptions.hpp>
 
 #include <boost/thread/locks.hpp>
 #include <boost/thread/shared_mutex.hpp>
 
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/statfs.h>
+
 namespace mpclmi { namespace ipc {
+
+//backs first size bytes of the file so writing them can't SIGBUS when tmpfs or disk is full
+inline void commit_file(int fd, size_t size) {
+    const int err = ::posix_fallocate(fd, 0, size) ;
+    if ( err == ENOSPC || err == EFBIG ) {
+        throw boost::interprocess::bad_alloc() ;
+    }
+    //filesystems without fallocate support keep allocating pages on first touch
+}
    
+/*
+ * Backend of the Configured policy, chosen at run time from configuration.
+ * Set once at startup before any cache is opened, see configure().
+ * base_dir is the directory of Mapped segment files, Shared segments live in /dev/shm.
+ * With read_only published segments are opened for lookups only ( warm start from
+ * images written by the cache compiler ), segments created by this process stay writable.
+ * huge_pages applies to every policy, see advise_huge_pages.
+ */
+enum class memory_backend {
+    shared,
+    mapped,
+    heap
+};
+
+struct memory_settings {
+    memory_backend backend{memory_backend::shared};
+    std::string base_dir{"/tmp/CACHE"};
+    bool read_only{false};
+    bool huge_pages{false};
+    size_t reserve_multiple{4};
+};
+
+inline memory_settings & settings() {
+    static memory_settings instance;
+    return instance;
+}
+
+/*
+ * Shared and Mapped segments are created with reserve_multiple times the size a cache asks
+ * for as address space and file size, but the file is sparse, only pages which were touched
+ * or committed take memory. Data fitting the reservation is committed without growing and
+ * remapping the segment, so readers keep their mapping and base address. Every segment of
+ * every generation and shard reserves this much, so it is kept a small multiple.
+ */
+inline size_t reserve_size(size_t size) {
+    return size * std::max<size_t>(1, settings().reserve_multiple) ;
+}
+
+enum class huge_page_mode {
+    none,        // 4k pages
+    transparent  // madvise(MADV_HUGEPAGE) accepted for the mapping
+};
+
+inline const char * to_string(huge_page_mode mode) {
+    return mode == huge_page_mode::transparent ? "transparent" : "none";
+}
+
+//current value of a transparent_hugepage sysfs setting, the one in brackets
+inline std::string transparent_huge_pages(const std::string &setting) {
+    std::ifstream in("/sys/kernel/mm/transparent_hugepage/" + setting);
+    std::string value;
+    while ( in >> value ) {
+        if ( value.size() > 2 && value.front() == '[' && value.back() == ']' ) {
+            return value.substr(1, value.size() - 2);
+        }
+    }
+    return "never";
+}
+
+/*
+ * Asks the kernel to back the 2MB aligned part of a segment mapping with transparent
+ * huge pages, so index walks over a large segment take fewer TLB misses. setting is the
+ * sysfs knob governing this kind of memory ( "enabled" for anonymous, "shmem_enabled"
+ * for tmpfs and /dev/shm ). Falls back to none when huge pages are not requested, are
+ * switched off or not built into the kernel, the segment works the same either way.
+ * hugetlbfs is not used as it would take the whole reservation out of the huge page pool.
+ */
+inline huge_page_mode advise_huge_pages(void *address, size_t size, const std::string &setting) {
+#if defined(MADV_HUGEPAGE)
+    constexpr std::uintptr_t HUGE_PAGE_SIZE = std::uintptr_t(1) << 21 ;
+    if ( !settings().huge_pages ) {
+        return huge_page_mode::none;
+    }
+    const std::string mode = transparent_huge_pages(setting) ;
+    if ( mode == "never" || mode == "deny" ) {
+        return huge_page_mode::none;
+    }
+    const std::uintptr_t begin = (reinterpret_cast<std::uintptr_t>(address) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1) ;
+    const std::uintptr_t end = (reinterpret_cast<std::uintptr_t>(address) + size) & ~(HUGE_PAGE_SIZE - 1) ;
+    if ( begin >= end || ::madvise(reinterpret_cast<void *>(begin), end - begin, MADV_HUGEPAGE) ) {
+        return huge_page_mode::none;
+    }
+    return huge_page_mode::transparent;
+#else
+    return huge_page_mode::none;
+#endif
+}
+
+//files of tmpfs are shmem, on other filesystems writable file mappings get 4k pages
+inline bool is_tmpfs(const std::string &path) {
+    constexpr long TMPFS_MAGIC_NUMBER = 0x01021994 ;
+    struct statfs fs;
+    return ::statfs(path.c_str(), &fs) == 0 && static_cast<long>(fs.f_type) == TMPFS_MAGIC_NUMBER ;
+}
+
 struct Shared {
     typedef boost::interprocess::managed_shared_memory   segment_t;
     typedef boost::interprocess::managed_shared_memory::segment_manager  segment_manager_t;
@@ -51,9 +170,23 @@ struct Shared {
         mem_ptr.reset(open_segment(path)) ;
         return ;
     }
+    static bool remove_segment (const std::string &path) {
+        return boost::interprocess::shared_memory_object::remove(path.c_str()) ;
+    }
+    static size_t reserve_size(size_t size) {
+        return ipc::reserve_size(size) ;
+    }
+    static void commit(const std::string &path, size_t size) {
+        boost::interprocess::shared_memory_object shm(boost::interprocess::open_only, path.c_str(), boost::interprocess::read_write) ;
+        commit_file(shm.get_mapping_handle().handle, size) ;
+    }
     static std::string convert_base_dir(const std::string &base_dir) {
         return "" ;
     }
+    template<typename Segment>
+    static huge_page_mode huge_pages(Segment &segment, const std::string &path) {
+        return advise_huge_pages(segment.get_address(), segment.get_size(), "shmem_enabled") ;
+    }
 
     template<typename Function>
     static void attach( Function && f ) {
@@ -83,9 +216,23 @@ struct Mapped {
         mem_ptr.reset(open_segment(path)) ;
         return ;
     }
+    static bool remove_segment (const std::string &path) {
+        return boost::interprocess::file_mapping::remove(path.c_str()) ;
+    }
+    static size_t reserve_size(size_t size) {
+        return ipc::reserve_size(size) ;
+    }
+    static void commit(const std::string &path, size_t size) {
+        boost::interprocess::file_mapping file(path.c_str(), boost::interprocess::read_write) ;
+        commit_file(file.get_mapping_handle().handle, size) ;
+    }
     static std::string convert_base_dir(const std::string &base_dir) {
         return base_dir + "/";
     }
+    template<typename Segment>
+    static huge_page_mode huge_pages(Segment &segment, const std::string &path) {
+        return is_tmpfs(path) ? advise_huge_pages(segment.get_address(), segment.get_size(), "shmem_enabled") : huge_page_mode::none ;
+    }
 
     template<typename Function>
     static void attach( Function && f ) {
@@ -105,19 +252,233 @@ struct Heap {
     static segment_t * create_segment (const std::string &path, size_t size) {
         return new segment_t(size) ; 
     }
+    //heap segments are private to the process, there is nothing to open by name
+    static segment_t * open_segment (const std::string &path) {
+        throw boost::interprocess::interprocess_exception("heap segment can not be opened by name") ;
+    }
     template <typename MemPtr>
     static void grow( MemPtr &mem_ptr, const std::string &path, size_t size) {
         mem_ptr->grow(size) ;
         return ;
     }
+    static bool remove_segment (const std::string &path) {
+        return true ;
+    }
+    //heap segments are allocated in full, nothing to reserve or commit
+    static size_t reserve_size(size_t size) {
+        return size ;
+    }
+    static void commit(const std::string &path, size_t size) {}
     static std::string convert_base_dir(const std::string &base_dir) {
         return "" ;
     }
+    template<typename Segment>
+    static huge_page_mode huge_pages(Segment &segment, const std::string &path) {
+        return advise_huge_pages(segment.get_address(), segment.get_size(), "enabled") ;
+    }
 
     template<typename Function>
     static void attach( Function && ) {}
 };
 
+inline memory_backend to_backend(const std::string &name) {
+    if ( name == "shared" ) {
+        return memory_backend::shared;
+    }
+    if ( name == "mapped" ) {
+        return memory_backend::mapped;
+    }
+    if ( name == "heap" ) {
+        return memory_backend::heap;
+    }
+    throw std::invalid_argument("unknown memory backend " + name + " , expected shared, mapped or heap");
+}
+
+inline const char * to_string(memory_backend backend) {
+    switch ( backend ) {
+        case memory_backend::mapped : return "mapped";
+        case memory_backend::heap : return "heap";
+        default : return "shared";
+    }
+}
+
+//mapped segment files need base_dir to exist, its parent directory is not created
+inline void configure(const std::string &backend, const std::string &base_dir, bool read_only = false, bool huge_pages = false) {
+    settings().backend = to_backend(backend);
+    settings().base_dir = base_dir;
+    settings().read_only = read_only;
+    settings().huge_pages = huge_pages;
+    if ( settings().backend == memory_backend::mapped && ::mkdir(base_dir.c_str(), 0755) && errno != EEXIST ) {
+        throw std::runtime_error("could not create cache directory " + base_dir + " exiting...");
+    }
+}
+
+inline const std::string & base_dir() {
+    return settings().base_dir;
+}
+
+//heap segment with the segment manager of the shared and mapped ones, so Configured has one container type
+using configured_heap_memory = boost::interprocess::basic_managed_heap_memory<
+    char, boost::interprocess::rbtree_best_fit<boost::interprocess::mutex_family>, boost::interprocess::iset_index> ;
+
+/*
+ * Segment of the Configured policy, owns a segment of whichever backend was configured
+ * and exposes the part of the managed segment interface the caches use.
+ * In a read only mapping find_or_construct only finds, nothing may be constructed there.
+ */
+class configured_segment {
+public:
+    using segment_manager = boost::interprocess::managed_shared_memory::segment_manager ;
+    static_assert(std::is_same<segment_manager, boost::interprocess::managed_mapped_file::segment_manager>::value &&
+                  std::is_same<segment_manager, configured_heap_memory::segment_manager>::value,
+                  "configured backends must share the segment manager");
+
+    explicit configured_segment(boost::interprocess::managed_shared_memory *segment, bool read_only = false) :
+        _shared(segment), _manager(segment->get_segment_manager()), _read_only(read_only) {}
+    explicit configured_segment(boost::interprocess::managed_mapped_file *segment, bool read_only = false) :
+        _mapped(segment), _manager(segment->get_segment_manager()), _read_only(read_only) {}
+    explicit configured_segment(configured_heap_memory *segment) :
+        _heap(segment), _manager(segment->get_segment_manager()), _read_only(false) {}
+
+    segment_manager * get_segment_manager() const {
+        return _manager;
+    }
+    size_t get_size() const {
+        return _manager->get_size();
+    }
+    size_t get_free_memory() const {
+        return _manager->get_free_memory();
+    }
+    void * get_address() const {
+        return _shared ? _shared->get_address() : _mapped ? _mapped->get_address() : _heap->get_address();
+    }
+    bool read_only() const {
+        return _read_only;
+    }
+
+    template<typename T, typename Name>
+    auto find_or_construct(Name name) {
+        return [this, name](auto && ...args) -> T * {
+            if ( !_read_only ) {
+                return _manager->template find_or_construct<T>(name)(std::forward<decltype(args)>(args)...);
+            }
+            //nobody writes to a read only mapping so there is nothing to lock
+            T *found = _manager->template find_no_lock<T>(name).first;
+            if ( !found ) {
+                throw boost::interprocess::interprocess_exception("object not found in read only segment");
+            }
+            return found;
+        };
+    }
+
+    //heap segments are grown in place, others are grown by name and reopened
+    void grow(size_t size) {
+        _heap->grow(size);
+        _manager = _heap->get_segment_manager();
+    }
+
+private:
+    std::unique_ptr<boost::interprocess::managed_shared_memory> _shared;
+    std::unique_ptr<boost::interprocess::managed_mapped_file> _mapped;
+    std::unique_ptr<configured_heap_memory> _heap;
+    segment_manager *_manager;
+    bool _read_only;
+};
+
+/*
+ * Memory policy dispatching to Shared, Mapped or Heap at run time, see memory_settings.
+ * Processes sharing caches must be configured with the same backend and base dir.
+ */
+struct Configured {
+    typedef configured_segment   segment_t;
+    typedef configured_segment::segment_manager  segment_manager_t;
+    typedef boost::shared_mutex lock_t ;
+    typedef boost::unique_lock<lock_t>  scoped_exclusive_locker_t;
+    typedef boost::shared_lock<lock_t>  scoped_shared_locker_t;
+    static segment_t * open_or_create_segment (const std::string &path, size_t size) {
+        switch ( settings().backend ) {
+            case memory_backend::mapped : return new segment_t(Mapped::open_or_create_segment(path, size)) ;
+            case memory_backend::heap : return new segment_t(new configured_heap_memory(size)) ;
+            default : return new segment_t(Shared::open_or_create_segment(path, size)) ;
+        }
+    }
+    static segment_t * open_segment (const std::string &path) {
+        return open_segment(path, settings().read_only) ;
+    }
+    static segment_t * create_segment (const std::string &path, size_t size) {
+        switch ( settings().backend ) {
+            case memory_backend::mapped : return new segment_t(Mapped::create_segment(path, size)) ;
+            case memory_backend::heap : return new segment_t(new configured_heap_memory(size)) ;
+            default : return new segment_t(Shared::create_segment(path, size)) ;
+        }
+    }
+    //only writers grow, so the segment is reopened writable whatever read_only says
+    template <typename MemPtr>
+    static void grow(MemPtr &mem_ptr , const std::string &path, size_t size) {
+        switch ( settings().backend ) {
+            case memory_backend::heap :
+                mem_ptr->grow(size) ;
+                return ;
+            case memory_backend::mapped :
+                mem_ptr.reset() ;
+                Mapped::segment_t::grow(path.c_str(), size) ;
+                break ;
+            default :
+                mem_ptr.reset() ;
+                Shared::segment_t::grow(path.c_str(), size) ;
+        }
+        mem_ptr.reset(open_segment(path, false)) ;
+    }
+    static bool remove_segment (const std::string &path) {
+        switch ( settings().backend ) {
+            case memory_backend::mapped : return Mapped::remove_segment(path) ;
+            case memory_backend::heap : return Heap::remove_segment(path) ;
+            default : return Shared::remove_segment(path) ;
+        }
+    }
+    static size_t reserve_size(size_t size) {
+        return settings().backend == memory_backend::heap ? Heap::reserve_size(size) : ipc::reserve_size(size) ;
+    }
+    static void commit(const std::string &path, size_t size) {
+        switch ( settings().backend ) {
+            case memory_backend::mapped : return Mapped::commit(path, size) ;
+            case memory_backend::heap : return Heap::commit(path, size) ;
+            default : return Shared::commit(path, size) ;
+        }
+    }
+    static std::string convert_base_dir(const std::string &base_dir) {
+        return settings().backend == memory_backend::mapped ? Mapped::convert_base_dir(base_dir) : "" ;
+    }
+    static huge_page_mode huge_pages(segment_t &segment, const std::string &path) {
+        switch ( settings().backend ) {
+            case memory_backend::mapped : return Mapped::huge_pages(segment, path) ;
+            case memory_backend::heap : return Heap::huge_pages(segment, path) ;
+            default : return Shared::huge_pages(segment, path) ;
+        }
+    }
+
+    template<typename Function>
+    static void attach( Function && f ) {
+        if ( settings().backend != memory_backend::heap ) {
+            f() ;
+        }
+    }
+private:
+    static segment_t * open_segment (const std::string &path, bool read_only) {
+        namespace bip = boost::interprocess ;
+        switch ( settings().backend ) {
+            case memory_backend::mapped :
+                return read_only ? new segment_t(new bip::managed_mapped_file(bip::open_read_only, path.c_str()), true)
+                                 : new segment_t(Mapped::open_segment(path)) ;
+            case memory_backend::heap :
+                throw bip::interprocess_exception("heap segment can not be opened by name") ;
+            default :
+                return read_only ? new segment_t(new bip::managed_shared_memory(bip::open_read_only, path.c_str()), true)
+                                 : new segment_t(Shared::open_segment(path)) ;
+        }
+    }
+};
+
 }}
 #endif	/* __IPC_MEMORY_TYPES_HPP__ */
 
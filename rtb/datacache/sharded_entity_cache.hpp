@@ -0,0 +1,227 @@
+/*
+ * File:   sharded_entity_cache.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_SHARDED_ENTITY_CACHE_HPP__
+#define __DATACACHE_SHARDED_ENTITY_CACHE_HPP__
+
+#include "rtb/datacache/entity_cache.hpp"
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace datacache {
+
+/*
+ * entity_cache split into SHARDS independent caches, each with its own segments, control
+ * block and lock, for entities updated far more often than they are read in bulk ( budgets ).
+ * Records go to the shard picked by hashing their ShardTag key, so writers of different keys
+ * mostly take different locks and readers of one key only wait for writers of its shard.
+ * Lookups on ShardTag with a single key touch one shard, any other lookup visits all of them
+ * one after another, there is no snapshot across shards. Shard i is named name_shard<i>.
+ */
+template<typename Memory, template <class> class Container, typename ShardTag, std::size_t SHARDS = 16,
+         std::size_t MEMORY_SIZE = 4194304, typename Lock = named_upgradable_lock >
+class sharded_entity_cache
+{
+    static_assert(SHARDS > 0, "at least one shard");
+    using shard_t = entity_cache<Memory, Container, MEMORY_SIZE, Lock> ;
+    using shard_range = std::pair<std::size_t, std::size_t> ;
+public:
+    using char_allocator = typename shard_t::char_allocator ;
+    using Container_t = typename shard_t::Container_t ;
+    using Data_t = typename shard_t::Data_t ;
+
+    sharded_entity_cache(const std::string &name) : _cache_name(name) {
+        _shards.reserve(SHARDS);
+        for ( std::size_t i = 0 ; i < SHARDS ; ++i ) {
+            _shards.emplace_back(new shard_t(name + "_shard" + std::to_string(i)));
+        }
+    }
+
+    void clear() {
+        for ( auto &shard : _shards ) {
+            shard->clear();
+        }
+    }
+
+    /*
+     * Full reload of a range of (key, data) pairs, records are partitioned by shard and every
+     * shard is reloaded blue/green on its own, so readers may see some shards of the new
+     * generation and some of the old one until the last shard is published.
+     */
+    template<typename Iterator>
+    std::size_t reload(Iterator first, Iterator last) {
+        auto parts = partition(first, last);
+        std::size_t inserted{};
+        for ( std::size_t i = 0 ; i < SHARDS ; ++i ) {
+            inserted += _shards[i]->reload(parts[i].begin(), parts[i].end());
+        }
+        return inserted;
+    }
+
+    template<typename Iterator>
+    std::size_t insert(Iterator first, Iterator last) {
+        auto parts = partition(first, last);
+        std::size_t inserted{};
+        for ( std::size_t i = 0 ; i < SHARDS ; ++i ) {
+            if ( !parts[i].empty() ) {
+                inserted += _shards[i]->insert(parts[i].begin(), parts[i].end());
+            }
+        }
+        return inserted;
+    }
+
+    template<typename Key, typename Serializable>
+    bool insert( Key && key, Serializable &&data) {
+        return _shards[shard_of_key(key)]->insert(std::forward<Key>(key), std::forward<Serializable>(data));
+    }
+
+    /*
+     * Records found by arg are updated in their shard, one whose ShardTag key changed
+     * to a value hashed to another shard is then moved there. The move is not atomic, no
+     * lock spans both shards : the record is inserted into the target shard first and only
+     * then removed from its old one, so a reader in between may see it in both but never in
+     * neither. When the insert fails the record stays in its old shard, where lookups on
+     * ShardTag no longer route, and false is returned for it.
+     */
+    template<typename Tag, typename Key, typename Serializable, typename ...Args>
+    bool update( Key && key, Serializable && data, Args&& ...args) {
+        const std::size_t target = shard_of_key(key);
+        const auto shards = route<Tag>(args...);
+        bool is_success {false};
+        for ( std::size_t i = shards.first ; i < shards.second ; ++i ) {
+            if ( !_shards[i]->template update<Tag>(key, data, args...) ) {
+                continue;
+            }
+            if ( i == target ) {
+                is_success = true;
+                continue;
+            }
+            if ( !_shards[target]->insert(key, data) ) {
+                LOG(error) << _cache_name << " record was not moved from shard " << i << " to shard " << target;
+                continue;
+            }
+            _shards[i]->template remove<ShardTag>(key.template get<ShardTag>());
+            is_success = true;
+        }
+        return is_success;
+    }
+
+    //entry is a single Serializable ( first match wins ) or a vector collecting matches of every shard
+    template<typename Tag, typename Serializable, typename ...Args>
+    bool retrieve(Serializable &entry, Args&& ...args) {
+        const auto shards = route<Tag>(args...);
+        bool is_found {false};
+        for ( std::size_t i = shards.first ; i < shards.second ; ++i ) {
+            is_found |= _shards[i]->template retrieve<Tag>(entry, args...);
+            if ( is_found && !is_collection<Serializable>::value ) {
+                break;
+            }
+        }
+        return is_found;
+    }
+
+    template<typename Serializable>
+    bool retrieve(std::vector<std::shared_ptr<Serializable>> &entries) {
+        for ( auto &shard : _shards ) {
+            shard->retrieve(entries);
+        }
+        return !entries.empty();
+    }
+
+    template<typename Tag, typename ...Args>
+    void remove(Args&& ...args) {
+        const auto shards = route<Tag>(args...);
+        for ( std::size_t i = shards.first ; i < shards.second ; ++i ) {
+            _shards[i]->template remove<Tag>(args...);
+        }
+    }
+
+    //whole cache as one, counters and sizes add up, lock times are those of the worst shard
+    cache_stats stats() const {
+        cache_stats stats = _shards.front()->stats();
+        for ( std::size_t i = 1 ; i < SHARDS ; ++i ) {
+            stats += _shards[i]->stats();
+        }
+        stats.name = _cache_name;
+        return stats;
+    }
+
+    std::vector<cache_stats> shard_stats() const {
+        std::vector<cache_stats> stats;
+        for ( const auto &shard : _shards ) {
+            stats.push_back(shard->stats());
+        }
+        return stats;
+    }
+
+    static constexpr std::size_t shards() {
+        return SHARDS;
+    }
+
+private:
+    template<typename T>
+    struct is_collection : std::false_type {};
+    template<typename T>
+    struct is_collection<std::vector<T>> : std::true_type {};
+
+    template<typename Arg>
+    static std::size_t shard_of(const Arg &arg) {
+        return std::hash<std::decay_t<Arg>>()(arg) % SHARDS;
+    }
+
+    template<typename Key>
+    static std::size_t shard_of_key(const Key &key) {
+        std::decay_t<Key> copy = key; // tagged_tuple::get is not const
+        return shard_of(copy.template get<ShardTag>());
+    }
+
+    //single key on ShardTag lives in one shard, everything else may be in any
+    template<typename Tag, typename ...Args>
+    static shard_range route(const Args& ...args) {
+        return route(std::integral_constant<bool, std::is_same<Tag, ShardTag>::value && sizeof...(Args) == 1>(), args...);
+    }
+    template<typename Arg>
+    static shard_range route(std::true_type, const Arg &arg) {
+        const std::size_t shard = shard_of(arg);
+        return {shard, shard + 1};
+    }
+    template<typename ...Args>
+    static shard_range route(std::false_type, const Args& ...) {
+        return {0, SHARDS};
+    }
+
+    template<typename Iterator>
+    static std::vector<std::vector<typename std::iterator_traits<Iterator>::value_type>> partition(Iterator first, Iterator last) {
+        std::vector<std::vector<typename std::iterator_traits<Iterator>::value_type>> parts(SHARDS);
+        for ( ; first != last ; ++first ) {
+            parts[shard_of_key(first->first)].push_back(*first);
+        }
+        return parts;
+    }
+
+    std::string _cache_name;
+    std::vector<std::unique_ptr<shard_t>> _shards;
+};
+
+}
+
+#endif /* __DATACACHE_SHARDED_ENTITY_CACHE_HPP__ */
@@ -0,0 +1,268 @@
+/*
+ * File:   string_dictionary.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_STRING_DICTIONARY_HPP__
+#define __DATACACHE_STRING_DICTIONARY_HPP__
+
+#include "rtb/datacache/memory_types.hpp"
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+#include <boost/functional/hash.hpp>
+#include <boost/scoped_ptr.hpp>
+#if BOOST_VERSION <= 106000
+#include <boost/utility/string_ref.hpp>
+namespace boost {
+    using string_view = string_ref;
+}
+#else
+#include <boost/utility/string_view.hpp>
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+
+namespace datacache {
+
+//ASCII case folding, same as boost::algorithm::to_lower in the "C" locale the loaders run with
+struct folded_hash {
+    template<typename String>
+    std::size_t operator()(const String &value) const {
+        std::size_t seed{};
+        for ( const char c : value ) {
+            boost::hash_combine(seed, fold(c));
+        }
+        return seed;
+    }
+    static char fold(char c) {
+        return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+};
+
+struct folded_equal {
+    template<typename L, typename R>
+    bool operator()(const L &l, const R &r) const {
+        if ( l.size() != r.size() ) {
+            return false;
+        }
+        auto ri = r.begin();
+        for ( const char c : l ) {
+            if ( folded_hash::fold(c) != folded_hash::fold(*ri++) ) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+/*
+ * Append only dictionary of case folded strings in its own named segment, id of a string
+ * is its position + 1 and never changes, so entities of other caches can key on 32 bit ids
+ * and keep them across their reloads. find() folds case while hashing the probe, callers
+ * don't lowercase or copy request strings. 0 is never a valid id.
+ *
+ * Lookups take no lock : ids are kept in an open addressing table of atomic slots over
+ * entries which are never moved or freed, intern() fills an entry before it publishes the
+ * id with a release store, so a reader sees a string whole or not at all. Only intern()
+ * writes, one writer at a time under the dictionary mutex. A table is replaced by one twice
+ * the size once half full, the old one stays valid for readers still probing it.
+ * The segment is committed ahead of every allocation, a full filesystem is bad_alloc.
+ */
+template<typename Memory = mpclmi::ipc::Shared>
+class string_dictionary {
+    using segment_t = typename Memory::segment_t ;
+    using mutex_t = boost::interprocess::interprocess_mutex ;
+    using offset_t = std::ptrdiff_t ; // from the segment manager, the same in every process
+public:
+    using id_type = uint32_t ;
+    static constexpr id_type NOT_FOUND = 0 ;
+
+    explicit string_dictionary(const std::string &name, std::size_t size = 67108864) :
+        _path(Memory::convert_base_dir(mpclmi::ipc::base_dir()) + name),
+        _segment(Memory::open_or_create_segment(_path, Memory::reserve_size(size))),
+        _mutex(_segment->template find_or_construct<mutex_t>("dictionary_mutex")()),
+        _header(_segment->template find_or_construct<header>("dictionary")())
+    {
+        boost::interprocess::scoped_lock<mutex_t> guard(*_mutex) ;
+        commit(COMMIT_HEADROOM) ;
+    }
+
+    //id of value, added if it was not there yet
+    id_type intern(boost::string_view value) {
+        if ( const id_type id = find(value) ) {
+            return id;
+        }
+        boost::interprocess::scoped_lock<mutex_t> guard(*_mutex) ;
+        if ( const id_type id = find(value) ) {
+            return id; // interned by another writer in the meantime
+        }
+        const id_type id = _header->size.load(std::memory_order_relaxed) + 1 ;
+        table *ids = current() ;
+        if ( !ids || id > ids->capacity / 2 ) {
+            ids = grow(ids, id) ;
+        }
+        commit(sizeof(entry) + value.size() + ALLOCATION_OVERHEAD) ;
+        auto *stored = new (allocate(sizeof(entry) + value.size())) entry{static_cast<uint32_t>(value.size())} ;
+        std::transform(value.begin(), value.end(), stored->data(), folded_hash::fold) ;
+        entries(ids)[id - 1].store(offset(stored), std::memory_order_release) ;
+        link(ids, id, value) ;
+        _header->size.store(id, std::memory_order_release) ;
+        return id;
+    }
+
+    id_type find(boost::string_view value) const {
+        const table *ids = current() ;
+        if ( !ids ) {
+            return NOT_FOUND;
+        }
+        const std::size_t mask = ids->capacity - 1 ;
+        for ( std::size_t slot = folded_hash()(value) & mask ; ; slot = (slot + 1) & mask ) {
+            const id_type id = slots(ids)[slot].load(std::memory_order_acquire) ;
+            if ( id == NOT_FOUND ) {
+                return NOT_FOUND; // at most half of the slots are taken
+            }
+            if ( folded_equal()(stored(ids, id), value) ) {
+                return id;
+            }
+        }
+    }
+
+    //case folded string of id, stays valid for the segment lifetime as nothing is ever removed
+    boost::string_view view(id_type id) const {
+        if ( id == NOT_FOUND || id > _header->size.load(std::memory_order_acquire) ) {
+            return {};
+        }
+        return stored(current(), id) ; // table is published before size, it holds id
+    }
+
+    std::size_t size() const {
+        return _header->size.load(std::memory_order_acquire) ;
+    }
+
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 1024 ;
+    static constexpr std::size_t COMMIT_HEADROOM = 1048576 ;
+    static constexpr std::size_t ALLOCATION_OVERHEAD = 64 ; // segment manager block header and alignment
+
+    //case folded copy of an interned string, chars follow the size
+    struct entry {
+        uint32_t size;
+        char * data() {
+            return reinterpret_cast<char *>(this + 1);
+        }
+        const char * data() const {
+            return reinterpret_cast<const char *>(this + 1);
+        }
+    };
+
+    //followed by std::atomic<id_type> slots[capacity] and std::atomic<offset_t> entries[capacity / 2] by id - 1
+    struct table {
+        uint64_t capacity; // power of two
+    };
+
+    struct header {
+        std::atomic<id_type> size{0};
+        std::atomic<offset_t> table{0};     // 0 until the first intern()
+        std::atomic<uint64_t> committed{0}; // bytes backed by memory
+    };
+
+    static std::atomic<id_type> * slots(const table *ids) {
+        return reinterpret_cast<std::atomic<id_type> *>(const_cast<table *>(ids) + 1);
+    }
+    static std::atomic<offset_t> * entries(const table *ids) {
+        return reinterpret_cast<std::atomic<offset_t> *>(slots(ids) + ids->capacity);
+    }
+    static std::size_t table_size(std::size_t capacity) {
+        return sizeof(table) + capacity * sizeof(std::atomic<id_type>) + capacity / 2 * sizeof(std::atomic<offset_t>);
+    }
+
+    table * current() const {
+        const offset_t ids = _header->table.load(std::memory_order_acquire) ;
+        return ids ? static_cast<table *>(address(ids)) : nullptr ;
+    }
+
+    boost::string_view stored(const table *ids, id_type id) const {
+        const auto *value = static_cast<const entry *>(address(entries(ids)[id - 1].load(std::memory_order_acquire))) ;
+        return {value->data(), value->size};
+    }
+
+    //slot of id is taken last, readers probing for value find it complete
+    void link(table *ids, id_type id, boost::string_view value) {
+        const std::size_t mask = ids->capacity - 1 ;
+        std::size_t slot = folded_hash()(value) & mask ;
+        while ( slots(ids)[slot].load(std::memory_order_relaxed) != NOT_FOUND ) {
+            slot = (slot + 1) & mask ;
+        }
+        slots(ids)[slot].store(id, std::memory_order_release) ;
+    }
+
+    //next table with room for id, filled with every id of the current one before it is published
+    table * grow(const table *ids, id_type id) {
+        std::size_t capacity = ids ? 2 * ids->capacity : INITIAL_CAPACITY ;
+        while ( capacity / 2 < id ) {
+            capacity *= 2 ;
+        }
+        commit(table_size(capacity) + ALLOCATION_OVERHEAD) ;
+        auto *next = new (allocate(table_size(capacity))) table{capacity} ;
+        for ( std::size_t slot = 0 ; slot < capacity ; ++slot ) {
+            new (slots(next) + slot) std::atomic<id_type>(NOT_FOUND) ;
+        }
+        for ( std::size_t position = 0 ; position < capacity / 2 ; ++position ) {
+            new (entries(next) + position) std::atomic<offset_t>(0) ;
+        }
+        const id_type size = _header->size.load(std::memory_order_relaxed) ;
+        for ( id_type interned = 1 ; interned <= size ; ++interned ) {
+            entries(next)[interned - 1].store(entries(ids)[interned - 1].load(std::memory_order_relaxed), std::memory_order_relaxed) ;
+            link(next, interned, stored(ids, interned)) ;
+        }
+        _header->table.store(offset(next), std::memory_order_release) ;
+        return next;
+    }
+
+    void * allocate(std::size_t size) {
+        return _segment->get_segment_manager()->allocate(size) ;
+    }
+    offset_t offset(const void *value) const {
+        return static_cast<const char *>(value) - reinterpret_cast<const char *>(_segment->get_segment_manager()) ;
+    }
+    void * address(offset_t value) const {
+        return reinterpret_cast<char *>(_segment->get_segment_manager()) + value ;
+    }
+
+    //same geometric commit as entity_cache, needed more bytes are backed before they are allocated
+    void commit(std::size_t needed) {
+        const std::size_t used = _segment->get_size() - _segment->get_free_memory() ;
+        const std::size_t committed = _header->committed.load(std::memory_order_relaxed) ;
+        if ( used + needed <= committed ) {
+            return;
+        }
+        const std::size_t size = std::min<std::size_t>(std::max<std::size_t>(2 * committed, used + needed), _segment->get_size()) ;
+        Memory::commit(_path, size) ;
+        _header->committed.store(size, std::memory_order_relaxed) ;
+    }
+
+    std::string _path ;
+    boost::scoped_ptr<segment_t> _segment ;
+    mutex_t *_mutex ;
+    header *_header ;
+};
+
+}
+
+#endif /* __DATACACHE_STRING_DICTIONARY_HPP__ */
@@ -0,0 +1,231 @@
+/*
+ * File:   tsv_loader.hpp
+ * Author: Vladimir Venediktov
+ * Copyright (c) 2016-2018 Venediktes Gruppe, LLC
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+*
+*/
+
+#ifndef __DATACACHE_TSV_LOADER_HPP__
+#define __DATACACHE_TSV_LOADER_HPP__
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#if BOOST_VERSION <= 106000
+#include <boost/utility/string_ref.hpp>
+namespace boost {
+    using string_view = string_ref;
+}
+#else
+#include <boost/utility/string_view.hpp>
+#endif
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace datacache { namespace tsv {
+
+//read only mapping of a whole source file, empty files are not mapped
+class mapped_file {
+public:
+    explicit mapped_file(const std::string &path) {
+        std::ifstream in{path, std::ios::binary | std::ios::ate};
+        if (!in) {
+            throw std::runtime_error(std::string("could not open file ") + path + " exiting...");
+        }
+        if ( in.tellg() > 0 ) {
+            boost::interprocess::file_mapping mapping(path.c_str(), boost::interprocess::read_only);
+            region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+            region.advise(boost::interprocess::mapped_region::advice_sequential);
+        }
+    }
+    const char *begin() const {
+        return static_cast<const char *>(region.get_address());
+    }
+    const char *end() const {
+        return begin() + region.get_size();
+    }
+    std::size_t size() const {
+        return region.get_size();
+    }
+private:
+    boost::interprocess::mapped_region region;
+};
+
+/*
+ * Splits line on delimiter into at most max fields, the last one keeps the rest of the line.
+ * memchr is vectorized by libc so long fields are skipped 16 or 32 bytes at a time.
+ * With compress empty fields are dropped like boost::token_compress_on does.
+ */
+inline std::size_t split(boost::string_view line, char delimiter, boost::string_view *fields, std::size_t max, bool compress = false) {
+    std::size_t count{};
+    const char *begin = line.data();
+    const char *end = begin + line.size();
+    while ( count < max ) {
+        const char *found = count + 1 == max ? nullptr : static_cast<const char *>(std::memchr(begin, delimiter, end - begin));
+        const char *field_end = found ? found : end;
+        if ( !compress || field_end != begin ) {
+            fields[count++] = boost::string_view(begin, field_end - begin);
+        }
+        if ( !found ) {
+            break;
+        }
+        begin = found + 1;
+    }
+    return count;
+}
+
+//decimal digits only, no sign, locale or whitespace, false if field does not fit T
+template<typename T>
+bool parse_number(boost::string_view field, T &value) {
+    static_assert(std::is_unsigned<T>::value, "unsigned integers only");
+    if ( field.empty() || field.size() > std::numeric_limits<uint64_t>::digits10 ) {
+        return false;
+    }
+    uint64_t result{};
+    for ( const char c : field ) {
+        const unsigned digit = static_cast<unsigned char>(c) - '0';
+        if ( digit > 9 ) {
+            return false;
+        }
+        result = result * 10 + digit;
+    }
+    if ( result > std::numeric_limits<T>::max() ) {
+        return false;
+    }
+    value = static_cast<T>(result);
+    return true;
+}
+
+template<typename Record, typename LineParser>
+std::size_t parse_chunk(const char *begin, const char *end, std::vector<Record> &records, LineParser &parse_line) {
+    std::size_t rejected{};
+    while ( begin < end ) {
+        const char *eol = static_cast<const char *>(std::memchr(begin, '\n', end - begin));
+        const char *line_end = eol ? eol : end;
+        std::size_t size = line_end - begin;
+        if ( size && begin[size - 1] == '\r' ) {
+            --size;
+        }
+        if ( size ) {
+            records.emplace_back();
+            if ( !parse_line(boost::string_view(begin, size), records.back()) ) {
+                records.pop_back();
+                ++rejected;
+            }
+        }
+        begin = line_end + 1;
+    }
+    return rejected;
+}
+
+//chunks smaller than this are not worth a thread
+constexpr std::size_t MIN_CHUNK_SIZE = 1 << 20;
+
+/*
+ * Maps path and parses it on up to threads threads ( 0 is hardware_concurrency ),
+ * the file is cut into line aligned chunks, parse_line(boost::string_view line, Record &)
+ * fills one record per non empty line and returns false for a malformed one.
+ * Records are appended in file order, returns the number of rejected lines.
+ * parse_line is called concurrently so it must not touch shared state.
+ */
+template<typename Record, typename LineParser>
+std::size_t parse(const std::string &path, std::vector<Record> &records, LineParser parse_line, unsigned threads = 0) {
+    const mapped_file file(path);
+    if ( !threads ) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    const std::size_t chunks = std::min<std::size_t>(threads, file.size() / MIN_CHUNK_SIZE + 1);
+    if ( chunks == 1 ) {
+        return parse_chunk(file.begin(), file.end(), records, parse_line);
+    }
+
+    std::vector<const char *> bounds{file.begin()};
+    for ( std::size_t chunk = 1; chunk < chunks; ++chunk ) {
+        const char *cut = std::max(bounds.back(), file.begin() + file.size() / chunks * chunk);
+        const char *eol = static_cast<const char *>(std::memchr(cut, '\n', file.end() - cut));
+        bounds.push_back(eol ? eol + 1 : file.end());
+    }
+    bounds.push_back(file.end());
+
+    std::vector<std::vector<Record>> parsed(chunks);
+    std::vector<std::future<std::size_t>> futures;
+    for ( std::size_t chunk = 0; chunk < chunks; ++chunk ) {
+        futures.emplace_back(std::async(std::launch::async, [&, chunk]() {
+            auto chunk_parser = parse_line;
+            parsed[chunk].reserve((bounds[chunk + 1] - bounds[chunk]) / 64);
+            return parse_chunk(bounds[chunk], bounds[chunk + 1], parsed[chunk], chunk_parser);
+        }));
+    }
+    std::size_t rejected{};
+    std::exception_ptr error;
+    for ( auto &future : futures ) {
+        try {
+            rejected += future.get();
+        } catch (...) {
+            if ( !error ) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if ( error ) {
+        std::rethrow_exception(error);
+    }
+
+    std::size_t total = records.size();
+    for ( const auto &chunk : parsed ) {
+        total += chunk.size();
+    }
+    records.reserve(total);
+    for ( auto &chunk : parsed ) {
+        std::move(chunk.begin(), chunk.end(), std::back_inserter(records));
+    }
+    return rejected;
+}
+
+/*
+ * Runs independent loads ( callables ) concurrently and waits for all of them,
+ * the first exception thrown by any of them is rethrown after the others finished.
+ */
+template<typename ...Loads>
+void load_concurrently(Loads && ...loads) {
+    std::vector<std::future<void>> futures;
+    using expand = int[];
+    (void)expand{0, (futures.emplace_back(std::async(std::launch::async, std::forward<Loads>(loads))), 0)...};
+    std::exception_ptr error;
+    for ( auto &future : futures ) {
+        try {
+            future.get();
+        } catch (...) {
+            if ( !error ) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if ( error ) {
+        std::rethrow_exception(error);
+    }
+}
+
+}}
+
+#endif /* __DATACACHE_TSV_LOADER_HPP__ */
@@ -28,6 +28,7 @@
 #include "CRUD/service/reply.hpp"
 #include "CRUD/handlers/crud_matcher.hpp"
 #include <rtb/common/decision_tree.hpp>
+#include "rtb/core/string_arena.hpp"
 #include <iostream>
 
 namespace vanilla {
@@ -35,13 +36,18 @@ namespace vanilla {
 
         thread_local boost::asio::io_service io_service;
         thread_local boost::asio::deadline_timer timer{io_service};
+        thread_local string_arena auction_strings;
 
 
+        /*
+         * Bytes a request points to with a string_view DSL live as long as the auction : the body
+         * is owned by the connection until the reply is written, strings of bidder responses
+         * are loaded into auction_strings of the connection thread, cleared by the next request.
+         */
         template<typename DSL, typename ...Info>
         class exchange_handler {
             using auction_request_type = decltype(DSL().extract_request(std::string()));
             using auction_response_type = typename DSL::serialized_type;
-            using wire_response_type = decltype(DSL().create_response(auction_response_type()));
             using parse_error_type = typename DSL::parse_error_type;
             using auction_handler_type = std::function<auction_response_type(const auction_request_type &)>;
             using auction_async_handler_type = auction_handler_type;
@@ -103,17 +109,16 @@ namespace vanilla {
                 if (!auction_handler) {
                     return false;
                 }
-                std::chrono::milliseconds timeout{bid_request.request().tmax ? bid_request.request().tmax : tmax.count()};
+                const std::chrono::milliseconds timeout = request_timeout(bid_request);
+                auto &strings = string_arena::current();
                 auto future = std::async(std::launch::async, [&]() {
-                    auto auction_response = auction_handler(bid_request);
-                    auto wire_response = parser.create_response(auction_response);
-                    return wire_response;
+                    string_arena::scope scope(strings);
+                    return auction_handler(bid_request);
                 });
                 if (future.wait_for(timeout) == std::future_status::ready) {
-                    r << to_string(future.get()) << http::server::reply::flush("");
-                } else {
-                    r << http::server::reply::flush("");
+                    parser.write_response(future.get(), r.content);
                 }
+                r << http::server::reply::flush("");
                 return true;
             }
 
@@ -121,12 +126,10 @@ namespace vanilla {
                 if (!auction_async_handler) {
                     return false;
                 }
-                std::chrono::milliseconds timeout{bid_request.request().tmax ? bid_request.request().tmax : tmax.count()};
-                boost::optional<wire_response_type> wire_response;
-                auction_response_type auction_response;
+                const std::chrono::milliseconds timeout = request_timeout(bid_request);
+                boost::optional<auction_response_type> auction_response;
                 auto submit_async = [&]() {
                     auction_response = auction_async_handler(bid_request);
-                    wire_response = parser.create_response(auction_response);
                     io_service.stop();
                 };
                 io_service.post(submit_async);
@@ -138,16 +141,14 @@ namespace vanilla {
                 });
                 io_service.reset();
                 io_service.run();
-                if (wire_response && timer.expires_from_now().total_milliseconds() > 0) {
-                    if(if_response_handler) {
-                       auto custom_reply = if_response_handler(auction_response);
-                       if ( custom_reply ) {
-                          custom_reply(r);
-                       } else {
-                          r << to_string(*wire_response) << http::server::reply::flush("json");
-                       }
+                if (auction_response && timer.expires_from_now().total_milliseconds() > 0) {
+                    auto custom_reply = if_response_handler ? if_response_handler(*auction_response) : response_handler_type{};
+                    if ( custom_reply ) {
+                       custom_reply(r);
                     } else {
-                       r << to_string(*wire_response) << http::server::reply::flush("json");
+                       //serialized straight into the reply the connection writes out
+                       parser.write_response(*auction_response, r.content);
+                       r << http::server::reply::flush("json");
                     }
                 } else {
                     r << http::server::reply::flush("json");
@@ -156,6 +157,14 @@ namespace vanilla {
             }
         private:
 
+            //tmax of the request, the handler timeout without one
+            std::chrono::milliseconds request_timeout(const auction_request_type &bid_request) const {
+                const auto &request = bid_request.request();
+                using request_type = typename std::decay_t<decltype(request)>::request_type;
+                const int request_tmax = request.get(&request_type::tmax);
+                return request_tmax ? std::chrono::milliseconds{request_tmax} : tmax;
+            }
+
             template<typename Match>
             bool handle_post_common(http::server::reply & r, const http::crud::crud_match<Match> &match, auction_request_type &bid_request) {
                 if (log_handler) {
@@ -176,16 +185,25 @@ namespace vanilla {
 
             template<typename Match>
             void handle_post(http::server::reply & r, const http::crud::crud_match<Match> & match) {
+                string_arena::scope scope(auction_strings.clear());
                 auction_request_type bid_request;
                 if (!handle_post_common(r, match, bid_request)) {
                     return;
                 }
-                if(decision_handler) {
-                    decision_handler(r, bid_request);
-                    return;
-                }
-                if (!handle_auction_async(r, bid_request)) {
-                     handle_auction(r, bid_request);
+                //a DSL::lazy_request only finds out a member is malformed when the auction reads it
+                try {
+                    if(decision_handler) {
+                        decision_handler(r, bid_request);
+                        return;
+                    }
+                    if (!handle_auction_async(r, bid_request)) {
+                         handle_auction(r, bid_request);
+                    }
+                } catch (const std::exception& err) {
+                    if (error_log_handler) {
+                        error_log_handler(err.what());
+                    }
+                    r << http::server::reply::flush("");
                 }
             }
         };
@@ -21,6 +21,8 @@
 // * communicator<multicast>().outbound(port,group_address).distribute([] (...) {}).collect(5ms, [] (...) {}) ; //blocks for 5ms
 // * communicator<broadcast>().inbound(port).process([](...){}).dispatch() ; //blocks in io_service.run() does not return
 // * communicator<multicast>().inbound(port,group_address).process([](...){}).dispatch() ; //blocks in io_service.run() does not return
+// * communicator<broadcast> c; c.outbound(port); c.distribute(...).flush(); //long lived sender, flush blocks until the send completed
+// * c.distribute(...).collect(10ms, [] (...) {}); //long lived sender collects replies the same way, one collect at a time
 //
 
 #include <string>
@@ -29,6 +31,7 @@
 #include <boost/date_time/posix_time/posix_time_types.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/archive/binary_oarchive.hpp>
+#include "rtb/core/string_arena.hpp"
 
 namespace vanilla { namespace messaging {
 
@@ -188,16 +191,24 @@ public:
      });
   }
   
+  //a receive aborted by cancel() does not call its handler
   template<typename Handler>
   void receive_async(Handler handler) {
       socket_.async_receive_from(
           boost::asio::buffer(in_data_.data(), in_data_.size()), from_endpoint_,
               [this,handler](const boost::system::error_code& error, size_t bytes_recvd) {
+                if (error == boost::asio::error::operation_aborted) {
+                    return;
+                }
                 handler(std::move(std::string(in_data_.data(),bytes_recvd))); 
                 handle_receive_from(error, handler, bytes_recvd);
       });
   }
 
+  //ends the receive of a finished collect, its handler may refer to the caller's stack
+  void cancel() {
+      socket_.cancel();
+  }
 
 private:
   template<typename Handler>
@@ -209,6 +220,9 @@ private:
       socket_.async_receive_from(
           boost::asio::buffer(in_data_.data(), in_data_.size()), from_endpoint_,
           [this,handler](const boost::system::error_code& error, size_t bytes_recvd) {
+          if (error == boost::asio::error::operation_aborted) {
+              return;
+          }
           handler(std::move(std::string(in_data_.data(),bytes_recvd)));
           handle_receive_from(error, handler, bytes_recvd);
       });
@@ -274,6 +288,7 @@ public:
        if( consumer_ ) {
            //intercept a call from receive , get response from handler , send reponse back to from_endpoint
            consumer_->receive_async([this,handler](const boost::asio::ip::udp::endpoint &from_endpoint, auto data) { //intercept a call for deserialization
+               string_arena::scope scope(strings_.clear());
                auto response = handler(&from_endpoint, std::move(deserialize<T>(data)));
                consumer_->send_async(response, from_endpoint);
            });
@@ -286,12 +301,14 @@ public:
        if( consumer_ ) {
            //intercept a call from receive, and call handler-consumer 
            consumer_->receive_async([this,handler](const boost::asio::ip::udp::endpoint &from_endpoint, auto data) { //intercept a call for deserialization
+               string_arena::scope scope(strings_.clear());
                handler(&from_endpoint, std::move(deserialize<T>(data)));
            });
        }
        return *this;
     }
     
+    //string_view typed replies are loaded into the arena of the caller's string_arena::scope
     template<typename T, typename Duration, typename Handler>
     void collect(Duration && timeout, Handler handler) {
        if( !distributor_ ) {
@@ -311,18 +328,31 @@ public:
        //TODO: can be  optimized return before timer if all data is collected from all responders
        io_service_.reset();
        io_service_.run();
+       //a long lived communicator collects again, nothing of this collect may outlive it
+       distributor_->cancel();
+       timer_.cancel();
+       io_service_.reset();
+       io_service_.poll();
     }
 
     void dispatch() {
         io_service_.reset();
         io_service_.run();
     }
+
+    //completes pending sends of a long lived outbound communicator, returns once none is left
+    self_type & flush() {
+        io_service_.reset();
+        io_service_.run();
+        return *this;
+    }
     
 private:
     io_service_type io_service_;
     boost::asio::deadline_timer timer_;
     distributor_type distributor_;
     consumer_type   consumer_;
+    string_arena strings_; // string_views of the inbound message being handled
 };
 
 
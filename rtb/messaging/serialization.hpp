@@ -2,8 +2,11 @@
 
 #include <boost/serialization/vector.hpp>
 #include <boost/serialization/optional.hpp>
+#include <boost/serialization/level.hpp>
+#include <boost/serialization/tracking.hpp>
 #include "rtb/core/openrtb.hpp"
 #include "rtb/core/bid_request.hpp"
+#include "rtb/core/string_arena.hpp"
 #include "jsonv/all.hpp"
 
 //Non-Intrusive boost serialization implementation
@@ -217,24 +220,25 @@ namespace boost {
         {
             boost::serialization::split_free(ar, value, version);
         } 
+        //same bytes as std::string, string_view and std::string peers talk to each other
         template<class Archive>
         void save(Archive & ar, const jsonv::string_view & value, const unsigned int version) {
-            ar & value.size();
-            std::for_each(value.begin(), value.end(), [&ar](char c) {
-                ar & c;
-            });
+            std::size_t n = value.size();
+            ar & n;
+            ar.save_binary(value.data(), n);
         }
+        //characters go to the arena of the current vanilla::string_arena::scope
         template<class Archive>
         void load(Archive & ar, jsonv::string_view & value, const unsigned int version) {
             std::size_t n;
             ar & n;
-            thread_local std::string value_(n,'\0');
-            for ( int i=0; i < n; ++i) {
-                ar & value_[i];
-            }
-            value = value_;
+            std::string &bytes = vanilla::string_arena::current().allocate(n);
+            ar.load_binary(&bytes[0], n);
+            value = bytes;
         }
     } // namespace serialization
 } // namespace boost
 
-
+//no class header in front of string_view, written as a plain std::string
+BOOST_CLASS_IMPLEMENTATION(jsonv::string_view, boost::serialization::object_serializable)
+BOOST_CLASS_TRACKING(jsonv::string_view, boost::serialization::track_never)